@@ -0,0 +1,18 @@
+/**
+ * @brief Etat du composant PCF8574, défini une seule fois par processus
+ 
+ * @file PCF8574.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details 
+ * Hardware : Rpi4, PCF8574
+ * compilation : ajouter PCF8574.c (du dossier PCF8574) à la ligne de commande gcc de chaque programme utilisant
+ *               PCF8574.h, une seule fois quel que soit le nombre de ses unités de compilation.
+ **/
+
+#include "PCF8574.h"
+
+char *pcf8574_chip = RPI_I2C_DEVICE;
+i2c_bus_t *pcf8574_bus = NULL;
+uint8_t pcf8574_port[1] = {0xFF};
@@ -7,6 +7,14 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8574
+ * compilation : add PCF8574.c, -I../i2c ../i2c/i2c_bus.c -pthread to the gcc command line (i2c_transport.h, i2c_bus.h).
+ *
+ * Le bus est accédé via i2c_transport.h : /dev/i2c-N par défaut, ou le bus simulé de i2c_sim.h.
+ * Il est partagé avec les autres drivers via i2c_bus.h (un seul descripteur par bus, accès sérialisés entre threads).
+ * Les fonctions sont inline, l'état du composant (bus, dernier octet écrit) est défini une seule fois dans PCF8574.c :
+ * toutes les unités de compilation d'un programme pilotent le même port.
+ * Les sondes USDT pcf8574:read_data et pcf8574:write_data (i2c_probe.h) donnent à perf et bpftrace l'adresse, le nombre
+ * d'octets, les dates de début et de fin et l'octet lu ou écrit de chaque appel.
  **/
 
 #ifndef PCF8594_H
@@ -21,6 +29,8 @@
 #include <sys/ioctl.h>
 #include <stdint.h>
 #include <linux/i2c-dev.h>
+#include "i2c_async.h"
+#include "i2c_probe.h"
 
 #ifndef PCF8574_I2C_ADDR 
 #define PCF8574_I2C_ADDR 0x20 ///< PCF8574 i2c address
@@ -32,25 +42,32 @@
 #define HIGH 1
 #define LOW 0
 
-char *i2c_chip = RPI_I2C_DEVICE;
-int fd;
-uint8_t data_byte[1] = {0xFF};
+/* état du composant, défini une seule fois par processus dans PCF8574.c */
+extern char *pcf8574_chip;        ///< nom du bus (RPI_I2C_DEVICE par défaut), à changer avant PCF8574_init()
+extern i2c_bus_t *pcf8574_bus;    ///< bus partagé (i2c_bus.h)
+extern uint8_t pcf8574_port[1];   ///< dernier état écrit sur les sorties
+
+I2C_PROBE_DEFINE(pcf8574, read_data);
+I2C_PROBE_DEFINE(pcf8574, write_data);
 
 /**
  * @brief Initialise la connexion I²C avec le commposant PCF8574
  * @param Nothing.
  * @return Nothing.
  */
-void PCF8574_init(void)
+static inline void PCF8574_init(void)
 {
-        if ((fd = open(i2c_chip, O_RDWR)) < 0) ///< The i2c communication is initiated by opening a file.
+    if (pcf8574_bus != NULL)
+    {
+        return; ///< déjà initialisé
+    }
+    if ((pcf8574_bus = i2c_bus_get(pcf8574_chip)) == NULL) ///< bus ouvert une seule fois, partagé avec les autres drivers
     {
         printf("Cannot initiate i2c connection\n");
         exit(1);
     }
     else
     {
-        ioctl(fd, I2C_SLAVE, PCF8574_I2C_ADDR); ///< Change default i2c address in i2c-dev.h file by PCF8591 address.
         printf("i2c connection initiated\n");
     }
 }
@@ -61,10 +78,12 @@ void PCF8574_init(void)
  * @return Octet de donnée
  * @warning executer PCF8574_init() avant d'utiliser cette fonction
  */
-uint8_t PCF8574_read_data(void)
+static inline uint8_t PCF8574_read_data(void)
 {
+    I2C_PROBE_BEGIN(pcf8574, read_data, start_ns);
     uint8_t buffer[1];
-    read(fd,buffer,0x01);
+    i2c_bus_read(pcf8574_bus,PCF8574_I2C_ADDR,buffer,0x01); ///< ioctl(I2C_SLAVE) seulement si l'adresse a changé
+    I2C_PROBE_END(pcf8574, read_data, start_ns, PCF8574_I2C_ADDR, 1, buffer[0]);
     return buffer[0];
 }
 /**
@@ -73,10 +92,12 @@ uint8_t PCF8574_read_data(void)
  * @return rien
  * @warning executer PCF8574_init() avant d'utiliser cette fonction
  */
-void PCF8574_write_data(uint8_t data)
+static inline void PCF8574_write_data(uint8_t data)
 {
+    I2C_PROBE_BEGIN(pcf8574, write_data, start_ns);
     uint8_t buffer[1] = {data};
-    write(fd,buffer,0x01);
+    i2c_bus_write(pcf8574_bus,PCF8574_I2C_ADDR,buffer,0x01);
+    I2C_PROBE_END(pcf8574, write_data, start_ns, PCF8574_I2C_ADDR, 1, data);
 }
 
 /**
@@ -86,7 +107,7 @@ void PCF8574_write_data(uint8_t data)
  * @return rien
  * @warning executer PCF8574_init() avant d'utiliser cette fonction
  */
-void PCF8574_digitalWrite(short output_pin, short state)
+static inline void PCF8574_digitalWrite(short output_pin, short state)
 {
     if ((output_pin > 7) | (output_pin < 0))
     {
@@ -97,12 +118,12 @@ void PCF8574_digitalWrite(short output_pin, short state)
     
     if (state == HIGH)
     {
-        data_byte[0] &= output; 
+        pcf8574_port[0] &= output; 
     }else if(state == LOW)
     {
-        data_byte[0] |= ~output;
+        pcf8574_port[0] |= ~output;
     }
-    write(fd,data_byte,1);
+    i2c_bus_write(pcf8574_bus,PCF8574_I2C_ADDR,pcf8574_port,1);
 }
 
 
@@ -112,7 +133,7 @@ void PCF8574_digitalWrite(short output_pin, short state)
  * @return rien
  * @warning executer PCF8574_init() avant d'utiliser cette fonction
  */
-short PCF8574_digitalRead(short input_pin)
+static inline short PCF8574_digitalRead(short input_pin)
 {
     if ((input_pin > 7) | (input_pin < 0))
     {
@@ -121,7 +142,7 @@ short PCF8574_digitalRead(short input_pin)
     }
     uint8_t input = 1 << input_pin;
     
-    if((data_byte[0] & input) == HIGH)
+    if((pcf8574_port[0] & input) == HIGH)
     {
         return HIGH;
     }else{
@@ -129,4 +150,58 @@ short PCF8574_digitalRead(short input_pin)
     }
 }
 
+/**
+ * @brief ajoute la lecture du port à un lot d'opérations (i2c_batch.h), exécuté avec les autres composants du bus
+ * @param batch lot d'opérations du bus
+ * @param op opération utilisée, valide jusqu'à i2c_batch_flush()
+ * @param data octet qui recevra l'état des broches après i2c_batch_flush()
+ * @return 1, -1 si le vidage automatique d'un lot plein a eu une opération en erreur
+ */
+static inline int PCF8574_batch_read(i2c_batch_t *batch, i2c_op_t *op, uint8_t *data)
+{
+    i2c_op_read(op, PCF8574_I2C_ADDR, data, 1);
+    return i2c_batch_add(batch, op);
+}
+
+/**
+ * @brief ajoute l'écriture du port à un lot d'opérations (i2c_batch.h), exécuté avec les autres composants du bus
+ * @param batch lot d'opérations du bus
+ * @param op opération utilisée, valide jusqu'à i2c_batch_flush()
+ * @param data octet de donnée
+ * @return 1, -1 si le vidage automatique d'un lot plein a eu une opération en erreur
+ */
+static inline int PCF8574_batch_write(i2c_batch_t *batch, i2c_op_t *op, uint8_t data)
+{
+    i2c_op_write(op, PCF8574_I2C_ADDR, &data, 1);
+    return i2c_batch_add(batch, op);
+}
+
+/**
+ * @brief envoie la lecture du port au thread du bus (i2c_async.h) sans attendre, l'opération arrive dans la file
+ *        des opérations terminées (i2c_async_reap())
+ * @param async thread du bus
+ * @param op opération utilisée, à ne pas modifier avant d'être récupérée
+ * @param data octet qui recevra l'état des broches
+ * @return 1, -1 si le thread du bus est arrêté
+ */
+static inline int PCF8574_async_read(i2c_async_t *async, i2c_op_t *op, uint8_t *data)
+{
+    i2c_op_read(op, PCF8574_I2C_ADDR, data, 1)->post = 1;
+    return i2c_async_submit(async, op);
+}
+
+/**
+ * @brief envoie l'écriture du port au thread du bus (i2c_async.h) sans attendre, l'opération arrive dans la file
+ *        des opérations terminées (i2c_async_reap())
+ * @param async thread du bus
+ * @param op opération utilisée, à ne pas modifier avant d'être récupérée
+ * @param data octet de donnée
+ * @return 1, -1 si le thread du bus est arrêté
+ */
+static inline int PCF8574_async_write(i2c_async_t *async, i2c_op_t *op, uint8_t data)
+{
+    i2c_op_write(op, PCF8574_I2C_ADDR, &data, 1)->post = 1;
+    return i2c_async_submit(async, op);
+}
+
 #endif
\ No newline at end of file
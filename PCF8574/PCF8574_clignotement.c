@@ -7,6 +7,7 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8574
+ * compilation : gcc -Wall -I../i2c -o PCF8574_clignotement PCF8574_clignotement.c PCF8574.c ../i2c/i2c_bus.c -pthread
  * 
  * @warning n'oublier pas d'inclure la library PCF8574.h
  **/
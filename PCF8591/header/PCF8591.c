@@ -0,0 +1,20 @@
+/**
+ * @brief Converter of the PCF8591_xxx() functions, defined once per process
+ *
+ * @file PCF8591.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add PCF8591.c (from the PCF8591/header directory) to the gcc command line of every program using
+ *               PCF8591.h, once, whatever the number of its translation units.
+ *
+ * The functions of PCF8591.h are inline, but pcf8591_default is defined here : every translation unit calling the
+ * PCF8591_xxx() functions drives the same converter, with the same bus, control byte, pending conversion and
+ * calibration tables.
+ */
+
+#include "PCF8591.h"
+
+pcf8591_t pcf8591_default = {.bus = RPI_I2C_DEVICE, .fd = -1, .address = PCF8591_I2C_ADDR, .control = -1, .pending = -1, .vref_mv = Vref};
@@ -28,6 +28,18 @@
  *
  * @details 
  * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add PCF8591.c, -I../../i2c and ../../i2c/i2c_bus.c to the gcc command line (i2c_transport.h, i2c_bus.h).
+ * 
+ * The bus is reached through i2c_transport.h : Linux i2c-dev by default, or the simulated bus of i2c_sim.h.
+ * It is shared with the other drivers through i2c_bus.h : one descriptor per bus, ioctl(I2C_SLAVE) only when the
+ * address changes, accesses serialized between threads. A converter itself is used by one thread at a time.
+ * pcf8591_batch_xxx() queue their transfer in a batch of i2c_batch.h, run with the other devices of the bus in one ioctl.
+ * pcf8591_async_xxx() submit it to the worker thread of the bus (i2c_async.h) and return at once.
+ * The single writes (DAC output, control byte) are made in the real-time class of the bus (I2C_CLASS_RT of i2c_bus.h) :
+ * they go before the waiting reads and display frames. The sample blocks of pcf8591_write_block() are bulk accesses,
+ * sent in pieces of PCF8591_BULK_CHUNK samples with a preemption point between two pieces.
+ * The USDT probes pcf8591:select_channel, pcf8591:read_data and pcf8591:write_data (i2c_probe.h) give the address, the
+ * bytes on the bus, the start and end times and the channel or DAC data of each call to perf and bpftrace.
  * 
  * Controle register configuration (8 bits):
  * 
@@ -123,8 +135,19 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <stdint.h>
+#include <string.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include "i2c_async.h"
+#include "i2c_probe.h"
+
+I2C_PROBE_DEFINE(pcf8591, select_channel);
+I2C_PROBE_DEFINE(pcf8591, read_data);
+I2C_PROBE_DEFINE(pcf8591, write_data);
 
 #ifndef PCF8591_I2C_ADDR 
 #define PCF8591_I2C_ADDR 0x48 ///< PCF8591 i2c address
@@ -135,64 +158,1081 @@
 #ifndef PCF8591_DAC_RQST
 #define PCF8591_DAC_RQST 0x40 ///< PCF8591 DAC write request
 #endif
+#ifndef PCF8591_AUTO_INC
+#define PCF8591_AUTO_INC 0x04 ///< PCF8591 auto-increment flag (bit 2 of the control byte)
+#endif
+#ifndef PCF8591_BLOCK_MAX
+#define PCF8591_BLOCK_MAX 8192 ///< Maximum size of one I2C transfer (i2c-dev limit, lower it for adapters with a smaller FIFO)
+#endif
+#ifndef PCF8591_BULK_CHUNK
+#define PCF8591_BULK_CHUNK 32 ///< Samples of one piece of a block write (bulk class), the RT accesses can go between two pieces.
+#endif
+#ifndef PCF8591_PENDING_MAX_AGE_NS
+#define PCF8591_PENDING_MAX_AGE_NS 1000000 ///< Oldest pending conversion returned by a read without control byte (1 ms).
+#endif
+#ifndef PCF8591_DAC_TABLE_SIZE
+#define PCF8591_DAC_TABLE_SIZE 4096 ///< Entries of the mV to DAC code table (1 mV step, higher voltages give the highest code).
+#endif
+#ifndef PCF8591_SCAN_MAX
+#define PCF8591_SCAN_MAX 32 ///< Maximum number of devices scanned together by pcf8591_scan().
+#endif
 
 #define Vref 3300 ///< PCF8591 supply voltage.
 #define resolution 255 ///< PCF8591 DAC and ADC resolution.
+#define PCF8591_NB_CHANNEL 4 ///< Number of ADC inputs (A0 to A3).
+#define PCF8591_MODE_SINGLE 0x00 ///< Four single-ended inputs : A0, A1, A2, A3.
+#define PCF8591_MODE_DIFF3 0x10 ///< Three differential inputs : A0 - A3, A1 - A3, A2 - A3.
+#define PCF8591_MODE_MIXED 0x20 ///< Two single-ended and one differential inputs : A0, A1, A2 - A3.
+#define PCF8591_MODE_DIFF2 0x30 ///< Two differential inputs : A0 - A1, A2 - A3.
+#define PCF8591_MODE_MASK 0x30 ///< Analog input programming bits (4 and 5) of the control byte.
+#define PCF8591_ADDR_MIN 0x48 ///< Address of a PCF8591 with A0 = A1 = A2 = 0.
+#define PCF8591_ADDR_MAX 0x4F ///< Address of a PCF8591 with A0 = A1 = A2 = 1.
+#define PCF8591_NB_MODE 4 ///< Number of analog input programmings.
+#define PCF8591_CALIB_POINT_MAX 8 ///< Maximum number of calibration points of an ADC channel.
+#define PCF8591_CALIB_FRAC 4 ///< Fractional bits of the calibration codes (averaged conversions).
+
+/**
+ * @brief Calibration of one ADC channel : measured codes of known voltages.
+ * 1 point corrects the offset, 2 points the offset and the gain, more points give a piecewise linear conversion.
+ */
+typedef struct
+{
+    uint8_t nb_point;                         ///< Number of points, 0 for the ideal conversion.
+    int16_t code[PCF8591_CALIB_POINT_MAX];    ///< Measured codes (signed for a differential input), with PCF8591_CALIB_FRAC fractional bits, increasing.
+    int16_t mv[PCF8591_CALIB_POINT_MAX];      ///< Voltage applied for each code (mV).
+} pcf8591_adc_calib_t;
+
+/**
+ * @brief One PCF8591 converter : bus, address, last control byte and calibration.
+ *
+ * Every function of the library exists in two forms :
+ *  - pcf8591_xxx(pcf8591_t *dev, ...) works on the given converter, any number of them can be used at the same time.
+ *  - PCF8591_xxx(...) works on the default converter opened by PCF8591_i2c_connect() (RPI_I2C_DEVICE, PCF8591_I2C_ADDR).
+ */
+typedef struct
+{
+    char bus[32];     ///< I2C bus device file ("/dev/i2c-1").
+    int fd;           ///< File descriptor of the bus, -1 when closed.
+    i2c_bus_t *i2c;   ///< Shared bus (i2c_bus.h), NULL when closed.
+    uint8_t address;  ///< I2C address (0x48 to 0x4F).
+    uint8_t mode;     ///< Analog input programming : PCF8591_MODE_SINGLE / DIFF3 / MIXED / DIFF2.
+    int control;      ///< Last control byte written, -1 when unknown.
+    int pending;      ///< Control byte of the conversion waiting in the PCF8591 (the next byte read continues its read mode), -1 when unknown.
+    uint64_t pending_ns; ///< Time at which the pending conversion was started.
+    int vref_mv;      ///< Reference voltage used for the mV conversions.
+    int16_t adc_mv[PCF8591_NB_CHANNEL][256];   ///< ADC code to mV of each channel of the active mode (signed for a differential input).
+    uint16_t dac_mv[256];                      ///< DAC code to output mV.
+    uint8_t dac_code[PCF8591_DAC_TABLE_SIZE];  ///< Output mV to nearest DAC code (inverse of dac_mv).
+    pcf8591_adc_calib_t adc_calib[PCF8591_NB_MODE][PCF8591_NB_CHANNEL]; ///< ADC calibration of every channel of every mode.
+} pcf8591_t;
+
+/** @brief Converter used by the PCF8591_xxx() functions (PCF8591.c, one per process). */
+extern pcf8591_t pcf8591_default;
+
+/**
+ * @brief Return the CLOCK_MONOTONIC time in ns.
+ */
+static inline uint64_t PCF8591_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Sleep until an absolute CLOCK_MONOTONIC deadline, so the time spent before the call does not add up.
+ * @param deadline_ns Deadline in ns (see PCF8591_time_ns()).
+ */
+static inline void PCF8591_sleep_until(uint64_t deadline_ns)
+{
+    struct timespec t = {.tv_sec = deadline_ns / 1000000000ull, .tv_nsec = deadline_ns % 1000000000ull};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR); ///< restart after a signal
+}
+
+/**
+ * @brief Return the number of inputs cycled through by the auto-increment in the input mode of a control byte.
+ * @param control Control byte.
+ */
+static inline int pcf8591_nb_input(uint8_t control)
+{
+    static const int nb_input[4] = {4, 3, 3, 2}; ///< four single-ended, three differential, mixed, two differential
+    return nb_input[(control >> 4) & 0x03];
+}
+
+/**
+ * @brief Check if a channel is a differential input (two's complement result) in the input mode of a control byte.
+ * @param control Control byte.
+ * @param channel Channel number.
+ * @return 1 for a differential input, 0 for a single-ended input.
+ */
+static inline int pcf8591_is_differential(uint8_t control, uint8_t channel)
+{
+    switch (control & PCF8591_MODE_MASK)
+    {
+        case PCF8591_MODE_DIFF3 : return 1;
+        case PCF8591_MODE_MIXED : return channel == 2;
+        case PCF8591_MODE_DIFF2 : return 1;
+        default : return 0;
+    }
+}
+
+/**
+ * @brief Convert a code with the calibration points of a channel, in integer arithmetic.
+ * The code is interpolated between the two nearest points, or extrapolated from the first or last segment.
+ * One point only shifts the ideal conversion.
+ * @param dev The converter (for the reference voltage).
+ * @param calib Calibration of the channel (at least one point).
+ * @param value Code read (signed for a differential input).
+ * @return Voltage in mV.
+ */
+static inline int pcf8591_calib_to_mv(const pcf8591_t *dev, const pcf8591_adc_calib_t *calib, int value)
+{
+    int64_t code = (int64_t)value << PCF8591_CALIB_FRAC;
+    int64_t code0 = calib->code[0], code1, mv0 = calib->mv[0], mv1;
+
+    if (calib->nb_point == 1) ///< ideal slope through the point
+    {
+        code1 = code0 + ((int64_t)resolution << PCF8591_CALIB_FRAC);
+        mv1 = mv0 + dev->vref_mv;
+    }
+    else
+    {
+        int i = 1;
+        while ((i < calib->nb_point - 1) && (code > calib->code[i])){ i++;}
+        code0 = calib->code[i - 1];
+        mv0 = calib->mv[i - 1];
+        code1 = calib->code[i];
+        mv1 = calib->mv[i];
+    }
+
+    int64_t numerator = (code - code0) * (mv1 - mv0), denominator = code1 - code0;
+    int64_t step = (numerator >= 0) ? (numerator + denominator / 2) / denominator : -((-numerator + denominator / 2) / denominator);
+    int64_t mv = mv0 + step;
+    return (mv < INT16_MIN) ? INT16_MIN : (mv > INT16_MAX) ? INT16_MAX : mv;
+}
+
+/**
+ * @brief Compute the ADC code to mV table of each channel for the active mode and reference voltage,
+ * with the calibration of the channel when it has one.
+ * @param dev The converter.
+ */
+static inline void pcf8591_build_adc_table(pcf8591_t *dev)
+{
+    for (int channel = 0; channel < PCF8591_NB_CHANNEL; channel++)
+    {
+        int differential = pcf8591_is_differential(dev->mode, channel);
+        const pcf8591_adc_calib_t *calib = &dev->adc_calib[dev->mode >> 4][channel];
+        for (int code = 0; code < 256; code++)
+        {
+            int value = differential ? (int8_t)code : code; ///< two's complement for a differential input
+            dev->adc_mv[channel][code] = calib->nb_point ? pcf8591_calib_to_mv(dev, calib, value) : lround((double)value * dev->vref_mv / resolution);
+        }
+    }
+}
+
+/**
+ * @brief Compute the mV to DAC code table from the DAC code to mV table : each mV gets the code with the nearest output.
+ * @param dev The converter.
+ * @warning dac_mv must never decrease from one code to the next.
+ */
+static inline void pcf8591_build_dac_table(pcf8591_t *dev)
+{
+    int code = 0;
+    for (int mv = 0; mv < PCF8591_DAC_TABLE_SIZE; mv++)
+    {
+        while ((code < 255) && (2 * mv >= dev->dac_mv[code] + dev->dac_mv[code + 1])){ code++;} ///< past the middle of the next step
+        dev->dac_code[mv] = code;
+    }
+}
+
+/**
+ * @brief Set the reference voltage and compute the conversion tables of a converter.
+ * @param dev The converter.
+ * @param vref_mv Reference voltage (mV).
+ * @return 1 on success, -1 if the voltage is not valid.
+ */
+static inline int pcf8591_set_vref(pcf8591_t *dev, int vref_mv)
+{
+    if ((vref_mv <= 0) | (vref_mv >= 32768)){ printf("/!\\ Error : reference voltage not suported.\n"); return -1;}
+
+    dev->vref_mv = vref_mv;
+    for (int code = 0; code < 256; code++)
+    {
+        dev->dac_mv[code] = lround((double)code * vref_mv / resolution);
+    }
+    pcf8591_build_adc_table(dev);
+    pcf8591_build_dac_table(dev);
+    return 1;
+}
+
+/**
+ * @brief Convert an ADC code to mV with the table of the channel.
+ * @param dev The converter.
+ * @param channel Channel of the active mode.
+ * @param data 8 bit data read.
+ * @return Voltage in mV.
+ */
+static inline int pcf8591_data_to_mv(const pcf8591_t *dev, uint8_t channel, uint8_t data)
+{
+    return dev->adc_mv[channel & 0x03][data];
+}
+
+/**
+ * @brief Convert a voltage to the DAC code with the nearest output.
+ * @param dev The converter.
+ * @param mv Voltage in mV (negative voltages give 0, voltages above the table give the highest code).
+ * @return DAC code.
+ */
+static inline uint8_t pcf8591_mv_to_data(const pcf8591_t *dev, int mv)
+{
+    if (mv < 0){ mv = 0;}
+    if (mv >= PCF8591_DAC_TABLE_SIZE){ mv = PCF8591_DAC_TABLE_SIZE - 1;}
+    return dev->dac_code[mv];
+}
+
+/**
+ * @brief Convert a buffer of ADC codes of one channel to mV.
+ * A table lookup per sample, without multiplication nor division.
+ * @param dev The converter.
+ * @param channel Channel of the active mode the codes were read on.
+ * @param data 8 bit data read.
+ * @param data_mv Buffer that will get the voltages in mV.
+ * @param n Number of samples.
+ */
+static inline void pcf8591_data_to_mv_block(const pcf8591_t *dev, uint8_t channel, const uint8_t *data, int16_t *data_mv, size_t n)
+{
+    const int16_t *table = dev->adc_mv[channel & 0x03];
+    for (size_t i = 0; i < n; i++)
+    {
+        data_mv[i] = table[data[i]];
+    }
+}
+
+/**
+ * @brief Convert a buffer of voltages to DAC codes, for pcf8591_write_block().
+ * @param dev The converter.
+ * @param data_mv Voltages in mV.
+ * @param data Buffer that will get the DAC codes.
+ * @param n Number of samples.
+ */
+static inline void pcf8591_mv_to_data_block(const pcf8591_t *dev, const uint16_t *data_mv, uint8_t *data, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint16_t mv = (data_mv[i] < PCF8591_DAC_TABLE_SIZE) ? data_mv[i] : PCF8591_DAC_TABLE_SIZE - 1;
+        data[i] = dev->dac_code[mv];
+    }
+}
+
+/**
+ * @brief Select the analog input programming used by the next reads.
+ * @param dev The converter.
+ * @param mode PCF8591_MODE_SINGLE / PCF8591_MODE_DIFF3 / PCF8591_MODE_MIXED / PCF8591_MODE_DIFF2.
+ * @return 1 on success, -1 if the mode is not valid.
+ * @warning In the differential modes, the voltage of an input must stay within the Vref range (see the PCF8591 datasheet).
+ */
+static inline int pcf8591_set_mode(pcf8591_t *dev, uint8_t mode)
+{
+    if (mode & ~PCF8591_MODE_MASK){ printf("/!\\ Error : input mode not suported.\n"); return -1;}
+    dev->mode = mode;
+    pcf8591_build_adc_table(dev);
+    return 1;
+}
+
+/**
+ * @brief Build the control byte that selects a channel in the active input mode (DAC output kept enabled).
+ * @param dev The converter.
+ * @param channel Channel number.
+ * @return The control byte, -1 if the channel does not exist in the active mode.
+ */
+static inline int pcf8591_control(pcf8591_t *dev, uint8_t channel)
+{
+    uint8_t control = PCF8591_DAC_RQST | dev->mode;
+    if (channel >= pcf8591_nb_input(control)){ printf("/!\\ Error : channel not suported. Select a compliant channel.\n"); return -1;}
+    return control | channel;
+}
+
+/**
+ * @brief Open the I2C connection with a PCF8591.
+ * @param dev The converter.
+ * @param bus I2C bus device file ("/dev/i2c-1").
+ * @param address I2C address of the converter (0x48 to 0x4F, set by the A0, A1 and A2 pins).
+ * @return 1 on success, -1 on error.
+ */
+static inline int pcf8591_open(pcf8591_t *dev, const char *bus, uint8_t address)
+{
+    if ((address < PCF8591_ADDR_MIN) | (address > PCF8591_ADDR_MAX)){ printf("/!\\ Error : PCF8591 address 0x%x not suported.\n", address); return -1;}
+
+    snprintf(dev->bus, sizeof(dev->bus), "%s", bus);
+    dev->address = address;
+    dev->mode = PCF8591_MODE_SINGLE;
+    dev->control = -1;
+    dev->pending = -1;
+    memset(dev->adc_calib, 0, sizeof(dev->adc_calib));
+    pcf8591_set_vref(dev, Vref);
 
-char *i2c_chip = RPI_I2C_DEVICE;
-int fd;
+    if ((dev->i2c = i2c_bus_get(dev->bus)) == NULL) ///< Bus opened once, shared with the other converters and drivers.
+    {
+        dev->fd = -1;
+        return -1;
+    }
+    dev->fd = dev->i2c->fd;
 
-int select_channel(uint8_t channel)
+    i2c_bus_lock(dev->i2c);
+    int result = i2c_bus_select(dev->i2c, dev->address); ///< Address used by the plain write() / read() calls.
+    i2c_bus_unlock(dev->i2c);
+    if (result < 0)
+    {
+        printf("Cannot reach the PCF8591 at 0x%x on %s\n", dev->address, dev->bus);
+        i2c_bus_put(dev->i2c);
+        dev->i2c = NULL;
+        dev->fd = -1;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Close the I2C connection with a PCF8591.
+ * @param dev The converter.
+ */
+static inline void pcf8591_close(pcf8591_t *dev)
 {
-    if (channel > 4){ printf("/!\\ Error : channel not suported. Select a compliant channel.\n"); return -1;}
-    uint8_t select_channel[1] = {0x40 | channel};
-    write(fd,select_channel,1);
-    usleep(100);
+    i2c_bus_put(dev->i2c);
+    dev->i2c = NULL;
+    dev->fd = -1;
+    dev->control = -1;
+    dev->pending = -1;
+}
 
+/**
+ * @brief Record the conversion left pending in the PCF8591 after reading bytes.
+ * Every byte read starts the conversion sent in the next byte, so in auto-increment the next read only
+ * continues the cycle from the first input when a whole number of cycles has been converted.
+ * @param dev The converter.
+ * @param nb_conversion Number of conversions started since the control byte was written.
+ */
+static inline void pcf8591_set_pending(pcf8591_t *dev, size_t nb_conversion)
+{
+    if ((dev->control & PCF8591_AUTO_INC) && (((dev->control & 0x03) != 0) || ((nb_conversion - 1) % pcf8591_nb_input(dev->control) != 0)))
+    {
+        dev->pending = -1;
+        return;
+    }
+    dev->pending = dev->control;
+    dev->pending_ns = PCF8591_time_ns();
+}
+
+/**
+ * @brief Check if the next byte read is a recent conversion of the given control byte, so it can be read without sending the control byte again.
+ * @param dev The converter.
+ * @param control Control byte.
+ * @return 1 if the control byte can be skipped, 0 otherwise.
+ */
+static inline int pcf8591_is_pending(pcf8591_t *dev, uint8_t control)
+{
+    return (dev->pending == control) && (PCF8591_time_ns() - dev->pending_ns < PCF8591_PENDING_MAX_AGE_NS);
+}
+
+/**
+ * @brief Send the control bytes and read the answer of the PCF8591 in one combined I2C transaction.
+ * The write and the read are separated by a repeated START instead of a STOP, in a single ioctl(I2C_RDWR) call.
+ * @param dev The converter.
+ * @param control Control bytes to send.
+ * @param size_control Number of control bytes.
+ * @param data_in Buffer that will get the data read.
+ * @param size_data Number of bytes to read.
+ * @return 1 on success, -1 if the transfer failed.
+ */
+static inline int pcf8591_transfer(pcf8591_t *dev, const uint8_t *control, int size_control, uint8_t *data_in, int size_data)
+{
+    struct i2c_msg messages[2] = {
+        {.addr = dev->address, .flags = 0, .len = size_control, .buf = (uint8_t *)control}, ///< Control bytes.
+        {.addr = dev->address, .flags = I2C_M_RD, .len = size_data, .buf = data_in},        ///< Repeated START then data.
+    };
+    if (i2c_bus_transfer(dev->i2c, messages, 2) < 0){ printf("/!\\ Error : I2C transfer failed.\n"); dev->control = dev->pending = -1; return -1;}
+    dev->control = control[0];
+    pcf8591_set_pending(dev, size_data);
+    return 1;
+}
+
+/**
+ * @brief Read bytes without sending a control byte : the PCF8591 goes on with the last control byte written.
+ * @param dev The converter.
+ * @param data_in Buffer that will get the data read, the 1st byte being the pending conversion.
+ * @param size Number of bytes to read.
+ * @return 1 on success, -1 if the transfer failed.
+ */
+static inline int pcf8591_read(pcf8591_t *dev, uint8_t *data_in, size_t size)
+{
+    if (i2c_bus_read(dev->i2c, dev->address, data_in, size) != (ssize_t)size){ printf("/!\\ Error : cannot read the PCF8591.\n"); dev->control = dev->pending = -1; return -1;}
+    pcf8591_set_pending(dev, size + 1); ///< same alignment as a control byte followed by the stale byte
     return 1;
 }
 
+/**
+ * @brief Write a control byte followed by DAC data.
+ * @param dev The converter.
+ * @param buffer 1st byte => config, next bytes => Data.
+ * @param size Number of bytes.
+ * @return 1 on success, -1 if the transfer failed.
+ */
+static inline int pcf8591_write(pcf8591_t *dev, const uint8_t *buffer, size_t size)
+{
+    int priority = i2c_bus_set_class(I2C_CLASS_RT); ///< DAC output and control byte : real-time class of the bus.
+    ssize_t written = i2c_bus_write(dev->i2c, dev->address, buffer, size);
+    i2c_bus_set_class(priority);
+    if (written != (ssize_t)size){ printf("/!\\ Error : cannot write on the PCF8591.\n"); dev->control = dev->pending = -1; return -1;}
+    dev->control = buffer[0];
+
+    /* a write starts no conversion : the pending one only stays valid if the input selection did not move */
+    if ((buffer[0] != dev->pending) || (buffer[0] & PCF8591_AUTO_INC)){ dev->pending = -1;}
+    return 1;
+}
+
+/**
+ * @brief Select the ADC input.
+ * @param dev The converter.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3 (0 / 1 / 2 or 0 / 1 in the differential modes)
+ * @return 1 on success, -1 on error.
+ */
+static inline int pcf8591_select_channel(pcf8591_t *dev, uint8_t channel)
+{
+    I2C_PROBE_BEGIN(pcf8591, select_channel, start_ns);
+    int result = 1;
+    int nb_byte = 0;
+    int control = pcf8591_control(dev, channel);
+    if (control < 0){return -1;}
+    uint8_t select_channel[1] = {control};
+    if (dev->control != select_channel[0]) ///< already selected, no need to wait again
+    {
+        nb_byte = 1;
+        if (pcf8591_write(dev, select_channel, 1) < 0){ result = -1;}
+        else { usleep(100);}
+    }
+
+    I2C_PROBE_END(pcf8591, select_channel, start_ns, dev->address, nb_byte, channel);
+    return result;
+}
 
 /**
  * @brief Write a voltage on the output pin of the DAC.
+ * @param dev The converter.
  * @param DAC_tension_mv The voltage value that we want to write on the DAC output.
  * @return Nothing.
- * @warning Use the PCF8591_i2c_connect() function before using this function.
  */
-void PCF8591_write_voltage_mv(int DAC_tension_mv)
+static inline void pcf8591_write_voltage_mv(pcf8591_t *dev, int DAC_tension_mv)
 {
-    uint8_t dac_data_out = DAC_tension_mv * resolution / Vref;
+    uint8_t dac_data_out = pcf8591_mv_to_data(dev, DAC_tension_mv); ///< Nearest DAC code, from the table.
     uint8_t dac_voltage[2] = {PCF8591_DAC_RQST,dac_data_out}; ///< 2 bytes buffer. 1st byte => config, 2nd byte => Data.
-    write(fd, dac_voltage, 2); ///< Write to the DAC.
+    pcf8591_write(dev, dac_voltage, 2); ///< Write to the DAC.
 }
 
 /**
  * @brief Write a voltage on the output pin of the DAC.
+ * @param dev The converter.
  * @param DAC_data_in The 4 bits value that we want to write on the DAC output.
  * @return Nothing.
+ */
+static inline void pcf8591_write_data(pcf8591_t *dev, uint8_t DAC_data_in)
+{
+    I2C_PROBE_BEGIN(pcf8591, write_data, start_ns);
+    uint8_t dac_voltage[2] = {PCF8591_DAC_RQST,DAC_data_in}; ///< 2 bytes buffer. 1st byte => config, 2nd byte => Data.
+    pcf8591_write(dev, dac_voltage, 2); ///< Write to the DAC.
+    I2C_PROBE_END(pcf8591, write_data, start_ns, dev->address, 2, DAC_data_in);
+}
+
+/**
+ * @brief Write a block of samples on the DAC output.
+ * The PCF8591 latches a new DAC value for every data byte following the control byte. The block is a bulk access
+ * of the bus (I2C_CLASS_BULK) : it is sent in pieces of PCF8591_BULK_CHUNK samples, each behind its own control byte,
+ * and the real-time accesses waiting go between two pieces (i2c_bus_yield()).
+ * The samples of a piece are output at the I2C bus rate (9 clock cycles per sample).
+ * @param dev The converter.
+ * @param samples The 8 bit values to write on the DAC output, in order.
+ * @param n Number of samples.
+ * @return Number of samples written, -1 if a transfer failed.
+ */
+static inline int pcf8591_write_block(pcf8591_t *dev, const uint8_t *samples, size_t n)
+{
+    uint8_t piece[PCF8591_BULK_CHUNK + 1]; ///< 1st byte => config, next bytes => Data.
+    size_t written = 0;
+    int result = 1;
+
+    piece[0] = PCF8591_DAC_RQST;
+    int priority = i2c_bus_set_class(I2C_CLASS_BULK); ///< sample blocks : bulk class, the single writes go first.
+    i2c_bus_lock(dev->i2c);
+    while (written < n)
+    {
+        size_t chunk = n - written;
+        if (chunk > PCF8591_BULK_CHUNK){ chunk = PCF8591_BULK_CHUNK;}
+
+        memcpy(piece + 1, samples + written, chunk);
+        struct i2c_msg message = {.addr = dev->address, .flags = 0, .len = chunk + 1, .buf = piece};
+        if (i2c_bus_transfer_locked(dev->i2c, &message, 1) < 0){ result = -1; break;}
+        written += chunk;
+        if (written < n){ i2c_bus_yield(dev->i2c);} ///< preemption point between two pieces
+    }
+    i2c_bus_unlock(dev->i2c);
+    i2c_bus_set_class(priority);
+
+    if (result < 0){ printf("/!\\ Error : cannot write on the PCF8591.\n"); dev->control = dev->pending = -1; return -1;}
+    if (n > 0)
+    {
+        dev->control = PCF8591_DAC_RQST;
+        if (dev->pending != PCF8591_DAC_RQST){ dev->pending = -1;} ///< same rule as pcf8591_write()
+    }
+    return written;
+}
+
+/**
+ * @brief Read a voltage on each of the four pin of the ADC by cycling trough all of them. 
+ * @param dev The converter.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3
+ * @return 8 bit data of the selected channel (two's complement for a differential input)
+ * @note When the same channel was read less than PCF8591_PENDING_MAX_AGE_NS ago, the control byte and the stale byte are skipped.
+ */
+static inline uint8_t pcf8591_read_data(pcf8591_t *dev, uint8_t channel)
+{
+    int control_byte = pcf8591_control(dev, channel);
+    if (control_byte < 0){return 0;}
+
+    I2C_PROBE_BEGIN(pcf8591, read_data, start_ns);
+    uint8_t control[1] = {control_byte};
+    uint8_t data_in[2]; ///< 1st byte => last value stored during the previous use of the ADC, 2nd byte => data.
+    uint8_t data = 0;
+    int nb_byte;
+
+    /* same channel read a moment ago : the pending conversion is this channel, one byte is enough */
+    if (pcf8591_is_pending(dev, control[0]))
+    {
+        nb_byte = 1;
+        if (pcf8591_read(dev, data_in, 1) >= 0){ data = data_in[0];}
+    }
+    else
+    {
+        nb_byte = 3;
+        if (pcf8591_transfer(dev, control, 1, data_in, 2) >= 0){ data = data_in[1];}
+    }
+
+    I2C_PROBE_END(pcf8591, read_data, start_ns, dev->address, nb_byte, data);
+    return data;
+}
+
+/**
+ * @brief Read a fresh conversion of one ADC input, sampled during this call.
+ * The control byte and the stale byte are always sent and read, even when the same channel is pending : the data is
+ * the conversion started by this transfer, not the one left by the previous call (up to PCF8591_PENDING_MAX_AGE_NS old).
+ * Use it when the sample time matters (control loop, timestamped acquisition).
+ * @param dev The converter.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3
+ * @return 8 bit data of the selected channel (two's complement for a differential input), 0 on error (dev->control is then -1).
+ */
+static inline uint8_t pcf8591_read_data_now(pcf8591_t *dev, uint8_t channel)
+{
+    int control_byte = pcf8591_control(dev, channel);
+    if (control_byte < 0){return 0;}
+
+    I2C_PROBE_BEGIN(pcf8591, read_data, start_ns);
+    uint8_t control[1] = {control_byte};
+    uint8_t data_in[2]; ///< 1st byte => last value stored during the previous use of the ADC, 2nd byte => data.
+    uint8_t data = 0;
+
+    if (pcf8591_transfer(dev, control, 1, data_in, 2) >= 0){ data = data_in[1];}
+
+    I2C_PROBE_END(pcf8591, read_data, start_ns, dev->address, 3, data);
+    return data;
+}
+
+/**
+ * @brief Read a voltage on each of the four pin of the ADC by cycling trough all of them. 
+ * @param dev The converter.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3
+ * @return Input value in mV (signed for a differential input).
+ */
+static inline int pcf8591_read_voltage_mv(pcf8591_t *dev, uint8_t channel)
+{
+    if (channel >= pcf8591_nb_input(dev->mode)){ printf("/!\\ Error : channel not suported. Select a compliant channel.\n"); return 0;}
+
+    int data_in_mv = pcf8591_data_to_mv(dev, channel, pcf8591_read_data(dev, channel)); ///< Data conversion from ADC resolution to mV.
+    return data_in_mv;
+}
+
+/**
+ * @brief Read the 8 bit data of the four ADC inputs in one auto-increment transaction.
+ * The inputs are read as four single-ended inputs whatever the active mode (see pcf8591_read_inputs()).
+ * @param dev The converter.
+ * @param data_in 4 bytes buffer that will get the A0, A1, A2 and A3 data.
+ * @return 1 on success, -1 if the transfer failed.
+ */
+static inline int pcf8591_read_all_data(pcf8591_t *dev, uint8_t data_in[PCF8591_NB_CHANNEL])
+{
+    uint8_t control[1] = {PCF8591_DAC_RQST | PCF8591_AUTO_INC}; ///< Start on A0 and let the PCF8591 cycle through the inputs.
+    uint8_t buffer[PCF8591_NB_CHANNEL + 1]; ///< 1st byte => last value of the previous conversion, then A0 to A3.
+
+    if (pcf8591_is_pending(dev, control[0]))
+    {
+        /* the previous cycle ended on A0 : go on without control byte nor stale byte */
+        return pcf8591_read(dev, data_in, PCF8591_NB_CHANNEL);
+    }
+    if (pcf8591_transfer(dev, control, 1, buffer, sizeof(buffer)) < 0){return -1;}
+
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++)
+    {
+        data_in[i] = buffer[i + 1];
+    }
+    return 1;
+}
+
+/**
+ * @brief Read the voltage of the four ADC inputs in one auto-increment transaction.
+ * @param dev The converter.
+ * @param data_in_mv 4 entries buffer that will get the A0, A1, A2 and A3 voltages in mV.
+ * @return 1 on success, -1 if the transfer failed.
+ */
+static inline int pcf8591_read_all(pcf8591_t *dev, unsigned short int data_in_mv[PCF8591_NB_CHANNEL])
+{
+    uint8_t data_in[PCF8591_NB_CHANNEL];
+
+    if (pcf8591_read_all_data(dev, data_in) < 0){return -1;}
+
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++)
+    {
+        /* the table follows the active mode : compute the single-ended voltage when another mode is active */
+        data_in_mv[i] = (dev->mode == PCF8591_MODE_SINGLE) ? (unsigned short int)pcf8591_data_to_mv(dev, i, data_in[i]) : lround((double)data_in[i] * dev->vref_mv / resolution);
+    }
+    return 1;
+}
+
+/**
+ * @brief Read all the channels of the active input mode in one auto-increment transaction.
+ * Single-ended channels give 0 to 255, differential channels give -128 to 127.
+ * @param dev The converter.
+ * @param values Buffer of at least PCF8591_NB_CHANNEL entries that will get the value of each channel.
+ * @return Number of channels read (4, 3 or 2 depending on the mode), -1 if the transfer failed.
+ */
+static inline int pcf8591_read_inputs(pcf8591_t *dev, int16_t values[PCF8591_NB_CHANNEL])
+{
+    uint8_t control[1] = {PCF8591_DAC_RQST | PCF8591_AUTO_INC | dev->mode};
+    uint8_t buffer[PCF8591_NB_CHANNEL + 1]; ///< 1st byte => last value of the previous conversion, then the channels.
+    int nb_input = pcf8591_nb_input(control[0]);
+    uint8_t *data_in = buffer + 1;
+
+    if (pcf8591_is_pending(dev, control[0]))
+    {
+        /* the previous cycle ended on channel 0 : go on without control byte nor stale byte */
+        if (pcf8591_read(dev, data_in, nb_input) < 0){return -1;}
+    }
+    else if (pcf8591_transfer(dev, control, 1, buffer, nb_input + 1) < 0){return -1;}
+
+    for (int i = 0; i < nb_input; i++)
+    {
+        values[i] = pcf8591_is_differential(control[0], i) ? (int8_t)data_in[i] : data_in[i];
+    }
+    return nb_input;
+}
+
+/**
+ * @brief Read the voltage of all the channels of the active input mode in one auto-increment transaction.
+ * @param dev The converter.
+ * @param data_in_mv Buffer of at least PCF8591_NB_CHANNEL entries that will get the voltage of each channel in mV (signed for a differential input).
+ * @return Number of channels read (4, 3 or 2 depending on the mode), -1 if the transfer failed.
+ */
+static inline int pcf8591_read_inputs_mv(pcf8591_t *dev, int data_in_mv[PCF8591_NB_CHANNEL])
+{
+    int16_t values[PCF8591_NB_CHANNEL];
+    int nb_input = pcf8591_read_inputs(dev, values);
+
+    for (int i = 0; i < nb_input; i++)
+    {
+        data_in_mv[i] = pcf8591_data_to_mv(dev, i, (uint8_t)values[i]); ///< Data conversion from ADC resolution to mV.
+    }
+    return nb_input;
+}
+
+/**
+ * @brief Read several auto-increment cycles of the active input mode in one transaction, at the bus rate.
+ * @param dev The converter.
+ * @param data Buffer that will get nb_scan * (number of channels of the mode) bytes, channel 0 first in each cycle.
+ * @param nb_scan Number of cycles (up to (PCF8591_BLOCK_MAX - 1) / number of channels).
+ * @return Number of bytes read, -1 if the transfer failed.
+ */
+static inline int pcf8591_read_burst(pcf8591_t *dev, uint8_t *data, int nb_scan)
+{
+    uint8_t control[1] = {PCF8591_DAC_RQST | PCF8591_AUTO_INC | dev->mode};
+    uint8_t buffer[PCF8591_BLOCK_MAX]; ///< 1st byte => last value of the previous conversion, then the cycles.
+    int size = nb_scan * pcf8591_nb_input(control[0]);
+
+    if ((nb_scan < 1) | (size + 1 > PCF8591_BLOCK_MAX)){ printf("/!\\ Error : burst size not suported.\n"); return -1;}
+
+    if (pcf8591_is_pending(dev, control[0]))
+    {
+        /* the previous cycle ended on channel 0 : go on without control byte nor stale byte */
+        if (pcf8591_read(dev, data, size) < 0){return -1;}
+        return size;
+    }
+    if (pcf8591_transfer(dev, control, 1, buffer, size + 1) < 0){return -1;}
+    memcpy(data, buffer + 1, size);
+    return size;
+}
+
+/**
+ * @brief Completion function of the batched operations : update the control byte cache of the converter.
+ * @param op The operation, arg => the converter.
+ */
+static inline void pcf8591_batch_done(i2c_op_t *op)
+{
+    pcf8591_t *dev = op->arg;
+
+    if (op->status != I2C_OP_DONE){ dev->control = dev->pending = -1; return;}
+    dev->control = op->tx[0];
+    if (op->rx_len){ pcf8591_set_pending(dev, op->rx_len);}
+    else if ((op->tx[0] != dev->pending) || (op->tx[0] & PCF8591_AUTO_INC)){ dev->pending = -1;}
+}
+
+/**
+ * @brief Fill the operation reading all the channels of the active input mode (see pcf8591_batch_read_all()).
+ * @return The operation.
+ */
+static inline i2c_op_t *pcf8591_op_read_all(pcf8591_t *dev, i2c_op_t *op, uint8_t data[PCF8591_NB_CHANNEL + 1])
+{
+    uint8_t control[1] = {PCF8591_DAC_RQST | PCF8591_AUTO_INC | dev->mode};
+
+    i2c_op_write_read(op, dev->address, control, 1, data, pcf8591_nb_input(control[0]) + 1);
+    op->done = pcf8591_batch_done;
+    op->arg = dev;
+    return op;
+}
+
+/**
+ * @brief Fill the operation of a DAC write (see pcf8591_batch_write_data()).
+ * @return The operation.
+ */
+static inline i2c_op_t *pcf8591_op_write_data(pcf8591_t *dev, i2c_op_t *op, uint8_t DAC_data_in)
+{
+    uint8_t dac_voltage[2] = {PCF8591_DAC_RQST, DAC_data_in}; ///< 1st byte => config, 2nd byte => Data.
+
+    i2c_op_write(op, dev->address, dac_voltage, 2);
+    op->done = pcf8591_batch_done;
+    op->arg = dev;
+    return op;
+}
+
+/**
+ * @brief Queue the reading of all the channels of the active input mode in a batch (i2c_batch.h).
+ * @param batch Batch of the bus of the converter.
+ * @param dev The converter.
+ * @param op Operation used, valid until the flush.
+ * @param data Buffer of PCF8591_NB_CHANNEL + 1 bytes : after the flush, data[1] to data[n] are the channels 0 to n - 1
+ *             (4, 3 or 2 depending on the mode), data[0] is the previous conversion.
+ * @return 1 on success, -1 if the automatic flush of a full batch had a failed operation.
+ */
+static inline int pcf8591_batch_read_all(i2c_batch_t *batch, pcf8591_t *dev, i2c_op_t *op, uint8_t data[PCF8591_NB_CHANNEL + 1])
+{
+    return i2c_batch_add(batch, pcf8591_op_read_all(dev, op, data));
+}
+
+/**
+ * @brief Queue a DAC write in a batch (i2c_batch.h).
+ * @param batch Batch of the bus of the converter.
+ * @param dev The converter.
+ * @param op Operation used, valid until the flush.
+ * @param DAC_data_in 8 bit value of the DAC output.
+ * @return 1 on success, -1 if the automatic flush of a full batch had a failed operation.
+ */
+static inline int pcf8591_batch_write_data(i2c_batch_t *batch, pcf8591_t *dev, i2c_op_t *op, uint8_t DAC_data_in)
+{
+    return i2c_batch_add(batch, pcf8591_op_write_data(dev, op, DAC_data_in));
+}
+
+/**
+ * @brief Submit the reading of all the channels of the active input mode to the worker of the bus (i2c_async.h).
+ *        The operation is put in the completion queue once done (i2c_async_reap()).
+ * @param async Worker of the bus of the converter.
+ * @param dev The converter.
+ * @param op Operation used, owned by the worker until it is reaped.
+ * @param data Buffer of PCF8591_NB_CHANNEL + 1 bytes, filled as by pcf8591_batch_read_all().
+ * @return 1 on success, -1 if the worker is closed.
+ */
+static inline int pcf8591_async_read_all(i2c_async_t *async, pcf8591_t *dev, i2c_op_t *op, uint8_t data[PCF8591_NB_CHANNEL + 1])
+{
+    pcf8591_op_read_all(dev, op, data)->post = 1;
+    return i2c_async_submit(async, op);
+}
+
+/**
+ * @brief Submit a DAC write to the worker of the bus (i2c_async.h), put in the completion queue once done.
+ * @param async Worker of the bus of the converter.
+ * @param dev The converter.
+ * @param op Operation used, owned by the worker until it is reaped.
+ * @param DAC_data_in 8 bit value of the DAC output.
+ * @return 1 on success, -1 if the worker is closed.
+ */
+static inline int pcf8591_async_write_data(i2c_async_t *async, pcf8591_t *dev, i2c_op_t *op, uint8_t DAC_data_in)
+{
+    pcf8591_op_write_data(dev, op, DAC_data_in)->post = 1;
+    return i2c_async_submit(async, op);
+}
+
+/**
+ * @brief Converters of one bus, read together by pcf8591_scan().
+ */
+typedef struct
+{
+    pcf8591_t *dev[PCF8591_SCAN_MAX];                  ///< Converters of the bus.
+    uint8_t (*data_in[PCF8591_SCAN_MAX])[PCF8591_NB_CHANNEL]; ///< Where to store the data of each converter.
+    int nb_device;                                     ///< Number of converters on the bus.
+    int result;                                        ///< 1 on success, -1 if the transfer failed.
+} pcf8591_scan_bus_t;
+
+/**
+ * @brief Read the four inputs of every converter of one bus in a single ioctl(I2C_RDWR) call.
+ * @param arg The bus (pcf8591_scan_bus_t).
+ * @return NULL.
+ */
+static inline void *pcf8591_scan_bus(void *arg)
+{
+    pcf8591_scan_bus_t *bus = arg;
+    struct i2c_msg messages[2 * PCF8591_SCAN_MAX];
+    uint8_t control[PCF8591_SCAN_MAX];
+    int skip[PCF8591_SCAN_MAX];
+    uint8_t buffer[PCF8591_SCAN_MAX][PCF8591_NB_CHANNEL + 1];
+    bus->result = 1;
+
+    /* the kernel accepts at most I2C_RDWR_IOCTL_MAX_MSGS messages (2 per converter) in one call */
+    for (int first = 0; first < bus->nb_device; first += I2C_RDWR_IOCTL_MAX_MSGS / 2)
+    {
+        int nb = bus->nb_device - first;
+        if (nb > I2C_RDWR_IOCTL_MAX_MSGS / 2){ nb = I2C_RDWR_IOCTL_MAX_MSGS / 2;}
+
+        int nb_message = 0;
+        for (int i = 0; i < nb; i++)
+        {
+            pcf8591_t *dev = bus->dev[first + i];
+            control[i] = PCF8591_DAC_RQST | PCF8591_AUTO_INC;
+            skip[i] = pcf8591_is_pending(dev, control[i]); ///< cycle already running : no control byte nor stale byte
+            if (!skip[i]){ messages[nb_message++] = (struct i2c_msg){.addr = dev->address, .flags = 0, .len = 1, .buf = &control[i]};}
+            messages[nb_message++] = (struct i2c_msg){.addr = dev->address, .flags = I2C_M_RD, .len = PCF8591_NB_CHANNEL + !skip[i], .buf = buffer[i]};
+        }
+        if (i2c_bus_transfer(bus->dev[first]->i2c, messages, nb_message) < 0)
+        {
+            printf("/!\\ Error : I2C transfer failed on %s.\n", bus->dev[first]->bus);
+            for (int i = 0; i < nb; i++){ bus->dev[first + i]->control = bus->dev[first + i]->pending = -1;}
+            bus->result = -1;
+            continue;
+        }
+        for (int i = 0; i < nb; i++)
+        {
+            bus->dev[first + i]->control = control[i];
+            pcf8591_set_pending(bus->dev[first + i], PCF8591_NB_CHANNEL + 1);
+            memcpy(*bus->data_in[first + i], buffer[i] + !skip[i], PCF8591_NB_CHANNEL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Read the four inputs of several converters, on one or several I2C buses.
+ * The converters of a bus are read in a single ioctl(I2C_RDWR) call, the buses are read in parallel (one thread per bus).
+ * @param devs The converters (opened with pcf8591_open()).
+ * @param nb_device Number of converters (up to PCF8591_SCAN_MAX).
+ * @param data_in Buffer that will get the A0 to A3 data of each converter.
+ * @return 1 on success, -1 if a transfer failed.
+ * @warning Add -pthread to the gcc command line when using this function.
+ */
+static inline int pcf8591_scan(pcf8591_t *devs[], int nb_device, uint8_t data_in[][PCF8591_NB_CHANNEL])
+{
+    pcf8591_scan_bus_t buses[PCF8591_SCAN_MAX];
+    pthread_t threads[PCF8591_SCAN_MAX];
+    int started[PCF8591_SCAN_MAX] = {0};
+    int nb_bus = 0;
+    int result = 1;
+
+    if ((nb_device < 1) | (nb_device > PCF8591_SCAN_MAX)){ printf("/!\\ Error : number of PCF8591 not suported.\n"); return -1;}
+
+    /* group the converters by bus */
+    for (int i = 0; i < nb_device; i++)
+    {
+        int b = 0;
+        while ((b < nb_bus) && (strcmp(buses[b].dev[0]->bus, devs[i]->bus) != 0)){ b++;}
+        if (b == nb_bus){ buses[nb_bus++].nb_device = 0;}
+        buses[b].dev[buses[b].nb_device] = devs[i];
+        buses[b].data_in[buses[b].nb_device] = &data_in[i];
+        buses[b].nb_device++;
+    }
+
+    /* one thread per extra bus, the first bus is read by the calling thread */
+    for (int b = 1; b < nb_bus; b++)
+    {
+        started[b] = (pthread_create(&threads[b], NULL, pcf8591_scan_bus, &buses[b]) == 0);
+        if (!started[b]){ pcf8591_scan_bus(&buses[b]);}
+    }
+    pcf8591_scan_bus(&buses[0]);
+    for (int b = 1; b < nb_bus; b++)
+    {
+        if (started[b]){ pthread_join(threads[b], NULL);}
+    }
+
+    for (int b = 0; b < nb_bus; b++)
+    {
+        if (buses[b].result < 0){ result = -1;}
+    }
+    return result;
+}
+
+#ifndef PCF8591_SEQUENCE_MAX
+#define PCF8591_SEQUENCE_MAX 16 ///< Maximum length of a pipelined channel schedule.
+#endif
+
+/**
+ * @brief Pipelined acquisition of a known channel schedule.
+ *
+ * The byte read after a channel select is the result of the conversion started during the previous read,
+ * so when the next channel is known in advance, the "stale" byte is the real sample of the channel selected before.
+ * Each sample then costs one control byte and one data byte instead of one control byte and two data bytes.
+ */
+typedef struct
+{
+    pcf8591_t *dev;                        ///< Converter sampled.
+    uint8_t channel[PCF8591_SEQUENCE_MAX]; ///< Channel schedule, played in a loop.
+    int nb_channel;                        ///< Number of entries in the schedule.
+    int index;                             ///< Index of the channel whose conversion is pending in the PCF8591.
+    int primed;                            ///< 1 once the first conversion of the schedule has been started.
+} pcf8591_sequence_t;
+
+/**
+ * @brief Initialise a pipelined channel schedule.
+ * @param seq The sequence to initialise.
+ * @param dev The converter to sample.
+ * @param channels List of the channels to sample (0 / 1 / 2 / 3 in the active input mode), played in a loop. NULL for all the channels of the mode.
+ * @param nb_channel Number of channels in the list (1 to PCF8591_SEQUENCE_MAX).
+ * @return 1 on success, -1 if the schedule is not valid.
+ */
+static inline int PCF8591_sequence_init(pcf8591_sequence_t *seq, pcf8591_t *dev, const uint8_t *channels, int nb_channel)
+{
+    if (channels == NULL){ nb_channel = pcf8591_nb_input(dev->mode);}
+    if ((nb_channel < 1) | (nb_channel > PCF8591_SEQUENCE_MAX)){ printf("/!\\ Error : sequence length not suported.\n"); return -1;}
+
+    for (int i = 0; i < nb_channel; i++)
+    {
+        uint8_t channel = (channels == NULL) ? i : channels[i];
+        if (channel >= pcf8591_nb_input(dev->mode)){ printf("/!\\ Error : channel not suported. Select a compliant channel.\n"); return -1;}
+        seq->channel[i] = channel;
+    }
+    seq->dev = dev;
+    seq->nb_channel = nb_channel;
+    seq->index = 0;
+    seq->primed = 0;
+    return 1;
+}
+
+/**
+ * @brief Read the next samples of a pipelined channel schedule.
+ * @param seq The sequence initialised by PCF8591_sequence_init().
+ * @param channels Buffer that will get the channel of each sample (can be NULL).
+ * @param data_in Buffer that will get the 8 bit data of each sample.
+ * @param nb_sample Number of samples to read.
+ * @return Number of samples read, -1 if the transfer failed.
+ * @warning Don't use the other read functions on the same converter between two calls, they would change the pending conversion.
+ */
+static inline int PCF8591_sequence_read(pcf8591_sequence_t *seq, uint8_t *channels, uint8_t *data_in, int nb_sample)
+{
+    uint8_t buffer[1];
+
+    if (!seq->primed)
+    {
+        /* start the conversion of the first channel, the byte read is the previous conversion */
+        uint8_t control[1] = {PCF8591_DAC_RQST | seq->dev->mode | seq->channel[seq->index]};
+        if (pcf8591_transfer(seq->dev, control, 1, buffer, 1) < 0){return -1;}
+        seq->primed = 1;
+    }
+
+    for (int i = 0; i < nb_sample; i++)
+    {
+        int next = (seq->index + 1) % seq->nb_channel;
+
+        /* select the next channel, the byte read is the result of the pending conversion */
+        uint8_t control[1] = {PCF8591_DAC_RQST | seq->dev->mode | seq->channel[next]};
+        int result = (seq->dev->control == control[0]) ? pcf8591_read(seq->dev, buffer, 1) : pcf8591_transfer(seq->dev, control, 1, buffer, 1);
+        if (result < 0){ seq->primed = 0; return -1;}
+
+        if (channels != NULL){ channels[i] = seq->channel[seq->index];}
+        data_in[i] = buffer[0];
+        seq->index = next;
+    }
+    return nb_sample;
+}
+
+/* Functions working on the default converter ------------------------------------------------------------------------- */
+
+/**
+ * @brief Select the ADC input of the default converter.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3
+ * @return 1 on success, -1 on error.
  * @warning Use the PCF8591_i2c_connect() function before using this function.
  */
-void PCF8591_write_data(uint8_t DAC_data_in)
+static inline int select_channel(uint8_t channel)
 {
-    unsigned char dac_voltage[2] = {PCF8591_DAC_RQST,DAC_data_in}; ///< 2 bytes buffer. 1st byte => config, 2nd byte => Data.
-    write(fd, dac_voltage, 2); ///< Write to the DAC.
+    return pcf8591_select_channel(&pcf8591_default, channel);
+}
+
+/**
+ * @brief Send the control bytes and read the answer of the default converter in one combined I2C transaction.
+ * @param control Control bytes to send.
+ * @param size_control Number of control bytes.
+ * @param data_in Buffer that will get the data read.
+ * @param size_data Number of bytes to read.
+ * @return 1 on success, -1 if the transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_transfer(const uint8_t *control, int size_control, uint8_t *data_in, int size_data)
+{
+    return pcf8591_transfer(&pcf8591_default, control, size_control, data_in, size_data);
+}
+
+/**
+ * @brief Write a voltage on the output pin of the DAC.
+ * @param DAC_tension_mv The voltage value that we want to write on the DAC output.
+ * @return Nothing.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline void PCF8591_write_voltage_mv(int DAC_tension_mv)
+{
+    pcf8591_write_voltage_mv(&pcf8591_default, DAC_tension_mv);
+}
+
+/**
+ * @brief Write a voltage on the output pin of the DAC.
+ * @param DAC_data_in The 4 bits value that we want to write on the DAC output.
+ * @return Nothing.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline void PCF8591_write_data(uint8_t DAC_data_in)
+{
+    pcf8591_write_data(&pcf8591_default, DAC_data_in);
+}
+
+/**
+ * @brief Write a block of samples on the DAC output (see pcf8591_write_block()).
+ * @param samples The 8 bit values to write on the DAC output, in order.
+ * @param n Number of samples.
+ * @return Number of samples written, -1 if a transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_write_block(const uint8_t *samples, size_t n)
+{
+    return pcf8591_write_block(&pcf8591_default, samples, n);
 }
 
 /**
  * @brief Read a voltage on each of the four pin of the ADC by cycling trough all of them. 
  * @param Channel number -> possible value : 0 / 1 / 2 / 3
- * @return Input value in mV.
+ * @return Input value in mV (signed for a differential input).
  * @warning Use the PCF8591_i2c_connect() function before using this function.
  */
-unsigned short int PCF8591_read_voltage_mv(uint8_t channel)
+static inline int PCF8591_read_voltage_mv(uint8_t channel)
 {
-    if(select_channel(channel) < 0){return 0;}
-
-    uint8_t data_in[1]; ///< 1 byte buffer that will get ADC data.
-    read(fd, data_in, 1); ///< it represent the last value read and stored in the register during the previous use of the ADC
-    read(fd, data_in, 1); ///< Data reading.
-    unsigned short int data_in_mv = *data_in *(Vref/255); ///< Data conversion from ADC resolution to mV.
-    return data_in_mv;
+    return pcf8591_read_voltage_mv(&pcf8591_default, channel);
 }
 
 /**
@@ -201,14 +1241,63 @@ unsigned short int PCF8591_read_voltage_mv(uint8_t channel)
  * @return 8 bit data of the selected channel
  * @warning Use the PCF8591_i2c_connect() function before using this function.
  */
-uint8_t PCF8591_read_data(uint8_t channel)
+static inline uint8_t PCF8591_read_data(uint8_t channel)
+{
+    return pcf8591_read_data(&pcf8591_default, channel);
+}
+
+/**
+ * @brief Read the 8 bit data of the four ADC inputs in one auto-increment transaction.
+ * @param data_in 4 bytes buffer that will get the A0, A1, A2 and A3 data.
+ * @return 1 on success, -1 if the transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_read_all_data(uint8_t data_in[PCF8591_NB_CHANNEL])
+{
+    return pcf8591_read_all_data(&pcf8591_default, data_in);
+}
+
+/**
+ * @brief Read the voltage of the four ADC inputs in one auto-increment transaction.
+ * @param data_in_mv 4 entries buffer that will get the A0, A1, A2 and A3 voltages in mV.
+ * @return 1 on success, -1 if the transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_read_all(unsigned short int data_in_mv[PCF8591_NB_CHANNEL])
+{
+    return pcf8591_read_all(&pcf8591_default, data_in_mv);
+}
+
+/**
+ * @brief Select the analog input programming of the default converter.
+ * @param mode PCF8591_MODE_SINGLE / PCF8591_MODE_DIFF3 / PCF8591_MODE_MIXED / PCF8591_MODE_DIFF2.
+ * @return 1 on success, -1 if the mode is not valid.
+ */
+static inline int PCF8591_set_mode(uint8_t mode)
+{
+    return pcf8591_set_mode(&pcf8591_default, mode);
+}
+
+/**
+ * @brief Read all the channels of the active input mode in one auto-increment transaction (see pcf8591_read_inputs()).
+ * @param values Buffer of at least PCF8591_NB_CHANNEL entries.
+ * @return Number of channels read, -1 if the transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_read_inputs(int16_t values[PCF8591_NB_CHANNEL])
 {
-    if(select_channel(channel) < 0){return 0;}
+    return pcf8591_read_inputs(&pcf8591_default, values);
+}
 
-    uint8_t data_in[1]; ///< 1 byte buffer that will get ADC data.
-    read(fd, data_in, 1); ///< it represent the last value read and stored in the register during the previous use of the ADC
-    read(fd, data_in, 1); ///< Data reading.
-    return *data_in;
+/**
+ * @brief Read the voltage of all the channels of the active input mode in one auto-increment transaction (see pcf8591_read_inputs_mv()).
+ * @param data_in_mv Buffer of at least PCF8591_NB_CHANNEL entries.
+ * @return Number of channels read, -1 if the transfer failed.
+ * @warning Use the PCF8591_i2c_connect() function before using this function.
+ */
+static inline int PCF8591_read_inputs_mv(int data_in_mv[PCF8591_NB_CHANNEL])
+{
+    return pcf8591_read_inputs_mv(&pcf8591_default, data_in_mv);
 }
 
 /**
@@ -216,18 +1305,13 @@ uint8_t PCF8591_read_data(uint8_t channel)
  * @param Nothing.
  * @return Nothing.
  */
-void PCF8591_i2c_connect (void)
+static inline void PCF8591_i2c_connect (void)
 {
-    if ((fd = open(i2c_chip, O_RDWR)) < 0) ///< The i2c communication is initiated by opening a file.
+    if (pcf8591_open(&pcf8591_default, RPI_I2C_DEVICE, PCF8591_I2C_ADDR) < 0)
     {
-        printf("Cannot initiate i2c connection\n");
         exit(1);
     }
-    else
-    {
-        ioctl(fd, I2C_SLAVE, PCF8591_I2C_ADDR); ///< Change default i2c address in i2c-dev.h file by PCF8591 address.
-        printf("i2c connection initiated\n");
-    }
+    printf("i2c connection initiated\n");
 }
 
 #endif
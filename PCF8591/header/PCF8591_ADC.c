@@ -7,7 +7,7 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8591
- * compilation : gcc -Wall -o PCF8591_ADC PCF8591_ADC.c 
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC PCF8591_ADC.c PCF8591.c ../../i2c/i2c_bus.c 
  *  
  * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
  * 
@@ -21,12 +21,10 @@ int main(void)
     PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
     while(1)
     {
-        int A0_voltage = PCF8591_read_voltage_mv(0); ///< Read voltage on A0 input
-        int A1_voltage = PCF8591_read_voltage_mv(1); ///< Read voltage on A1 input
-        int A2_voltage = PCF8591_read_voltage_mv(2); ///< Read voltage on A2 input
-        int A3_voltage = PCF8591_read_voltage_mv(3); ///< Read voltage on A3 input
+        unsigned short int A_voltage[PCF8591_NB_CHANNEL]; ///< Voltages of the A0, A1, A2 and A3 inputs
+        PCF8591_read_all(A_voltage); ///< Read voltage on all inputs in one auto-increment transaction
 
-        printf("Voltage on ADC :\n> A0 --> %d mV\n> A1 --> %d mV\n> A2 --> %d mV\n> A3 --> %d mV\n\n",A0_voltage,A1_voltage,A2_voltage,A3_voltage);
+        printf("Voltage on ADC :\n> A0 --> %d mV\n> A1 --> %d mV\n> A2 --> %d mV\n> A3 --> %d mV\n\n",A_voltage[0],A_voltage[1],A_voltage[2],A_voltage[3]);
         sleep(1);
     }
 }
\ No newline at end of file
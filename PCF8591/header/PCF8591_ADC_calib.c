@@ -0,0 +1,67 @@
+/**
+ * @brief This program captures the calibration points of one ADC input of the PCF8591 component from known voltages,
+ *        and adds them to the calibration file of the converter.
+
+ * @file PCF8591_ADC_calib.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591, a voltage source and a voltmeter
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC_calib PCF8591_ADC_calib.c PCF8591.c ../../i2c/i2c_bus.c -lm
+ *
+ * usage : ./PCF8591_ADC_calib <file> <mode 0..3> <channel>
+ *         For each point, apply a voltage on the input, measure it and type it in mV. An empty line ends the capture.
+ *         The other channels of the file are kept, the points of this channel are replaced.
+ *
+ * @warning Don't forget copy the PCF8591.h and PCF8591_calib.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_calib.h"
+
+/* Conversions averaged per point */
+#define NB_AVERAGE 64
+
+int main(int argc, char *argv[])
+{
+    char line[64];
+
+    if (argc != 4){ printf("usage : %s <file> <mode 0..3> <channel>\n", argv[0]); return -1;}
+    const char *path = argv[1];
+    int mode = atoi(argv[2]), channel = atoi(argv[3]);
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (access(path, R_OK) == 0){ PCF8591_adc_load(&pcf8591_default, path);} ///< keep the other channels
+    if ((mode < 0) | (mode >= PCF8591_NB_MODE) || (PCF8591_set_mode(mode << 4) < 0)){ return -1;}
+    if (pcf8591_control(&pcf8591_default, channel) < 0){ return -1;}
+    PCF8591_adc_clear(&pcf8591_default, channel);
+
+    while (1)
+    {
+        printf("Voltage applied on channel %d (mV), empty line to finish : ", channel);
+        fflush(stdout);
+        if ((fgets(line, sizeof(line), stdin) == NULL) || (line[0] == '\n')){ break;}
+
+        int16_t code;
+        if (PCF8591_adc_measure(&pcf8591_default, channel, NB_AVERAGE, &code) < 0){ return -1;}
+        int nb_point = PCF8591_adc_add_point(&pcf8591_default, channel, code, atoi(line));
+        if (nb_point > 0){ printf("> code %.2f --> point %d\n", (double)code / (1 << PCF8591_CALIB_FRAC), nb_point);}
+    }
+
+    const pcf8591_adc_calib_t *calib = &pcf8591_default.adc_calib[mode][channel];
+    if (calib->nb_point == 0){ printf("No point, nothing saved.\n"); return 0;}
+    if (calib->nb_point >= 2)
+    {
+        double gain = (double)(calib->mv[calib->nb_point - 1] - calib->mv[0]) * (1 << PCF8591_CALIB_FRAC) * resolution
+                      / ((calib->code[calib->nb_point - 1] - calib->code[0]) * (double)Vref);
+        printf("Gain %.4f, offset %d mV\n", gain, pcf8591_data_to_mv(&pcf8591_default, channel, 0));
+    }
+    for (int code = 0; code < 256; code += 51)
+    {
+        int value = pcf8591_is_differential(mode << 4, channel) ? (int8_t)code : code;
+        printf("> code %3d --> %5d mV (ideal %5ld mV)\n", code, pcf8591_data_to_mv(&pcf8591_default, channel, code), lround((double)value * Vref / resolution));
+    }
+    return PCF8591_adc_save(&pcf8591_default, path);
+}
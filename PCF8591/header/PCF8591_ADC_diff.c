@@ -0,0 +1,33 @@
+/**
+ * @brief This program reads and displays the 2 differential voltages in mv (A0 - A1 and A2 - A3) of the PCF8591 component,
+ *        for example the outputs of two bridge sensors.
+
+ * @file PCF8591_ADC_diff.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC_diff PCF8591_ADC_diff.c PCF8591.c ../../i2c/i2c_bus.c
+ *
+ * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591.h"
+
+int main(void)
+{
+    int voltage[PCF8591_NB_CHANNEL]; ///< Voltages of the A0 - A1 and A2 - A3 inputs
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    PCF8591_set_mode(PCF8591_MODE_DIFF2); ///< 2 differential inputs
+    while(1)
+    {
+        if (PCF8591_read_inputs_mv(voltage) < 0){ return -1;} ///< Read both inputs in one auto-increment transaction
+
+        printf("Differential voltage on ADC :\n> A0 - A1 --> %d mV\n> A2 - A3 --> %d mV\n\n", voltage[0], voltage[1]);
+        sleep(1);
+    }
+}
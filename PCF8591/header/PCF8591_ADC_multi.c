@@ -0,0 +1,53 @@
+/**
+ * @brief This program reads and displays, every second, the 4 voltages in mv of several PCF8591 components
+ *        given on the command line, the converters of a same bus being read in a single transaction.
+
+ * @file PCF8591_ADC_multi.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, several PCF8591 (A0, A1 and A2 pins wired to different addresses)
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC_multi PCF8591_ADC_multi.c PCF8591.c ../../i2c/i2c_bus.c -pthread
+ *
+ * usage : ./PCF8591_ADC_multi /dev/i2c-1:0x48 /dev/i2c-1:0x49 /dev/i2c-3:0x48 ...
+ *
+ * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591.h"
+
+int main(int argc, char *argv[])
+{
+    static pcf8591_t converters[PCF8591_SCAN_MAX]; ///< ~6 kB each with the conversion tables, kept out of the stack
+    pcf8591_t *devs[PCF8591_SCAN_MAX];
+    uint8_t data_in[PCF8591_SCAN_MAX][PCF8591_NB_CHANNEL];
+    int nb_device = argc - 1;
+
+    if ((nb_device < 1) | (nb_device > PCF8591_SCAN_MAX)){ printf("usage : %s /dev/i2c-1:0x48 [/dev/i2c-1:0x49 ...]\n", argv[0]); return -1;}
+
+    for (int i = 0; i < nb_device; i++)
+    {
+        char bus[32];
+        unsigned int address;
+        if (sscanf(argv[i + 1], "%31[^:]:%x", bus, &address) != 2){ printf("/!\\ Error : bad converter %s (bus:address expected).\n", argv[i + 1]); return -1;}
+        if (pcf8591_open(&converters[i], bus, address) < 0){ return -1;}
+        devs[i] = &converters[i];
+    }
+
+    while(1)
+    {
+        if (pcf8591_scan(devs, nb_device, data_in) < 0){ return -1;}
+
+        for (int i = 0; i < nb_device; i++)
+        {
+            printf("%s:0x%x > A0 --> %d mV  A1 --> %d mV  A2 --> %d mV  A3 --> %d mV\n", devs[i]->bus, devs[i]->address,
+                   pcf8591_data_to_mv(devs[i], 0, data_in[i][0]), pcf8591_data_to_mv(devs[i], 1, data_in[i][1]),
+                   pcf8591_data_to_mv(devs[i], 2, data_in[i][2]), pcf8591_data_to_mv(devs[i], 3, data_in[i][3]));
+        }
+        printf("\n");
+        sleep(1);
+    }
+}
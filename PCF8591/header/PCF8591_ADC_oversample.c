@@ -0,0 +1,49 @@
+/**
+ * @brief This program samples the 4 ADC inputs of the PCF8591 component as fast as the bus allows,
+ *        decimates them with a low-pass FIR filter and displays, every second, the voltages with a sub-LSB resolution.
+
+ * @file PCF8591_ADC_oversample.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -O2 -o PCF8591_ADC_oversample PCF8591_ADC_oversample.c PCF8591.c ../../i2c/i2c_bus.c -lm
+ *
+ * @warning Don't forget copy the PCF8591.h and PCF8591_decim.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_decim.h"
+
+/* Decimation ratio : ~11 kHz bus rate / 4 inputs / 64 -> ~43 results per second and per input */
+#define RATIO 64
+
+/* Number of FIR taps */
+#define NB_TAP 256
+
+/* Results read between two displays */
+#define NB_RESULT 43
+
+static pcf8591_oversample_t os; ///< ~100 kB of burst buffers, kept out of the stack
+
+int main(void)
+{
+    int32_t results[NB_RESULT][PCF8591_NB_CHANNEL];
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (PCF8591_oversample_init(&os, &pcf8591_default, PCF8591_FILTER_FIR, RATIO, NB_TAP) < 0){ return -1;}
+
+    while(1)
+    {
+        if (PCF8591_oversample_read(&os, results, NB_RESULT) < 0){ return -1;}
+
+        printf("Voltage on ADC :\n");
+        for (int c = 0; c < PCF8591_NB_CHANNEL; c++)
+        {
+            printf("> A%d --> %.3f mV\n", c, PCF8591_oversample_to_uv(&os, c, results[NB_RESULT - 1][c]) / 1000.0);
+        }
+        printf("> %llu samples per input\n\n", (unsigned long long)os.nb_sample);
+    }
+}
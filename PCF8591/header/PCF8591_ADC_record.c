@@ -0,0 +1,103 @@
+/**
+ * @brief This program records the 4 ADC inputs of the PCF8591 component in a capture file,
+ *        or replays a capture file and displays, for every second of the record, the mean voltage of each input.
+
+ * @file PCF8591_ADC_record.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC_record PCF8591_ADC_record.c PCF8591.c ../../i2c/i2c_bus.c -pthread
+ *
+ * usage : ./PCF8591_ADC_record record capture.bin 60   (record 60 s)
+ *         ./PCF8591_ADC_record replay capture.bin [start_s]
+ *
+ * @warning Don't forget copy the PCF8591.h, PCF8591_stream.h and PCF8591_record.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_record.h"
+
+/* Scans of the 4 inputs per second (0 -> as fast as the bus allows) */
+#define SCAN_RATE 1000
+
+/* Number of samples moved in one call */
+#define BATCH_SIZE 256
+
+static pcf8591_stream_t stream;     ///< ~64 kB, kept out of the stack
+static pcf8591_recorder_t recorder; ///< ~256 kB, kept out of the stack
+
+static int record(const char *path, int duration_s)
+{
+    pcf8591_sample_t samples[BATCH_SIZE];
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (PCF8591_record_open(&recorder, path, &pcf8591_default, SCAN_RATE * PCF8591_NB_CHANNEL) < 0){ return -1;}
+    if (PCF8591_stream_start(&stream, &pcf8591_default, NULL, PCF8591_NB_CHANNEL, SCAN_RATE) < 0){ return -1;}
+
+    for (int s = 0; s < duration_s; s++)
+    {
+        usleep(100000);
+        for (int t = 0; t < 10; t++)
+        {
+            int nb;
+            while ((nb = PCF8591_stream_read(&stream, samples, BATCH_SIZE)) > 0){ PCF8591_record_write(&recorder, samples, nb);}
+            usleep(100000);
+        }
+        printf("%d s : %lu overruns, %lu samples dropped by the writer\n", s + 1, PCF8591_stream_overrun(&stream), PCF8591_record_dropped(&recorder));
+    }
+
+    PCF8591_stream_stop(&stream);
+    int nb;
+    while ((nb = PCF8591_stream_read(&stream, samples, BATCH_SIZE)) > 0){ PCF8591_record_write(&recorder, samples, nb);}
+    return PCF8591_record_close(&recorder);
+}
+
+static int replay(const char *path, double start_s)
+{
+    pcf8591_replay_t file;
+    pcf8591_sample_t samples[BATCH_SIZE];
+    int16_t samples_mv[BATCH_SIZE];
+    long sum[PCF8591_NB_CHANNEL] = {0}, count[PCF8591_NB_CHANNEL] = {0};
+
+    if (PCF8591_replay_open(&file, path) < 0){ return -1;}
+    printf("%s:0x%x, Vref %d mV, %.0f samples/s, %lu blocks\n", file.header->bus, file.header->address, file.header->vref_mv,
+           file.header->sample_rate, (unsigned long)file.nb_block);
+
+    uint64_t second_ns = file.header->start_ns + (uint64_t)(start_s * 1e9);
+    PCF8591_replay_seek(&file, second_ns);
+    second_ns += 1000000000ull;
+
+    int nb;
+    while ((nb = PCF8591_replay_read(&file, samples, BATCH_SIZE)) > 0)
+    {
+        PCF8591_replay_to_mv(&file, samples, samples_mv, nb);
+        for (int i = 0; i < nb; i++)
+        {
+            while (samples[i].timestamp_ns >= second_ns)
+            {
+                printf("%.0f s > A0 --> %ld mV  A1 --> %ld mV  A2 --> %ld mV  A3 --> %ld mV\n", (second_ns - file.header->start_ns) / 1e9,
+                       count[0] ? sum[0] / count[0] : 0, count[1] ? sum[1] / count[1] : 0, count[2] ? sum[2] / count[2] : 0, count[3] ? sum[3] / count[3] : 0);
+                memset(sum, 0, sizeof(sum));
+                memset(count, 0, sizeof(count));
+                second_ns += 1000000000ull;
+            }
+            sum[samples[i].channel & 0x03] += samples_mv[i];
+            count[samples[i].channel & 0x03]++;
+        }
+    }
+
+    PCF8591_replay_close(&file);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc == 4) && (strcmp(argv[1], "record") == 0)){ return record(argv[2], atoi(argv[3]));}
+    if ((argc >= 3) && (strcmp(argv[1], "replay") == 0)){ return replay(argv[2], (argc > 3) ? atof(argv[3]) : 0);}
+
+    printf("usage : %s record <file> <seconds>\n        %s replay <file> [start_s]\n", argv[0], argv[0]);
+    return -1;
+}
@@ -0,0 +1,61 @@
+/**
+ * @brief This program waits for a rising edge on the A0 input of the PCF8591 component and, for each trigger,
+ *        displays the capture (100 scans before the edge and 300 after) as a text chart of A0.
+
+ * @file PCF8591_ADC_scope.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -O2 -o PCF8591_ADC_scope PCF8591_ADC_scope.c PCF8591.c ../../i2c/i2c_bus.c -pthread
+ *
+ * @warning Don't forget copy the PCF8591.h and PCF8591_scope.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_scope.h"
+
+/* Trigger : A0 rising through 1650 mV, re-armed 100 mV below */
+#define TRIGGER_LEVEL_MV 1650
+#define HYSTERESIS_MV 100
+
+/* Scans before and after the trigger */
+#define NB_PRE 100
+#define NB_POST 300
+
+/* Scans per line of the chart */
+#define SCANS_PER_LINE 10
+
+static pcf8591_scope_t scope;     ///< ~110 kB of ring buffers, kept out of the stack
+static pcf8591_capture_t capture; ///< ~45 kB
+
+int main(void)
+{
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+
+    pcf8591_trigger_t trigger = {
+        .type = PCF8591_TRIGGER_RISING,
+        .channel = 0,
+        .level = TRIGGER_LEVEL_MV * resolution / Vref,
+        .hysteresis = HYSTERESIS_MV * resolution / Vref,
+    };
+    if (PCF8591_scope_start(&scope, &pcf8591_default, &trigger, NB_PRE, NB_POST, 0) < 0){ return -1;}
+
+    while(1)
+    {
+        if (atomic_load(&scope.error)){ printf("/!\\ Error : the acquisition stopped.\n"); return -1;}
+        if (!PCF8591_scope_get(&scope, &capture)){ usleep(10000); continue;}
+
+        printf("Trigger #%lu, %.0f scans/s\n", atomic_load(&scope.nb_trigger), PCF8591_scope_rate(&scope));
+        for (int k = 0; k < capture.nb_scan; k += SCANS_PER_LINE)
+        {
+            int mv = pcf8591_data_to_mv(&pcf8591_default, 0, capture.data[k][0]);
+            double t_ms = ((int64_t)capture.timestamp_ns[k] - (int64_t)capture.trigger_ns) / 1e6;
+            printf("%8.2f ms %5d mV |%.*s%s\n", t_ms, mv, mv / 100, "##################################################",
+                   (k == capture.trigger_index) ? " <- trigger" : "");
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * @brief This program samples the 4 ADC inputs of the PCF8591 component in a background thread
+ *        and displays, every second, the last voltage of each input, the achieved sample rate and the overruns.
+
+ * @file PCF8591_ADC_stream.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADC_stream PCF8591_ADC_stream.c PCF8591.c ../../i2c/i2c_bus.c -pthread
+ *
+ * @warning Don't forget copy the PCF8591.h and PCF8591_stream.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_stream.h"
+
+/* Scans of the 4 inputs per second (0 -> as fast as the bus allows) */
+#define SCAN_RATE 1000
+
+/* Number of samples drained in one call */
+#define BATCH_SIZE 256
+
+static pcf8591_stream_t stream; ///< ~64 kB, kept out of the stack
+
+int main(void)
+{
+    pcf8591_sample_t samples[BATCH_SIZE];
+    int16_t samples_mv[BATCH_SIZE];
+    int16_t last_mv[PCF8591_NB_CHANNEL] = {0};
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (PCF8591_stream_start(&stream, &pcf8591_default, NULL, PCF8591_NB_CHANNEL, SCAN_RATE) < 0){ return -1;}
+
+    while(1)
+    {
+        sleep(1);
+
+        /* drain everything acquired during the last second */
+        int nb;
+        while ((nb = PCF8591_stream_read(&stream, samples, BATCH_SIZE)) > 0)
+        {
+            PCF8591_stream_to_mv(&stream, samples, samples_mv, nb);
+            for (int i = 0; i < nb; i++)
+            {
+                last_mv[samples[i].channel] = samples_mv[i];
+            }
+        }
+
+        printf("Voltage on ADC :\n> A0 --> %d mV\n> A1 --> %d mV\n> A2 --> %d mV\n> A3 --> %d mV\n",
+               last_mv[0], last_mv[1], last_mv[2], last_mv[3]);
+        printf("> %.0f samples/s, %lu overruns\n\n", PCF8591_stream_rate(&stream), PCF8591_stream_overrun(&stream));
+    }
+}
@@ -7,31 +7,55 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8591
- * compilation : gcc -Wall -o PCF8591_ADCtoDAC PCF8591_ADCtoDAC.c
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_ADCtoDAC PCF8591_ADCtoDAC.c PCF8591.c ../../i2c/i2c_bus.c -pthread -lm
+ *
+ * The loop runs in its own thread every LOOP_PERIOD_NS. The main thread displays, every second,
+ * the last sample of the log and the loop period, latency and deadline misses.
  *  
- * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ * @warning Don't forget copy the PCF8591.h and PCF8591_loop.h libraries in the same folder as this program.
  * 
 */
 
 /* Libary */
-#include "PCF8591.h"
+#include "PCF8591_loop.h"
+
+/* Loop period : 1 ms */
+#define LOOP_PERIOD_NS 1000000
+
+/* SCHED_FIFO priority of the loop (0 -> normal scheduling, 1 to 99 needs root) */
+#define PRIORITY 0
+
+/* Number of log records drained in one call */
+#define BATCH_SIZE 256
+
+static pcf8591_loop_t loop; ///< ~64 kB with the log ring, kept out of the stack
 
 int main(void)
 {
-    uint8_t A0_data;
-    uint8_t DAC_data;
+    pcf8591_gain_t half = {.gain = 0.5, .offset_mv = 0}; ///< DAC voltage = A0 voltage / 2
+    pcf8591_loop_record_t records[BATCH_SIZE];
+    pcf8591_loop_stats_t stats;
 
     /* initialization of I²C communication (address : 0x48) and put first DAC voltage at 0 mV */
     PCF8591_i2c_connect();
     PCF8591_write_data(0);
+    if (PCF8591_loop_start(&loop, &pcf8591_default, 0, LOOP_PERIOD_NS, PCF8591_loop_gain, &half, PRIORITY, PRIORITY > 0) < 0){ return -1;}
+
     while(1)
     {
-        /* read the ADC voltage (8 bits) on A0 input */
-        A0_data = PCF8591_read_data(0); 
-        printf("data de A0 = %xx\n",A0_data);
+        sleep(1);
+        if (atomic_load(&loop.error)){ printf("/!\\ Error : the control loop stopped.\n"); return -1;}
+
+        /* drain the log, keep the last record */
+        int nb;
+        pcf8591_loop_record_t last = {0};
+        while ((nb = PCF8591_loop_log_read(&loop, records, BATCH_SIZE)) > 0)
+        {
+            last = records[nb - 1];
+        }
+        printf("data de A0 = %xx -> DAC = %xx\n", last.input, last.output);
 
-        /* halves the ADC voltage and put it on the DAC */
-        DAC_data = A0_data/2;
-        PCF8591_write_data(DAC_data);
+        PCF8591_loop_stats(&loop, &stats, 1); ///< statistics of the last second
+        PCF8591_loop_report(&stats);
     }
-}
\ No newline at end of file
+}
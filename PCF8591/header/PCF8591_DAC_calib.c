@@ -0,0 +1,53 @@
+/**
+ * @brief This program calibrates the DAC output of the PCF8591 component on an ADC input wired back,
+ *        saves the calibration in a file, and checks a few output voltages with it.
+
+ * @file PCF8591_DAC_calib.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591 with AOUT wired to the A0 input
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_DAC_calib PCF8591_DAC_calib.c PCF8591.c ../../i2c/i2c_bus.c -lm
+ *
+ * usage : ./PCF8591_DAC_calib [file]   (default file : dac_calib.bin)
+ *
+ * @warning Don't forget copy the PCF8591.h and PCF8591_calib.h libraries in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include "PCF8591_calib.h"
+
+/* ADC input wired to AOUT */
+#define LOOPBACK_CHANNEL 0
+
+/* Conversions averaged per DAC code */
+#define NB_AVERAGE 16
+
+int main(int argc, char *argv[])
+{
+    const char *path = (argc > 1) ? argv[1] : "dac_calib.bin";
+
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+
+    int nb_valid = PCF8591_dac_calibrate(&pcf8591_default, LOOPBACK_CHANNEL, NB_AVERAGE);
+    if (nb_valid < 0){ return -1;}
+    printf("DAC codes 0 to %d measured, %d extrapolated above the ADC range\n", nb_valid - 1, 256 - nb_valid);
+    for (int code = 0; code < 256; code += 32)
+    {
+        printf("> code %3d --> %4d mV (ideal %4ld mV)\n", code, pcf8591_default.dac_mv[code], lround((double)code * Vref / resolution));
+    }
+    printf("> code 255 --> %4d mV (ideal %4d mV)\n", pcf8591_default.dac_mv[255], Vref);
+    if (PCF8591_dac_save(&pcf8591_default, path) < 0){ return -1;}
+    printf("Calibration saved in %s\n\n", path);
+
+    /* check : write a voltage with the calibration and measure it back */
+    for (int mv = 250; mv < Vref; mv += 500)
+    {
+        PCF8591_write_voltage_mv(mv);
+        usleep(1000);
+        printf("> %4d mV written --> %4d mV measured\n", mv, PCF8591_read_voltage_mv(LOOPBACK_CHANNEL));
+    }
+    return 0;
+}
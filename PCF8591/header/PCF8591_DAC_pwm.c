@@ -7,14 +7,17 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8591
- * compilation : gcc -Wall -o PCF8591_DAC_pwm PCF8591_DAC_pwm.c
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_DAC_pwm PCF8591_DAC_pwm.c PCF8591.c ../../i2c/i2c_bus.c -lm -pthread
  *  
- * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ * The edges are written on absolute deadlines by the PWM thread of PCF8591_pwm.h,
+ * the jitter statistics are displayed every second.
+ * 
+ * @warning Don't forget copy the PCF8591.h and PCF8591_pwm.h libraries in the same folder as this program.
  * 
 */
 
 /* Library */
-#include "PCF8591.h"
+#include "PCF8591_pwm.h"
 
 /* PWM frequency (Hz) and cycle ratio (%) */
 #define FREQUENCY 1000
@@ -26,16 +29,15 @@
 
 int main(void)
 {
-    /* define sleep time for high and low states */
-    int HighSleepTime = 1000000 * CYCLE_RATIO /  FREQUENCY;
-    int LowSleepTime = 1000000 * (100 - CYCLE_RATIO) /  FREQUENCY;
+    pcf8591_pwm_t pwm;
+    pcf8591_pwm_stats_t stats;
 
     PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (PCF8591_pwm_start(&pwm, &pcf8591_default, FREQUENCY, CYCLE_RATIO, HIGH_STATE, LOW_STATE) < 0){ return -1;}
     while(1)
     {
-        PCF8591_write_voltage_mv(HIGH_STATE);
-        usleep(HighSleepTime);
-        PCF8591_write_voltage_mv(LOW_STATE);
-        usleep(LowSleepTime);
+        sleep(1);
+        PCF8591_pwm_stats(&pwm, &stats, 1); ///< statistics of the last second
+        PCF8591_pwm_report(&stats);
     }
-}
\ No newline at end of file
+}
@@ -7,15 +7,22 @@
  *
  * @details 
  * Hardware : Rpi4, PCF8591
- * compilation : gcc -Wall -o PCF8591_DAC_sin PCF8591_DAC_sin.c -lm
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_DAC_sin PCF8591_DAC_sin.c PCF8591.c ../../i2c/i2c_bus.c -lm
  *  
- * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ * The sine period is precomputed once in a wavetable and played by the DDS generator of PCF8591_wave.h,
+ * by blocks of samples sent at the I2C bus rate.
+ * The DAC calibration made by PCF8591_DAC_calib is used when its file is found.
+ * 
+ * @warning Don't forget copy the PCF8591.h, PCF8591_calib.h and PCF8591_wave.h libraries in the same folder as this program.
  * 
 */
 
 /* Library */
-#include "PCF8591.h"
-#include <math.h>
+#include "PCF8591_wave.h"
+#include "PCF8591_calib.h"
+
+/* DAC calibration file (made by PCF8591_DAC_calib) */
+#define DAC_CALIB_FILE "dac_calib.bin"
 
 /* Define frequency signal (Hz) */
 #define FREQUENCY 10
@@ -23,17 +30,26 @@
 /* define pic voltage */
 #define PIC 1500
 
+/* Samples sent in one I2C transfer */
+#define BLOCK_SIZE 256
+
+/* Sample rate : 95 % of the bus rate, the rest is left for the address, the control byte and the gap between transfers */
+#define SAMPLE_RATE (0.95 * PCF8591_BUS_SAMPLE_RATE)
+
 int main(void)
 {
-    double i;
+    pcf8591_wave_t wave;
+
     PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+    if (access(DAC_CALIB_FILE, R_OK) == 0){ PCF8591_dac_load(&pcf8591_default, DAC_CALIB_FILE);} ///< ideal DAC otherwise
+
+    PCF8591_wave_init(&wave, &pcf8591_default, SAMPLE_RATE, BLOCK_SIZE);
+    PCF8591_wave_table_mv(&wave, PCF8591_WAVE_SINE, 0, 2 * PIC, 0); ///< from 0 mV to 2 * PIC mV
+    if (PCF8591_wave_set_frequency(&wave, FREQUENCY) < 0){ return -1;}
     while(1)
     {
-        /* for i in ranging from 0 to 2pi, put sin(i) on DAC */
-        for (i = 0; i <= 6.28; i+= 0.01)
-        {
-            PCF8591_write_voltage_mv(PIC * sin(i) + PIC);
-            usleep(1592 / FREQUENCY);
-        }
+        /* output one second of signal then display the effective frequency and timing error */
+        if (PCF8591_wave_run(&wave, SAMPLE_RATE) < 0){ return -1;}
+        PCF8591_wave_report(&wave, FREQUENCY);
     }
-}
\ No newline at end of file
+}
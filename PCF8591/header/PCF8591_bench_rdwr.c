@@ -0,0 +1,104 @@
+/**
+ * @brief This program compares the per-sample latency and the number of system calls of the
+ *        legacy channel read (write + usleep + 2 read), of the combined I2C_RDWR transaction
+ *        and of the single byte read used when the same channel is read again.
+
+ * @file PCF8591_bench_rdwr.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, PCF8591
+ * compilation : gcc -Wall -I../../i2c -O2 -o PCF8591_bench_rdwr PCF8591_bench_rdwr.c PCF8591.c ../../i2c/i2c_bus.c
+ *
+ * The system calls made by the library are counted by wrapping write(), read(), ioctl() and usleep() in macros
+ * before including PCF8591.h. The result can be checked with "strace -c ./PCF8591_bench_rdwr".
+ *
+ * @warning Don't forget copy the PCF8591.h library in the same folder as this program.
+ *
+*/
+
+/* Library */
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Number of samples of each run */
+#define NB_SAMPLE 1000
+
+/* system calls counter */
+static unsigned long nb_syscall = 0;
+
+/* a function-like macro is not expanded again inside its own definition, so the real function is called */
+#define write(...) (nb_syscall++, write(__VA_ARGS__))
+#define read(...) (nb_syscall++, read(__VA_ARGS__))
+#define ioctl(...) (nb_syscall++, ioctl(__VA_ARGS__))
+#define usleep(...) (nb_syscall++, usleep(__VA_ARGS__))
+
+#include "PCF8591.h"
+
+/**
+ * @brief Read a channel the way PCF8591_read_data() did before the I2C_RDWR transaction.
+ * @param channel number -> possible value : 0 / 1 / 2 / 3
+ * @return 8 bit data of the selected channel
+ */
+uint8_t legacy_read_data(uint8_t channel)
+{
+    if(select_channel(channel) < 0){return 0;}
+
+    uint8_t data_in[1];
+    i2c_read(pcf8591_default.fd, data_in, 1); ///< last value stored during the previous use of the ADC
+    i2c_read(pcf8591_default.fd, data_in, 1); ///< Data reading.
+    return *data_in;
+}
+
+/**
+ * @brief Read A0 whatever the channel asked, to measure the control byte cache.
+ * @param channel ignored.
+ * @return 8 bit data of A0
+ */
+uint8_t same_channel_read_data(uint8_t channel)
+{
+    (void)channel;
+    return PCF8591_read_data(0);
+}
+
+/**
+ * @brief Return the monotonic time in µs.
+ */
+double now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Run NB_SAMPLE reads with the given function and display the result.
+ * @param name Name of the method.
+ * @param read_function Read function to measure.
+ */
+void run(const char *name, uint8_t (*read_function)(uint8_t))
+{
+    nb_syscall = 0;
+    double start = now_us();
+    for (int i = 0; i < NB_SAMPLE; i++)
+    {
+        read_function(i % PCF8591_NB_CHANNEL);
+    }
+    double elapsed = now_us() - start;
+
+    printf("%-28s : %8.1f us/sample  %5.2f syscalls/sample\n", name, elapsed / NB_SAMPLE, (double)nb_syscall / NB_SAMPLE);
+}
+
+int main(void)
+{
+    PCF8591_i2c_connect(); ///< initialization of I²C communication (address : 0x48)
+
+    run("before (write+usleep+2 read)", legacy_read_data);
+    run("after (I2C_RDWR)", PCF8591_read_data);
+    run("same channel (cached)", same_channel_read_data);
+    return 0;
+}
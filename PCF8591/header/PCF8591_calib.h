@@ -0,0 +1,323 @@
+/**
+ * @brief Calibration of the PCF8591 DAC output and ADC inputs
+
+ * @file PCF8591_calib.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591, AOUT wired to one single-ended ADC input for the calibration.
+ *
+ * The DAC of the PCF8591 is not exactly linear and its full scale depends on the board. PCF8591_dac_calibrate()
+ * writes the 256 DAC codes, measures each output on the ADC input wired back and fills the DAC code to mV
+ * table of the converter, then its mV to DAC code inverse table. The calibration is saved in a small binary
+ * file with PCF8591_dac_save() and loaded at startup with PCF8591_dac_load() : the mV writes
+ * (pcf8591_write_voltage_mv(), pcf8591_mv_to_data(), the waveform and PWM tables) then use the measured
+ * output at the same cost as the ideal one, a table lookup.
+ *
+ * Each ADC channel of each input mode can get up to PCF8591_CALIB_POINT_MAX points (code measured for a known
+ * voltage) with PCF8591_adc_add_point() : offset with 1 point, offset and gain with 2, piecewise linear above.
+ * The points are part of the converter and pcf8591_build_adc_table() applies them in the code to mV tables, so
+ * every read, batch and stream conversion is calibrated at no extra cost. PCF8591_adc_save() and
+ * PCF8591_adc_load() keep the points of all the channels in a file.
+ *
+ * @warning pcf8591_set_vref() goes back to the ideal DAC, load the calibration after it.
+ * pcf8591_open() clears the ADC calibration, load it after the connection.
+ */
+
+#ifndef PCF8591_CALIB_H
+#define PCF8591_CALIB_H
+
+#include "PCF8591.h"
+
+#define PCF8591_DAC_FILE_MAGIC "PCF8591D" ///< First bytes of a DAC calibration file.
+#define PCF8591_ADC_FILE_MAGIC "PCF8591A" ///< First bytes of an ADC calibration file.
+#define PCF8591_CALIB_VERSION 1 ///< Calibration file format version.
+#define PCF8591_DAC_SETTLE 2 ///< Conversions dropped after a DAC change (stale byte and settling).
+#define PCF8591_DAC_AVERAGE_MAX 64 ///< Maximum number of conversions averaged per DAC code.
+#define PCF8591_DAC_SLOPE_SPAN 32 ///< Codes used to extrapolate the output above the ADC range.
+
+/**
+ * @brief DAC calibration file.
+ */
+typedef struct
+{
+    char magic[8];        ///< PCF8591_DAC_FILE_MAGIC.
+    uint32_t version;     ///< PCF8591_CALIB_VERSION.
+    uint8_t address;      ///< I2C address of the converter calibrated.
+    uint8_t reserved;
+    uint16_t vref_mv;     ///< Reference voltage during the calibration.
+    uint16_t dac_mv[256]; ///< Measured output of every DAC code (mV, never decreasing).
+} pcf8591_dac_file_t;
+
+/**
+ * @brief Measure the 256 DAC codes on an ADC input and rebuild the DAC tables of the converter.
+ * For each code, one transfer writes the code and reads the input PCF8591_DAC_SETTLE + nb_average times,
+ * the first conversions being dropped. The measures are made non-decreasing (pool adjacent violators),
+ * and the codes above the ADC range are extrapolated from the slope of the last measured codes.
+ * @param dev The converter.
+ * @param channel Single-ended input of the active mode wired to AOUT.
+ * @param nb_average Conversions averaged per code (1 to PCF8591_DAC_AVERAGE_MAX).
+ * @return Number of codes measured below the top of the ADC range, -1 on error.
+ */
+static inline int PCF8591_dac_calibrate(pcf8591_t *dev, uint8_t channel, int nb_average)
+{
+    double measure[256], weight[256];
+    int nb_block, start[256];
+
+    int control = pcf8591_control(dev, channel);
+    if (control < 0){ return -1;}
+    if (pcf8591_is_differential(dev->mode, channel)){ printf("/!\\ Error : the DAC calibration needs a single-ended input.\n"); return -1;}
+    if ((nb_average < 1) | (nb_average > PCF8591_DAC_AVERAGE_MAX)){ printf("/!\\ Error : number of conversions not suported.\n"); return -1;}
+
+    /* sweep : code written and measured in the same transfer */
+    int nb_valid = 256;
+    for (int code = 0; code < 256; code++)
+    {
+        uint8_t buffer[2] = {control, code};
+        uint8_t data_in[PCF8591_DAC_SETTLE + PCF8591_DAC_AVERAGE_MAX];
+        if (pcf8591_transfer(dev, buffer, 2, data_in, PCF8591_DAC_SETTLE + nb_average) < 0){ return -1;}
+
+        /* mean code, converted with the ADC table of the input (linear between two codes) */
+        int sum = 0;
+        for (int i = 0; i < nb_average; i++){ sum += data_in[PCF8591_DAC_SETTLE + i];}
+        double mean = (double)sum / nb_average;
+        int low = (mean >= 255) ? 254 : (int)mean;
+        measure[code] = dev->adc_mv[channel][low] + (mean - low) * (dev->adc_mv[channel][low + 1] - dev->adc_mv[channel][low]);
+        if ((mean > 254.5) && (nb_valid == 256)){ nb_valid = code;} ///< ADC at its top : the higher codes can't be measured
+    }
+    if (nb_valid < PCF8591_DAC_SLOPE_SPAN + 1){ printf("/!\\ Error : DAC output out of the ADC range, check the wiring.\n"); return -1;}
+
+    /* non-decreasing fit of the measured codes : adjacent blocks that decrease are merged to their mean */
+    nb_block = 0;
+    for (int code = 0; code < nb_valid; code++)
+    {
+        start[nb_block] = code;
+        measure[nb_block] = measure[code];
+        weight[nb_block] = 1;
+        nb_block++;
+        while ((nb_block > 1) && (measure[nb_block - 2] > measure[nb_block - 1]))
+        {
+            double w = weight[nb_block - 2] + weight[nb_block - 1];
+            measure[nb_block - 2] = (measure[nb_block - 2] * weight[nb_block - 2] + measure[nb_block - 1] * weight[nb_block - 1]) / w;
+            weight[nb_block - 2] = w;
+            nb_block--;
+        }
+    }
+    for (int block = nb_block - 1; block >= 0; block--)
+    {
+        int end = (block == nb_block - 1) ? nb_valid : start[block + 1];
+        for (int code = start[block]; code < end; code++){ dev->dac_mv[code] = lround(measure[block] < 0 ? 0 : measure[block]);}
+    }
+
+    /* codes above the ADC range : slope of the last measured codes */
+    double slope = (double)(dev->dac_mv[nb_valid - 1] - dev->dac_mv[nb_valid - 1 - PCF8591_DAC_SLOPE_SPAN]) / PCF8591_DAC_SLOPE_SPAN;
+    for (int code = nb_valid; code < 256; code++)
+    {
+        long mv = lround(dev->dac_mv[nb_valid - 1] + slope * (code - nb_valid + 1));
+        dev->dac_mv[code] = (mv > 65535) ? 65535 : mv;
+    }
+
+    pcf8591_build_dac_table(dev);
+    return nb_valid;
+}
+
+/**
+ * @brief Save the DAC calibration of a converter.
+ * @param dev The converter.
+ * @param path Path of the calibration file.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_dac_save(const pcf8591_t *dev, const char *path)
+{
+    pcf8591_dac_file_t file = {.magic = PCF8591_DAC_FILE_MAGIC, .version = PCF8591_CALIB_VERSION, .address = dev->address, .vref_mv = dev->vref_mv};
+    memcpy(file.dac_mv, dev->dac_mv, sizeof(file.dac_mv));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){ printf("/!\\ Error : cannot create %s (%s).\n", path, strerror(errno)); return -1;}
+    int result = (write(fd, &file, sizeof(file)) == sizeof(file)) ? 1 : -1;
+    if (result < 0){ printf("/!\\ Error : cannot write %s.\n", path);}
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief Load a DAC calibration and rebuild the mV to DAC code table of the converter.
+ * @param dev The converter.
+ * @param path Path of the calibration file.
+ * @return 1 on success, -1 on error (the DAC tables are not changed).
+ * @note A file made for another address or another reference voltage is refused.
+ */
+static inline int PCF8591_dac_load(pcf8591_t *dev, const char *path)
+{
+    pcf8591_dac_file_t file;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){ printf("/!\\ Error : cannot open %s (%s).\n", path, strerror(errno)); return -1;}
+    ssize_t size = read(fd, &file, sizeof(file));
+    close(fd);
+
+    if ((size != sizeof(file)) || (memcmp(file.magic, PCF8591_DAC_FILE_MAGIC, sizeof(file.magic)) != 0) || (file.version != PCF8591_CALIB_VERSION))
+    {
+        printf("/!\\ Error : %s is not a DAC calibration file.\n", path);
+        return -1;
+    }
+    if ((file.address != dev->address) || (file.vref_mv != dev->vref_mv))
+    {
+        printf("/!\\ Error : %s was made for 0x%x with Vref %d mV.\n", path, file.address, file.vref_mv);
+        return -1;
+    }
+    for (int code = 1; code < 256; code++)
+    {
+        if (file.dac_mv[code] < file.dac_mv[code - 1]){ printf("/!\\ Error : %s is not monotonic.\n", path); return -1;}
+    }
+
+    memcpy(dev->dac_mv, file.dac_mv, sizeof(dev->dac_mv));
+    pcf8591_build_dac_table(dev);
+    return 1;
+}
+
+/**
+ * @brief ADC calibration file.
+ */
+typedef struct
+{
+    char magic[8];        ///< PCF8591_ADC_FILE_MAGIC.
+    uint32_t version;     ///< PCF8591_CALIB_VERSION.
+    uint8_t address;      ///< I2C address of the converter calibrated.
+    uint8_t reserved;
+    uint16_t vref_mv;     ///< Reference voltage during the calibration.
+    pcf8591_adc_calib_t calib[PCF8591_NB_MODE][PCF8591_NB_CHANNEL]; ///< Points of every channel of every mode.
+} pcf8591_adc_file_t;
+
+/**
+ * @brief Measure the mean code of an input, for a calibration point.
+ * @param dev The converter.
+ * @param channel Channel of the active mode.
+ * @param nb_average Conversions averaged (1 to PCF8591_DAC_AVERAGE_MAX).
+ * @param code Mean code (signed for a differential input), with PCF8591_CALIB_FRAC fractional bits.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_adc_measure(pcf8591_t *dev, uint8_t channel, int nb_average, int16_t *code)
+{
+    uint8_t data_in[1 + PCF8591_DAC_AVERAGE_MAX];
+
+    int control = pcf8591_control(dev, channel);
+    if (control < 0){ return -1;}
+    if ((nb_average < 1) | (nb_average > PCF8591_DAC_AVERAGE_MAX)){ printf("/!\\ Error : number of conversions not suported.\n"); return -1;}
+
+    uint8_t control_byte[1] = {control};
+    if (pcf8591_transfer(dev, control_byte, 1, data_in, 1 + nb_average) < 0){ return -1;}
+
+    int differential = pcf8591_is_differential(dev->mode, channel), sum = 0;
+    for (int i = 1; i <= nb_average; i++){ sum += differential ? (int8_t)data_in[i] : data_in[i];}
+    int scaled = sum * (1 << PCF8591_CALIB_FRAC);
+    *code = (scaled >= 0) ? (scaled + nb_average / 2) / nb_average : -((-scaled + nb_average / 2) / nb_average);
+    return 1;
+}
+
+/**
+ * @brief Add a calibration point to a channel of the active mode and rebuild its conversion table.
+ * @param dev The converter.
+ * @param channel Channel of the active mode.
+ * @param code Code measured (see PCF8591_adc_measure()).
+ * @param mv Voltage applied on the input when the code was measured.
+ * @return Number of points of the channel, -1 if the point can't be added.
+ * @note The points must give a voltage that increases with the code.
+ */
+static inline int PCF8591_adc_add_point(pcf8591_t *dev, uint8_t channel, int16_t code, int16_t mv)
+{
+    if (channel >= pcf8591_nb_input(dev->mode)){ printf("/!\\ Error : channel not suported. Select a compliant channel.\n"); return -1;}
+    pcf8591_adc_calib_t *calib = &dev->adc_calib[dev->mode >> 4][channel];
+    if (calib->nb_point >= PCF8591_CALIB_POINT_MAX){ printf("/!\\ Error : too many calibration points.\n"); return -1;}
+
+    int i = 0;
+    while ((i < calib->nb_point) && (calib->code[i] < code)){ i++;}
+    if (((i < calib->nb_point) && ((calib->code[i] == code) || (calib->mv[i] <= mv))) || ((i > 0) && (calib->mv[i - 1] >= mv)))
+    {
+        printf("/!\\ Error : calibration point (%d mV) not consistent with the other points.\n", mv);
+        return -1;
+    }
+
+    memmove(&calib->code[i + 1], &calib->code[i], (calib->nb_point - i) * sizeof(calib->code[0]));
+    memmove(&calib->mv[i + 1], &calib->mv[i], (calib->nb_point - i) * sizeof(calib->mv[0]));
+    calib->code[i] = code;
+    calib->mv[i] = mv;
+    calib->nb_point++;
+    pcf8591_build_adc_table(dev);
+    return calib->nb_point;
+}
+
+/**
+ * @brief Remove the calibration of a channel of the active mode (ideal conversion).
+ * @param dev The converter.
+ * @param channel Channel of the active mode.
+ */
+static inline void PCF8591_adc_clear(pcf8591_t *dev, uint8_t channel)
+{
+    dev->adc_calib[dev->mode >> 4][channel & 0x03].nb_point = 0;
+    pcf8591_build_adc_table(dev);
+}
+
+/**
+ * @brief Save the ADC calibration of all the channels of a converter.
+ * @param dev The converter.
+ * @param path Path of the calibration file.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_adc_save(const pcf8591_t *dev, const char *path)
+{
+    pcf8591_adc_file_t file = {.magic = PCF8591_ADC_FILE_MAGIC, .version = PCF8591_CALIB_VERSION, .address = dev->address, .vref_mv = dev->vref_mv};
+    memcpy(file.calib, dev->adc_calib, sizeof(file.calib));
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){ printf("/!\\ Error : cannot create %s (%s).\n", path, strerror(errno)); return -1;}
+    int result = (write(fd, &file, sizeof(file)) == sizeof(file)) ? 1 : -1;
+    if (result < 0){ printf("/!\\ Error : cannot write %s.\n", path);}
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief Load the ADC calibration of a converter and rebuild its conversion tables.
+ * @param dev The converter.
+ * @param path Path of the calibration file.
+ * @return 1 on success, -1 on error (the calibration is not changed).
+ * @note A file made for another address or another reference voltage is refused.
+ */
+static inline int PCF8591_adc_load(pcf8591_t *dev, const char *path)
+{
+    pcf8591_adc_file_t file;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){ printf("/!\\ Error : cannot open %s (%s).\n", path, strerror(errno)); return -1;}
+    ssize_t size = read(fd, &file, sizeof(file));
+    close(fd);
+
+    if ((size != sizeof(file)) || (memcmp(file.magic, PCF8591_ADC_FILE_MAGIC, sizeof(file.magic)) != 0) || (file.version != PCF8591_CALIB_VERSION))
+    {
+        printf("/!\\ Error : %s is not an ADC calibration file.\n", path);
+        return -1;
+    }
+    if ((file.address != dev->address) || (file.vref_mv != dev->vref_mv))
+    {
+        printf("/!\\ Error : %s was made for 0x%x with Vref %d mV.\n", path, file.address, file.vref_mv);
+        return -1;
+    }
+    for (int mode = 0; mode < PCF8591_NB_MODE; mode++)
+    {
+        for (int channel = 0; channel < PCF8591_NB_CHANNEL; channel++)
+        {
+            const pcf8591_adc_calib_t *calib = &file.calib[mode][channel];
+            int valid = calib->nb_point <= PCF8591_CALIB_POINT_MAX;
+            for (int i = 1; valid && (i < calib->nb_point); i++){ valid = (calib->code[i] > calib->code[i - 1]) && (calib->mv[i] > calib->mv[i - 1]);}
+            if (!valid){ printf("/!\\ Error : %s has bad calibration points.\n", path); return -1;}
+        }
+    }
+
+    memcpy(dev->adc_calib, file.calib, sizeof(dev->adc_calib));
+    pcf8591_build_adc_table(dev);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,312 @@
+/**
+ * @brief Oversampling and decimation of the PCF8591 ADC inputs
+
+ * @file PCF8591_decim.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -lm to the gcc command line.
+ *
+ * The channels of the active input mode are sampled back to back with auto-increment bursts (pcf8591_read_burst()),
+ * at the rate the bus allows, and every channel goes through a decimation filter :
+ *  - PCF8591_FILTER_BOXCAR : mean of ratio samples.
+ *  - PCF8591_FILTER_CIC    : cascaded integrator-comb of order 1 to 4 (sinc^N response), no multiplication per sample.
+ *  - PCF8591_FILTER_FIR    : Blackman windowed-sinc low-pass, cut at the output Nyquist frequency, only the kept outputs are computed.
+ *
+ * The filters work on whole blocks of one channel (contiguous loops that the compiler can vectorise)
+ * and give fixed-point results with PCF8591_DECIM_FRAC fractional bits : with noise on the input,
+ * the mean of many 8 bit samples resolves a fraction of a LSB.
+ */
+
+#ifndef PCF8591_DECIM_H
+#define PCF8591_DECIM_H
+
+#include "PCF8591.h"
+
+#ifndef PCF8591_DECIM_FRAC
+#define PCF8591_DECIM_FRAC 8 ///< Fractional bits of the decimated results (1/256 LSB).
+#endif
+#define PCF8591_DECIM_RATIO_MAX 4096 ///< Highest decimation ratio.
+#define PCF8591_CIC_ORDER_MAX 4 ///< Highest CIC order (ratio^order must stay below 2^40).
+#define PCF8591_FIR_TAP_MAX 256 ///< Highest number of FIR taps.
+#define PCF8591_FIR_SHIFT 15 ///< Fractional bits of the FIR coefficients.
+#define PCF8591_BURST_SCAN_MAX (PCF8591_BLOCK_MAX - 1) ///< Highest number of samples of one channel in a burst.
+
+/**
+ * @brief Decimation filters.
+ */
+typedef enum
+{
+    PCF8591_FILTER_BOXCAR,
+    PCF8591_FILTER_CIC,
+    PCF8591_FILTER_FIR,
+} pcf8591_filter_t;
+
+/**
+ * @brief Decimation filter of one channel.
+ */
+typedef struct
+{
+    pcf8591_filter_t filter;                        ///< Filter type.
+    int ratio;                                      ///< Input samples per output.
+    int phase;                                      ///< Input samples since the last output.
+    int32_t sum;                                    ///< Boxcar : sum of the current window.
+    int order;                                      ///< CIC : number of integrator and comb stages.
+    uint64_t integrator[PCF8591_CIC_ORDER_MAX];     ///< CIC : integrators (modulo 2^64, exact after the combs).
+    uint64_t comb[PCF8591_CIC_ORDER_MAX];           ///< CIC : previous input of each comb.
+    uint64_t gain;                                  ///< CIC : ratio^order.
+    int nb_tap;                                     ///< FIR : number of taps.
+    int32_t tap[PCF8591_FIR_TAP_MAX];               ///< FIR : coefficients with PCF8591_FIR_SHIFT fractional bits (sum = 1).
+    int16_t delay[2 * PCF8591_FIR_TAP_MAX];         ///< FIR : last samples, stored twice so the window is always contiguous.
+    int position;                                   ///< FIR : index of the oldest sample in the delay line.
+} pcf8591_decim_t;
+
+/**
+ * @brief Divide with rounding to the nearest, for positive and negative values.
+ */
+static inline int64_t PCF8591_decim_round_div(int64_t value, int64_t divisor)
+{
+    return (value >= 0) ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+}
+
+/**
+ * @brief Initialise a decimation filter.
+ * @param dec The filter.
+ * @param filter PCF8591_FILTER_BOXCAR / PCF8591_FILTER_CIC / PCF8591_FILTER_FIR.
+ * @param ratio Decimation ratio (2 to PCF8591_DECIM_RATIO_MAX).
+ * @param param CIC : order (1 to PCF8591_CIC_ORDER_MAX). FIR : number of taps (ratio + 1 to PCF8591_FIR_TAP_MAX, about 4 * ratio is good). Boxcar : ignored.
+ * @return 1 on success, -1 on bad argument.
+ */
+static inline int PCF8591_decim_init(pcf8591_decim_t *dec, pcf8591_filter_t filter, int ratio, int param)
+{
+    if ((ratio < 2) | (ratio > PCF8591_DECIM_RATIO_MAX)){ printf("/!\\ Error : decimation ratio not suported.\n"); return -1;}
+
+    memset(dec, 0, sizeof(*dec));
+    dec->filter = filter;
+    dec->ratio = ratio;
+
+    switch (filter)
+    {
+        case PCF8591_FILTER_BOXCAR :
+            return 1;
+
+        case PCF8591_FILTER_CIC :
+            if ((param < 1) | (param > PCF8591_CIC_ORDER_MAX)){ printf("/!\\ Error : CIC order not suported.\n"); return -1;}
+            dec->order = param;
+            dec->gain = 1;
+            for (int i = 0; i < param; i++){ dec->gain *= ratio;}
+            if (dec->gain >= (1ull << 40)){ printf("/!\\ Error : CIC ratio^order too high.\n"); return -1;}
+            return 1;
+
+        case PCF8591_FILTER_FIR :
+        {
+            if ((param <= ratio) | (param > PCF8591_FIR_TAP_MAX)){ printf("/!\\ Error : number of FIR taps not suported.\n"); return -1;}
+            double h[PCF8591_FIR_TAP_MAX];
+            double fc = 0.5 / ratio; ///< cut-off at the output Nyquist frequency (normalised to the input rate)
+            double m = (param - 1) / 2.0;
+            double sum = 0;
+
+            for (int k = 0; k < param; k++)
+            {
+                double x = k - m;
+                double sinc = (x == 0) ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x);
+                double window = 0.42 - 0.5 * cos(2 * M_PI * k / (param - 1)) + 0.08 * cos(4 * M_PI * k / (param - 1)); ///< Blackman
+                h[k] = sinc * window;
+                sum += h[k];
+            }
+
+            /* quantise with a DC gain of exactly 1 : the rounding error goes to the centre tap */
+            int32_t total = 0;
+            for (int k = 0; k < param; k++)
+            {
+                dec->tap[k] = lround(h[k] / sum * (1 << PCF8591_FIR_SHIFT));
+                total += dec->tap[k];
+            }
+            dec->tap[param / 2] += (1 << PCF8591_FIR_SHIFT) - total;
+            dec->nb_tap = param;
+            return 1;
+        }
+    }
+    printf("/!\\ Error : filter not suported.\n");
+    return -1;
+}
+
+/**
+ * @brief Filter and decimate a block of samples of one channel.
+ * @param dec The filter.
+ * @param in Samples (0 to 255 for a single-ended input, -128 to 127 for a differential input).
+ * @param n Number of samples.
+ * @param out Buffer that will get the results, with PCF8591_DECIM_FRAC fractional bits (n / ratio + 1 entries).
+ * @return Number of results.
+ */
+static inline int PCF8591_decim_process(pcf8591_decim_t *dec, const int16_t *in, size_t n, int32_t *out)
+{
+    int nb_out = 0;
+    size_t i = 0;
+
+    switch (dec->filter)
+    {
+        case PCF8591_FILTER_BOXCAR :
+            while (i < n)
+            {
+                size_t chunk = n - i;
+                if (chunk > (size_t)(dec->ratio - dec->phase)){ chunk = dec->ratio - dec->phase;}
+
+                int32_t sum = 0;
+                for (size_t k = 0; k < chunk; k++){ sum += in[i + k];} ///< contiguous, vectorised
+                dec->sum += sum;
+                dec->phase += chunk;
+                i += chunk;
+
+                if (dec->phase == dec->ratio)
+                {
+                    out[nb_out++] = PCF8591_decim_round_div((int64_t)dec->sum << PCF8591_DECIM_FRAC, dec->ratio);
+                    dec->sum = 0;
+                    dec->phase = 0;
+                }
+            }
+            break;
+
+        case PCF8591_FILTER_CIC :
+            for (; i < n; i++)
+            {
+                /* integrators at the input rate */
+                uint64_t y = (uint64_t)(int64_t)in[i];
+                for (int s = 0; s < dec->order; s++){ y = dec->integrator[s] += y;}
+
+                if (++dec->phase == dec->ratio)
+                {
+                    /* combs at the output rate */
+                    for (int s = 0; s < dec->order; s++)
+                    {
+                        uint64_t previous = dec->comb[s];
+                        dec->comb[s] = y;
+                        y -= previous;
+                    }
+                    out[nb_out++] = PCF8591_decim_round_div((int64_t)y << PCF8591_DECIM_FRAC, dec->gain);
+                    dec->phase = 0;
+                }
+            }
+            break;
+
+        case PCF8591_FILTER_FIR :
+            for (; i < n; i++)
+            {
+                dec->delay[dec->position] = dec->delay[dec->position + dec->nb_tap] = in[i];
+                if (++dec->position == dec->nb_tap){ dec->position = 0;}
+
+                if (++dec->phase == dec->ratio)
+                {
+                    /* only the kept outputs are computed, on a contiguous window (vectorised) */
+                    const int16_t *window = dec->delay + dec->position;
+                    int32_t acc = 0;
+                    for (int k = 0; k < dec->nb_tap; k++){ acc += dec->tap[k] * window[k];}
+                    out[nb_out++] = PCF8591_decim_round_div(acc, 1 << (PCF8591_FIR_SHIFT - PCF8591_DECIM_FRAC));
+                    dec->phase = 0;
+                }
+            }
+            break;
+    }
+    return nb_out;
+}
+
+/**
+ * @brief Oversampling acquisition of all the channels of the active input mode.
+ */
+typedef struct
+{
+    pcf8591_t *dev;                                          ///< Converter sampled.
+    int nb_input;                                            ///< Channels of the active mode.
+    pcf8591_decim_t decim[PCF8591_NB_CHANNEL];               ///< Filter of each channel.
+    uint8_t burst[PCF8591_BLOCK_MAX];                        ///< Interleaved samples of one burst.
+    int16_t samples[PCF8591_NB_CHANNEL][PCF8591_BURST_SCAN_MAX / 2]; ///< Samples of one burst, per channel.
+    int32_t results[PCF8591_NB_CHANNEL][PCF8591_BURST_SCAN_MAX / 2]; ///< Results of one burst, per channel.
+    uint64_t nb_sample;                                      ///< Samples read per channel since the start.
+} pcf8591_oversample_t;
+
+/**
+ * @brief Initialise the oversampling acquisition of all the channels of the active input mode.
+ * @param os The acquisition.
+ * @param dev The converter (opened with pcf8591_open(), input mode already selected).
+ * @param filter PCF8591_FILTER_BOXCAR / PCF8591_FILTER_CIC / PCF8591_FILTER_FIR.
+ * @param ratio Decimation ratio.
+ * @param param CIC order or number of FIR taps (see PCF8591_decim_init()).
+ * @return 1 on success, -1 on bad argument.
+ */
+static inline int PCF8591_oversample_init(pcf8591_oversample_t *os, pcf8591_t *dev, pcf8591_filter_t filter, int ratio, int param)
+{
+    os->dev = dev;
+    os->nb_input = pcf8591_nb_input(dev->mode);
+    os->nb_sample = 0;
+    for (int c = 0; c < os->nb_input; c++)
+    {
+        if (PCF8591_decim_init(&os->decim[c], filter, ratio, param) < 0){return -1;}
+    }
+    return 1;
+}
+
+/**
+ * @brief Sample the channels at the bus rate and return decimated results.
+ * @param os The acquisition.
+ * @param out Buffer that will get nb_output results of each channel, with PCF8591_DECIM_FRAC fractional bits.
+ * @param nb_output Number of results per channel.
+ * @return nb_output on success, -1 if a transfer failed.
+ */
+static inline int PCF8591_oversample_read(pcf8591_oversample_t *os, int32_t out[][PCF8591_NB_CHANNEL], int nb_output)
+{
+    int nb_input = os->nb_input;
+    int done = 0;
+
+    while (done < nb_output)
+    {
+        /* just enough cycles to complete the requested results, in bursts as long as the bus allows */
+        int64_t nb_scan = (int64_t)(nb_output - done) * os->decim[0].ratio - os->decim[0].phase;
+        if (nb_scan > PCF8591_BURST_SCAN_MAX / nb_input){ nb_scan = PCF8591_BURST_SCAN_MAX / nb_input;}
+        if (pcf8591_read_burst(os->dev, os->burst, nb_scan) < 0){return -1;}
+        os->nb_sample += nb_scan;
+
+        int nb = 0;
+        for (int c = 0; c < nb_input; c++)
+        {
+            int differential = pcf8591_is_differential(os->dev->mode, c);
+            for (int i = 0; i < nb_scan; i++)
+            {
+                uint8_t data = os->burst[i * nb_input + c];
+                os->samples[c][i] = differential ? (int8_t)data : data;
+            }
+            nb = PCF8591_decim_process(&os->decim[c], os->samples[c], nb_scan, os->results[c]);
+        }
+
+        for (int i = 0; i < nb; i++)
+        {
+            for (int c = 0; c < nb_input; c++){ out[done + i][c] = os->results[c][i];}
+        }
+        done += nb;
+    }
+    return nb_output;
+}
+
+/**
+ * @brief Convert a decimated result to µV, interpolated in the conversion table of the channel.
+ * @param os The acquisition.
+ * @param channel Channel of the active mode.
+ * @param value Result with PCF8591_DECIM_FRAC fractional bits.
+ * @return Voltage in µV.
+ */
+static inline int32_t PCF8591_oversample_to_uv(const pcf8591_oversample_t *os, uint8_t channel, int32_t value)
+{
+    int low = pcf8591_is_differential(os->dev->mode, channel) ? -128 : 0;
+    int code = value >> PCF8591_DECIM_FRAC; ///< floor
+    int frac = value - (code << PCF8591_DECIM_FRAC);
+
+    if (code < low){ code = low; frac = 0;}
+    if (code >= low + 255){ code = low + 254; frac = 1 << PCF8591_DECIM_FRAC;}
+
+    int32_t mv0 = pcf8591_data_to_mv(os->dev, channel, (uint8_t)code);
+    int32_t mv1 = pcf8591_data_to_mv(os->dev, channel, (uint8_t)(code + 1));
+    return mv0 * 1000 + PCF8591_decim_round_div((int64_t)(mv1 - mv0) * 1000 * frac, 1 << PCF8591_DECIM_FRAC);
+}
+
+#endif
@@ -0,0 +1,380 @@
+/**
+ * @brief Fixed-period ADC to DAC control loop on the PCF8591
+
+ * @file PCF8591_loop.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -pthread -lm to the gcc command line.
+ *
+ * A dedicated thread runs, on absolute CLOCK_MONOTONIC deadlines :
+ *      read one ADC channel -> transfer function -> write the DAC
+ * The read is a fresh conversion (pcf8591_read_data_now()) : control byte, stale byte and the data converted during
+ * the transfer, so the sample is not the conversion left pending one period earlier. The latency is measured from
+ * the start of that transfer to the end of the DAC write.
+ *
+ * The transfer function is a callback. Gain + offset, PID with anti-windup and lookup table are provided.
+ *
+ * The thread can run with the SCHED_FIFO real-time policy and lock the process memory (mlockall), so page faults
+ * and normal tasks don't delay it. It never calls stdio nor takes a lock other than the bus, taken in the real-time
+ * class (I2C_CLASS_RT of i2c_bus.h) so the display frames and the other reads don't delay it either :
+ *  - every period is pushed in a lock-free log ring, drained by another thread with PCF8591_loop_log_read().
+ *  - the timing statistics are published with a sequence counter and copied with PCF8591_loop_stats().
+ * If the thread is late by more than one period, the missed periods are skipped and counted.
+ *
+ * @warning SCHED_FIFO and mlockall need root or the CAP_SYS_NICE / CAP_IPC_LOCK capabilities.
+ * @warning Don't use the converter from another thread while the loop is running.
+ */
+
+#ifndef PCF8591_LOOP_H
+#define PCF8591_LOOP_H
+
+#include "PCF8591.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+
+#ifndef PCF8591_LOOP_LOG_SIZE
+#define PCF8591_LOOP_LOG_SIZE 4096 ///< Number of periods in the log ring (power of 2).
+#endif
+
+#if (PCF8591_LOOP_LOG_SIZE & (PCF8591_LOOP_LOG_SIZE - 1)) != 0
+#error "PCF8591_LOOP_LOG_SIZE must be a power of 2"
+#endif
+
+/**
+ * @brief Transfer function : compute the DAC code from the ADC sample, once per period.
+ * @param arg User data given to PCF8591_loop_start().
+ * @param dev The converter (for its conversion tables).
+ * @param data 8 bit data read on the input channel.
+ * @param input_mv The same sample in mV.
+ * @return DAC code to write.
+ */
+typedef uint8_t (*pcf8591_transfer_t)(void *arg, const pcf8591_t *dev, uint8_t data, int input_mv);
+
+/**
+ * @brief Gain and offset transfer function : output = gain * input + offset.
+ */
+typedef struct
+{
+    double gain;    ///< Gain (V/V).
+    int offset_mv;  ///< Offset added to the output (mV).
+} pcf8591_gain_t;
+
+/**
+ * @brief PID transfer function with anti-windup, on the error setpoint - input.
+ */
+typedef struct
+{
+    double kp;            ///< Proportional gain (V/V).
+    double ki;            ///< Integral gain (1/s).
+    double kd;            ///< Derivative gain (s).
+    int setpoint_mv;      ///< Setpoint (mV).
+    int out_min_mv;       ///< Lowest output (mV).
+    int out_max_mv;       ///< Highest output (mV).
+    double dt;            ///< Loop period (s), set by PCF8591_loop_start().
+    double integral;      ///< Integral term (mV).
+    double previous_mv;   ///< Previous input, for the derivative on the measure (no kick on setpoint changes).
+    int primed;           ///< 1 once the first sample has been seen.
+} pcf8591_pid_t;
+
+/**
+ * @brief One period of the loop, as logged.
+ */
+typedef struct
+{
+    uint64_t timestamp_ns; ///< Start of the ADC transfer (the conversion is sampled during it).
+    uint32_t latency_ns;   ///< Time from the start of the ADC read to the end of the DAC write.
+    uint8_t input;         ///< ADC data.
+    uint8_t output;        ///< DAC code written.
+} pcf8591_loop_record_t;
+
+/**
+ * @brief Loop timing statistics.
+ */
+typedef struct
+{
+    uint64_t nb_period;        ///< Periods run since the start (or the last reset).
+    uint64_t nb_missed;        ///< Periods skipped because the thread was more than one period late.
+    uint64_t nb_dropped;       ///< Log records dropped because the log ring was full.
+    uint64_t nb_interval;      ///< Periods measured (the first period after a skip is not).
+    int64_t min_period_ns;     ///< Shortest measured period.
+    int64_t max_period_ns;     ///< Longest measured period.
+    double sum_period_ns;      ///< Sum of the measured periods (for the mean).
+    uint64_t min_latency_ns;   ///< Shortest input to output latency.
+    uint64_t max_latency_ns;   ///< Longest input to output latency.
+    double sum_latency_ns;     ///< Sum of the latencies (for the mean).
+    uint64_t max_wakeup_ns;    ///< Worst delay between a deadline and the start of the ADC read.
+} pcf8591_loop_stats_t;
+
+/**
+ * @brief Control loop state.
+ */
+typedef struct
+{
+    pcf8591_t *dev;                     ///< Converter used.
+    uint8_t channel;                    ///< ADC input channel.
+    uint64_t period_ns;                 ///< Loop period.
+    pcf8591_transfer_t transfer;        ///< Transfer function.
+    void *arg;                          ///< User data of the transfer function.
+    int priority;                       ///< SCHED_FIFO priority (1 to 99), 0 for the normal policy.
+    pcf8591_loop_record_t log[PCF8591_LOOP_LOG_SIZE]; ///< Periods waiting for the log consumer.
+    _Alignas(64) atomic_size_t log_head;  ///< Next record written by the loop thread.
+    _Alignas(64) atomic_size_t log_tail;  ///< Next record read by the consumer.
+    _Alignas(64) atomic_uint stats_seq;   ///< Odd while the loop thread updates the statistics.
+    pcf8591_loop_stats_t stats;           ///< Timing statistics.
+    atomic_int reset;                     ///< Set to ask the loop thread to restart the statistics.
+    atomic_int running;                   ///< 1 while the loop thread is running.
+    atomic_int error;                     ///< 1 if the loop stopped on an I2C error.
+    pthread_t thread;                     ///< Loop thread.
+} pcf8591_loop_t;
+
+/**
+ * @brief Gain and offset transfer function (arg : pcf8591_gain_t).
+ */
+static inline uint8_t PCF8591_loop_gain(void *arg, const pcf8591_t *dev, uint8_t data, int input_mv)
+{
+    const pcf8591_gain_t *gain = arg;
+    (void)data;
+    return pcf8591_mv_to_data(dev, lround(gain->gain * input_mv) + gain->offset_mv);
+}
+
+/**
+ * @brief PID transfer function (arg : pcf8591_pid_t).
+ * The integral stops growing while the output is saturated in the direction of the error (conditional integration).
+ */
+static inline uint8_t PCF8591_loop_pid(void *arg, const pcf8591_t *dev, uint8_t data, int input_mv)
+{
+    pcf8591_pid_t *pid = arg;
+    double error = pid->setpoint_mv - input_mv;
+    double derivative = pid->primed ? -(input_mv - pid->previous_mv) / pid->dt : 0;
+    (void)data;
+
+    double integral = pid->integral + pid->ki * error * pid->dt;
+    double output = pid->kp * error + integral + pid->kd * derivative;
+
+    /* anti-windup : keep the previous integral when the output saturates and the error pushes further */
+    if (output > pid->out_max_mv)
+    {
+        output = pid->out_max_mv;
+        if (error < 0){ pid->integral = integral;}
+    }
+    else if (output < pid->out_min_mv)
+    {
+        output = pid->out_min_mv;
+        if (error > 0){ pid->integral = integral;}
+    }
+    else
+    {
+        pid->integral = integral;
+    }
+
+    pid->previous_mv = input_mv;
+    pid->primed = 1;
+    return pcf8591_mv_to_data(dev, lround(output));
+}
+
+/**
+ * @brief Lookup table transfer function (arg : 256 DAC codes, indexed by the ADC data).
+ */
+static inline uint8_t PCF8591_loop_table(void *arg, const pcf8591_t *dev, uint8_t data, int input_mv)
+{
+    const uint8_t *table = arg;
+    (void)dev;
+    (void)input_mv;
+    return table[data];
+}
+
+/**
+ * @brief Loop thread : read, compute and write on absolute deadlines.
+ * @param arg The loop.
+ * @return NULL.
+ */
+static inline void *PCF8591_loop_thread(void *arg)
+{
+    pcf8591_loop_t *loop = arg;
+    pcf8591_loop_stats_t *stats = &loop->stats;
+    uint64_t deadline = PCF8591_time_ns() + loop->period_ns;
+    uint64_t last_read = 0;
+
+    i2c_bus_set_class(I2C_CLASS_RT);
+    while (atomic_load_explicit(&loop->running, memory_order_relaxed))
+    {
+        PCF8591_sleep_until(deadline);
+
+        uint64_t start = PCF8591_time_ns(); ///< start of the conversion
+        uint8_t input = pcf8591_read_data_now(loop->dev, loop->channel);
+        if (loop->dev->control < 0){ atomic_store(&loop->error, 1); break;} ///< the transfer failed
+        uint8_t output = loop->transfer(loop->arg, loop->dev, input, pcf8591_data_to_mv(loop->dev, loop->channel, input));
+        pcf8591_write_data(loop->dev, output);
+        uint64_t end = PCF8591_time_ns();
+        if (loop->dev->control < 0){ atomic_store(&loop->error, 1); break;}
+
+        /* log record, dropped if the consumer is late */
+        size_t head = atomic_load_explicit(&loop->log_head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&loop->log_tail, memory_order_acquire);
+        int dropped = (head - tail >= PCF8591_LOOP_LOG_SIZE);
+        if (!dropped)
+        {
+            loop->log[head & (PCF8591_LOOP_LOG_SIZE - 1)] = (pcf8591_loop_record_t){.timestamp_ns = start, .latency_ns = end - start, .input = input, .output = output};
+            atomic_store_explicit(&loop->log_head, head + 1, memory_order_release);
+        }
+
+        /* statistics, published with the sequence counter (odd while writing) */
+        uint64_t now = PCF8591_time_ns();
+        uint64_t missed = (now > deadline + loop->period_ns) ? (now - deadline) / loop->period_ns : 0;
+        atomic_fetch_add_explicit(&loop->stats_seq, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        if (atomic_exchange_explicit(&loop->reset, 0, memory_order_relaxed)){ memset(stats, 0, sizeof(*stats)); last_read = 0;}
+        uint64_t latency = end - start;
+        if ((stats->nb_period == 0) || (latency < stats->min_latency_ns)){ stats->min_latency_ns = latency;}
+        if (latency > stats->max_latency_ns){ stats->max_latency_ns = latency;}
+        stats->sum_latency_ns += latency;
+        if (start - deadline > stats->max_wakeup_ns){ stats->max_wakeup_ns = start - deadline;}
+        if (last_read != 0)
+        {
+            int64_t period = start - last_read;
+            if ((stats->nb_interval == 0) || (period < stats->min_period_ns)){ stats->min_period_ns = period;}
+            if (period > stats->max_period_ns){ stats->max_period_ns = period;}
+            stats->sum_period_ns += period;
+            stats->nb_interval++;
+        }
+        stats->nb_period++;
+        stats->nb_missed += missed;
+        stats->nb_dropped += dropped;
+        atomic_store_explicit(&loop->stats_seq, atomic_load_explicit(&loop->stats_seq, memory_order_relaxed) + 1, memory_order_release);
+
+        /* next deadline, the missed periods are skipped */
+        last_read = missed ? 0 : start;
+        deadline += (missed + 1) * loop->period_ns;
+    }
+    atomic_store(&loop->running, 0);
+    return NULL;
+}
+
+/**
+ * @brief Start the control loop.
+ * @param loop The loop.
+ * @param dev The converter (opened with pcf8591_open()).
+ * @param channel ADC input channel of the active mode.
+ * @param period_ns Loop period (ns).
+ * @param transfer Transfer function (PCF8591_loop_gain / PCF8591_loop_pid / PCF8591_loop_table or user function).
+ * @param arg User data of the transfer function.
+ * @param priority SCHED_FIFO priority of the loop thread (1 to 99), 0 to keep the normal policy.
+ * @param lock_memory 1 to lock the process memory in RAM (mlockall) before starting.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_loop_start(pcf8591_loop_t *loop, pcf8591_t *dev, uint8_t channel, uint64_t period_ns,
+                                     pcf8591_transfer_t transfer, void *arg, int priority, int lock_memory)
+{
+    pthread_attr_t attr;
+
+    if ((period_ns == 0) | (transfer == NULL) | (priority < 0) | (priority > 99)){ printf("/!\\ Error : bad control loop parameters.\n"); return -1;}
+    if (pcf8591_control(dev, channel) < 0){ return -1;}
+
+    loop->dev = dev;
+    loop->channel = channel;
+    loop->period_ns = period_ns;
+    loop->transfer = transfer;
+    loop->arg = arg;
+    loop->priority = priority;
+    memset(&loop->stats, 0, sizeof(loop->stats));
+    atomic_init(&loop->log_head, 0);
+    atomic_init(&loop->log_tail, 0);
+    atomic_init(&loop->stats_seq, 0);
+    atomic_init(&loop->reset, 0);
+    atomic_init(&loop->running, 1);
+    atomic_init(&loop->error, 0);
+    if (transfer == PCF8591_loop_pid){ ((pcf8591_pid_t *)arg)->dt = period_ns / 1e9;}
+
+    if (lock_memory && (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)){ printf("/!\\ Error : cannot lock the memory (%s).\n", strerror(errno)); return -1;}
+
+    pthread_attr_init(&attr);
+    if (priority > 0)
+    {
+        struct sched_param param = {.sched_priority = priority};
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+    int result = pthread_create(&loop->thread, &attr, PCF8591_loop_thread, loop);
+    pthread_attr_destroy(&attr);
+    if (result != 0)
+    {
+        printf("/!\\ Error : cannot start the control loop thread (%s).\n", strerror(result));
+        atomic_store(&loop->running, 0);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stop the control loop, the DAC keeps the last value written.
+ * @param loop The loop.
+ */
+static inline void PCF8591_loop_stop(pcf8591_loop_t *loop)
+{
+    atomic_store(&loop->running, 0);
+    pthread_join(loop->thread, NULL);
+}
+
+/**
+ * @brief Drain a batch of log records.
+ * @param loop The loop.
+ * @param records Buffer that will get the records, oldest first.
+ * @param nb_max Size of the buffer.
+ * @return Number of records copied (0 if the log is empty).
+ * @warning Only one thread can read the log.
+ */
+static inline int PCF8591_loop_log_read(pcf8591_loop_t *loop, pcf8591_loop_record_t *records, int nb_max)
+{
+    size_t tail = atomic_load_explicit(&loop->log_tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&loop->log_head, memory_order_acquire);
+    size_t nb = head - tail;
+
+    if (nb > (size_t)nb_max){ nb = nb_max;}
+    for (size_t i = 0; i < nb; i++)
+    {
+        records[i] = loop->log[(tail + i) & (PCF8591_LOOP_LOG_SIZE - 1)];
+    }
+    atomic_store_explicit(&loop->log_tail, tail + nb, memory_order_release);
+    return nb;
+}
+
+/**
+ * @brief Copy the timing statistics without stopping the loop thread.
+ * @param loop The loop.
+ * @param stats Structure that will get the statistics.
+ * @param reset 1 to restart the statistics after the copy (done by the loop thread at the next period).
+ */
+static inline void PCF8591_loop_stats(pcf8591_loop_t *loop, pcf8591_loop_stats_t *stats, int reset)
+{
+    unsigned int seq;
+    do
+    {
+        seq = atomic_load_explicit(&loop->stats_seq, memory_order_acquire);
+        memcpy(stats, (const void *)&loop->stats, sizeof(*stats));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || (seq != atomic_load_explicit(&loop->stats_seq, memory_order_relaxed))); ///< retry if the thread wrote meanwhile
+    if (reset){ atomic_store(&loop->reset, 1);}
+}
+
+/**
+ * @brief Display the timing statistics.
+ * @param stats The statistics copied by PCF8591_loop_stats().
+ */
+static inline void PCF8591_loop_report(const pcf8591_loop_stats_t *stats)
+{
+    uint64_t nb = stats->nb_period;
+    printf("Loop : %llu periods, %llu deadline misses, %llu log records dropped\n",
+           (unsigned long long)nb, (unsigned long long)stats->nb_missed, (unsigned long long)stats->nb_dropped);
+    printf("> period mean %.1f us min %.1f us max %.1f us, wakeup delay max %.1f us\n",
+           stats->nb_interval ? stats->sum_period_ns / 1e3 / stats->nb_interval : 0, stats->min_period_ns / 1e3, stats->max_period_ns / 1e3, stats->max_wakeup_ns / 1e3);
+    printf("> input to output latency mean %.1f us min %.1f us max %.1f us\n",
+           nb ? stats->sum_latency_ns / 1e3 / nb : 0, stats->min_latency_ns / 1e3, stats->max_latency_ns / 1e3);
+}
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * @brief Drift-free PWM generator on the PCF8591 DAC output
+
+ * @file PCF8591_pwm.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -pthread to the gcc command line.
+ *
+ * A dedicated thread writes the high and low levels on absolute CLOCK_MONOTONIC deadlines
+ * (period start and period start + high time), so the I2C write time and the wakeup latency
+ * never add up from one period to the next.
+ *
+ * The DAC latches the new level at the end of the I2C write : the thread measures the write time
+ * and wakes up that much earlier (phase correction), so the edge itself lands on the deadline.
+ * If the thread is late by more than one period, the missed periods are skipped instead of being
+ * played back to back.
+ * The thread accesses the bus in the real-time class (I2C_CLASS_RT of i2c_bus.h).
+ *
+ * The frequency, duty cycle and levels can be changed at any time with PCF8591_pwm_set(),
+ * the new values are applied at the start of the next period.
+ *
+ * @warning Don't write on the DAC of the same converter from another thread while the PWM is running.
+ */
+
+#ifndef PCF8591_PWM_H
+#define PCF8591_PWM_H
+
+#include "PCF8591.h"
+#include <pthread.h>
+
+/**
+ * @brief Per-period jitter statistics, measured on the rising edges.
+ */
+typedef struct
+{
+    uint64_t nb_period;       ///< Periods output since the start (or the last reset).
+    uint64_t nb_missed;       ///< Periods skipped because the thread was more than one period late.
+    int64_t min_error_ns;     ///< Smallest difference between the measured and the requested period.
+    int64_t max_error_ns;     ///< Largest difference between the measured and the requested period.
+    double sum_error_ns;      ///< Sum of the period errors (for the mean).
+    double sum_sq_error_ns;   ///< Sum of the squared period errors (for the standard deviation).
+    int64_t max_phase_ns;     ///< Worst distance between an edge and its deadline.
+    uint64_t write_ns;        ///< Current estimation of the DAC write time.
+} pcf8591_pwm_stats_t;
+
+/**
+ * @brief PWM generator state.
+ */
+typedef struct
+{
+    pcf8591_t *dev;             ///< Converter driven.
+    pthread_mutex_t lock;       ///< Protects the parameters and the statistics.
+    uint64_t period_ns;         ///< Requested period.
+    uint64_t high_ns;           ///< Requested high time.
+    uint8_t high_code;          ///< DAC code of the high state.
+    uint8_t low_code;           ///< DAC code of the low state.
+    pcf8591_pwm_stats_t stats;  ///< Jitter statistics.
+    int running;                ///< 1 while the PWM thread is running.
+    pthread_t thread;           ///< PWM thread.
+} pcf8591_pwm_t;
+
+/**
+ * @brief Change the PWM parameters, applied at the start of the next period.
+ * @param pwm The PWM generator.
+ * @param frequency PWM frequency (Hz).
+ * @param duty Duty cycle (0 to 100 %).
+ * @param high_mv Voltage of the high state (mV).
+ * @param low_mv Voltage of the low state (mV).
+ * @return 1 on success, -1 on bad argument.
+ */
+static inline int PCF8591_pwm_set(pcf8591_pwm_t *pwm, double frequency, double duty, int high_mv, int low_mv)
+{
+    if ((frequency <= 0) | (duty < 0) | (duty > 100)){ printf("/!\\ Error : bad PWM frequency or duty cycle.\n"); return -1;}
+
+    pthread_mutex_lock(&pwm->lock);
+    pwm->period_ns = (uint64_t)llround(1e9 / frequency);
+    pwm->high_ns = (uint64_t)llround(pwm->period_ns * duty / 100);
+    pwm->high_code = pcf8591_mv_to_data(pwm->dev, high_mv);
+    pwm->low_code = pcf8591_mv_to_data(pwm->dev, low_mv);
+    pthread_mutex_unlock(&pwm->lock);
+    return 1;
+}
+
+/**
+ * @brief Write one level on its deadline and return the time at which the write was over.
+ * @param dev The converter.
+ * @param write_ns Estimation of the write time, updated with the measured one.
+ * @param max_phase_ns Worst edge phase error, updated.
+ * @param deadline_ns Time at which the level must be on the output.
+ * @param code DAC code of the level.
+ */
+static inline uint64_t PCF8591_pwm_edge(pcf8591_t *dev, uint64_t *write_ns, int64_t *max_phase_ns, uint64_t deadline_ns, uint8_t code)
+{
+    PCF8591_sleep_until(deadline_ns - *write_ns); ///< wake up early by the write time
+    uint64_t start = PCF8591_time_ns();
+    pcf8591_write_data(dev, code);
+    uint64_t end = PCF8591_time_ns();
+
+    *write_ns += ((int64_t)(end - start) - (int64_t)*write_ns) / 8; ///< running average of the write time
+    int64_t phase = llabs((int64_t)(end - deadline_ns));
+    if (phase > *max_phase_ns){ *max_phase_ns = phase;}
+    return end;
+}
+
+/**
+ * @brief PWM thread : output the periods on absolute deadlines.
+ * @param arg The PWM generator.
+ * @return NULL.
+ */
+static inline void *PCF8591_pwm_thread(void *arg)
+{
+    pcf8591_pwm_t *pwm = arg;
+    pcf8591_pwm_stats_t *stats = &pwm->stats;
+    uint64_t period_start = PCF8591_time_ns() + 1000000; ///< first edge 1 ms after the start
+    uint64_t last_rise = 0;
+    uint64_t write_ns = 0;
+
+    i2c_bus_set_class(I2C_CLASS_RT); ///< the edges go before the other accesses of the bus
+    while (1)
+    {
+        /* parameters of this period */
+        pthread_mutex_lock(&pwm->lock);
+        int running = pwm->running;
+        uint64_t period_ns = pwm->period_ns;
+        uint64_t high_ns = pwm->high_ns;
+        uint8_t high_code = pwm->high_code;
+        uint8_t low_code = pwm->low_code;
+        pthread_mutex_unlock(&pwm->lock);
+        if (!running){ break;}
+
+        /* skip the periods already missed */
+        uint64_t now = PCF8591_time_ns();
+        if (now > period_start + period_ns)
+        {
+            uint64_t missed = (now - period_start) / period_ns;
+            period_start += missed * period_ns;
+            pthread_mutex_lock(&pwm->lock);
+            stats->nb_missed += missed;
+            pthread_mutex_unlock(&pwm->lock);
+            last_rise = 0;
+        }
+
+        int64_t max_phase_ns = 0;
+        uint64_t rise = PCF8591_pwm_edge(pwm->dev, &write_ns, &max_phase_ns, period_start, (high_ns > 0) ? high_code : low_code);
+        if ((high_ns > 0) & (high_ns < period_ns))
+        {
+            PCF8591_pwm_edge(pwm->dev, &write_ns, &max_phase_ns, period_start + high_ns, low_code);
+        }
+
+        pthread_mutex_lock(&pwm->lock);
+        stats->write_ns = write_ns;
+        if (max_phase_ns > stats->max_phase_ns){ stats->max_phase_ns = max_phase_ns;}
+        if (last_rise != 0)
+        {
+            int64_t error = (int64_t)(rise - last_rise) - (int64_t)period_ns;
+            if ((stats->nb_period == 0) || (error < stats->min_error_ns)){ stats->min_error_ns = error;}
+            if ((stats->nb_period == 0) || (error > stats->max_error_ns)){ stats->max_error_ns = error;}
+            stats->sum_error_ns += error;
+            stats->sum_sq_error_ns += (double)error * error;
+            stats->nb_period++;
+        }
+        pthread_mutex_unlock(&pwm->lock);
+
+        last_rise = rise;
+        period_start += period_ns;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start the PWM generator.
+ * @param pwm The PWM generator.
+ * @param dev The converter to drive (opened with pcf8591_open()).
+ * @param frequency PWM frequency (Hz).
+ * @param duty Duty cycle (0 to 100 %).
+ * @param high_mv Voltage of the high state (mV).
+ * @param low_mv Voltage of the low state (mV).
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_pwm_start(pcf8591_pwm_t *pwm, pcf8591_t *dev, double frequency, double duty, int high_mv, int low_mv)
+{
+    memset(pwm, 0, sizeof(*pwm));
+    pwm->dev = dev;
+    pthread_mutex_init(&pwm->lock, NULL);
+    if (PCF8591_pwm_set(pwm, frequency, duty, high_mv, low_mv) < 0){ return -1;}
+
+    pwm->running = 1;
+    if (pthread_create(&pwm->thread, NULL, PCF8591_pwm_thread, pwm) != 0)
+    {
+        printf("/!\\ Error : cannot start the PWM thread.\n");
+        pwm->running = 0;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stop the PWM generator, the DAC keeps the last level written.
+ * @param pwm The PWM generator.
+ */
+static inline void PCF8591_pwm_stop(pcf8591_pwm_t *pwm)
+{
+    pthread_mutex_lock(&pwm->lock);
+    pwm->running = 0;
+    pthread_mutex_unlock(&pwm->lock);
+    pthread_join(pwm->thread, NULL);
+    pthread_mutex_destroy(&pwm->lock);
+}
+
+/**
+ * @brief Copy the jitter statistics.
+ * @param pwm The PWM generator.
+ * @param stats Structure that will get the statistics.
+ * @param reset 1 to restart the statistics after the copy.
+ */
+static inline void PCF8591_pwm_stats(pcf8591_pwm_t *pwm, pcf8591_pwm_stats_t *stats, int reset)
+{
+    pthread_mutex_lock(&pwm->lock);
+    *stats = pwm->stats;
+    if (reset){ memset(&pwm->stats, 0, sizeof(pwm->stats));}
+    pthread_mutex_unlock(&pwm->lock);
+}
+
+/**
+ * @brief Display the jitter statistics.
+ * @param stats The statistics copied by PCF8591_pwm_stats().
+ */
+static inline void PCF8591_pwm_report(const pcf8591_pwm_stats_t *stats)
+{
+    double mean = 0, deviation = 0;
+    if (stats->nb_period > 0)
+    {
+        mean = stats->sum_error_ns / stats->nb_period;
+        deviation = sqrt(fmax(0, stats->sum_sq_error_ns / stats->nb_period - mean * mean));
+    }
+    printf("PWM : %llu periods, %llu missed, period error mean %.1f us, std dev %.1f us, min %.1f us, max %.1f us\n",
+           (unsigned long long)stats->nb_period, (unsigned long long)stats->nb_missed, mean / 1e3, deviation / 1e3,
+           stats->min_error_ns / 1e3, stats->max_error_ns / 1e3);
+    printf("> worst edge phase error %.1f us, DAC write time %.1f us\n", stats->max_phase_ns / 1e3, stats->write_ns / 1e3);
+}
+
+#endif
@@ -0,0 +1,472 @@
+/**
+ * @brief Binary capture files of PCF8591 samples : background writer and mmap replay
+
+ * @file PCF8591_record.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -pthread to the gcc command line.
+ *
+ * File format (little endian, every part aligned on PCF8591_FILE_BLOCK bytes) :
+ *  - header block   : pcf8591_file_header_t (converter, input mode, Vref, sample rate, number of blocks, index position).
+ *  - sample blocks  : pcf8591_file_block_t, fixed size, PCF8591_FILE_SAMPLES samples with a 32 bit time offset
+ *                     from the time of the block (8 bytes per sample instead of 16).
+ *  - index          : time of the first sample of every block, for the seek by time.
+ *
+ * Writer : PCF8591_record_write() fills blocks in a ring and never waits ; a dedicated thread writes the full
+ * blocks with one pwrite() per run of contiguous blocks. When the disk is too slow and the ring is full,
+ * the samples are dropped and counted.
+ *
+ * Reader : PCF8591_replay_open() maps the whole file. The blocks are read in place (PCF8591_replay_block())
+ * or as pcf8591_sample_t batches with PCF8591_replay_read(), the same samples as PCF8591_stream_read() gives
+ * for a live acquisition.
+ */
+
+#ifndef PCF8591_RECORD_H
+#define PCF8591_RECORD_H
+
+#include "PCF8591_stream.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PCF8591_FILE_MAGIC "PCF8591" ///< First bytes of a capture file.
+#define PCF8591_FILE_VERSION 1 ///< Format version.
+#define PCF8591_FILE_BLOCK 4096 ///< Size of the header and of a sample block (bytes).
+#define PCF8591_FILE_SAMPLES ((PCF8591_FILE_BLOCK - 16) / 8) ///< Samples per block (510).
+#define PCF8591_FILE_SPAN_NS 4000000000ull ///< Longest time covered by one block (32 bit offsets).
+
+#ifndef PCF8591_RECORD_RING
+#define PCF8591_RECORD_RING 64 ///< Blocks waiting for the writer thread (power of 2).
+#endif
+
+#if (PCF8591_RECORD_RING & (PCF8591_RECORD_RING - 1)) != 0
+#error "PCF8591_RECORD_RING must be a power of 2"
+#endif
+
+/**
+ * @brief File header, stored in the first block.
+ */
+typedef struct
+{
+    char magic[8];           ///< PCF8591_FILE_MAGIC.
+    uint32_t version;        ///< PCF8591_FILE_VERSION.
+    uint32_t block_size;     ///< PCF8591_FILE_BLOCK.
+    char bus[32];            ///< I2C bus of the converter.
+    uint8_t address;         ///< I2C address of the converter.
+    uint8_t mode;            ///< Analog input programming.
+    uint16_t vref_mv;        ///< Reference voltage.
+    uint32_t reserved;
+    double sample_rate;      ///< Nominal sample rate (all channels together, 0 if unknown).
+    uint64_t start_ns;       ///< CLOCK_MONOTONIC time of the start of the record.
+    uint64_t nb_block;       ///< Number of sample blocks (0 until the file is closed).
+    uint64_t index_offset;   ///< Position of the block index (0 until the file is closed).
+} pcf8591_file_header_t;
+
+/**
+ * @brief One sample in a block.
+ */
+typedef struct
+{
+    uint32_t offset_ns;  ///< Time from the first sample of the block.
+    uint8_t channel;     ///< ADC input.
+    uint8_t data;        ///< 8 bit data.
+    uint16_t reserved;
+} pcf8591_file_sample_t;
+
+/**
+ * @brief One sample block.
+ */
+typedef struct
+{
+    uint64_t first_ns;   ///< Time of the first sample.
+    uint32_t nb_sample;  ///< Samples used in the block (up to PCF8591_FILE_SAMPLES).
+    uint32_t sequence;   ///< Block number.
+    pcf8591_file_sample_t sample[PCF8591_FILE_SAMPLES];
+} pcf8591_file_block_t;
+
+_Static_assert(sizeof(pcf8591_file_header_t) <= PCF8591_FILE_BLOCK, "header larger than a block");
+_Static_assert(sizeof(pcf8591_file_block_t) == PCF8591_FILE_BLOCK, "block size");
+
+/**
+ * @brief Capture file writer.
+ */
+typedef struct
+{
+    _Alignas(PCF8591_FILE_BLOCK) pcf8591_file_block_t ring[PCF8591_RECORD_RING]; ///< Blocks being filled or waiting for the writer.
+    _Alignas(64) atomic_size_t head;      ///< Blocks completed by the producer.
+    _Alignas(64) atomic_size_t tail;      ///< Blocks written by the writer thread.
+    _Alignas(64) atomic_ulong nb_dropped; ///< Samples dropped because the ring was full.
+    pcf8591_file_header_t header;         ///< Header written at the start and updated at the end.
+    uint32_t nb_fill;                     ///< Samples in the block being filled.
+    uint64_t *index;                      ///< Time of the first sample of every block written.
+    size_t index_size;                    ///< Entries allocated in the index.
+    int fd;                               ///< Capture file.
+    atomic_int running;                   ///< 1 while the writer thread is running.
+    atomic_int error;                     ///< 1 if a write failed.
+    pthread_t thread;                     ///< Writer thread.
+} pcf8591_recorder_t;
+
+/**
+ * @brief Writer thread : write the full blocks by runs of contiguous blocks.
+ * @param arg The recorder.
+ * @return NULL.
+ */
+static inline void *PCF8591_record_thread(void *arg)
+{
+    pcf8591_recorder_t *rec = arg;
+
+    while (1)
+    {
+        int running = atomic_load_explicit(&rec->running, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&rec->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&rec->head, memory_order_acquire);
+
+        if (head == tail)
+        {
+            if (!running){ break;}
+            usleep(1000);
+            continue;
+        }
+
+        /* contiguous run, up to the end of the ring */
+        size_t first = tail & (PCF8591_RECORD_RING - 1);
+        size_t nb = head - tail;
+        if (nb > PCF8591_RECORD_RING - first){ nb = PCF8591_RECORD_RING - first;}
+
+        off_t offset = PCF8591_FILE_BLOCK * (off_t)(1 + tail);
+        if (pwrite(rec->fd, &rec->ring[first], nb * PCF8591_FILE_BLOCK, offset) != (ssize_t)(nb * PCF8591_FILE_BLOCK))
+        {
+            printf("/!\\ Error : cannot write the capture file (%s).\n", strerror(errno));
+            atomic_store(&rec->error, 1);
+            break;
+        }
+
+        if (tail + nb > rec->index_size)
+        {
+            size_t size = rec->index_size ? 2 * rec->index_size : 1024;
+            while (size < tail + nb){ size *= 2;}
+            uint64_t *index = realloc(rec->index, size * sizeof(uint64_t));
+            if (index == NULL){ printf("/!\\ Error : no memory for the block index.\n"); atomic_store(&rec->error, 1); break;}
+            rec->index = index;
+            rec->index_size = size;
+        }
+        for (size_t i = 0; i < nb; i++){ rec->index[tail + i] = rec->ring[first + i].first_ns;}
+
+        atomic_store_explicit(&rec->tail, tail + nb, memory_order_release);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Create a capture file and start its writer thread.
+ * @param rec The recorder.
+ * @param path Path of the file (replaced if it exists).
+ * @param dev The converter sampled (for the header).
+ * @param sample_rate Nominal sample rate, all channels together (0 if unknown).
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_record_open(pcf8591_recorder_t *rec, const char *path, const pcf8591_t *dev, double sample_rate)
+{
+    static const uint8_t zero[PCF8591_FILE_BLOCK];
+
+    if ((rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0){ printf("/!\\ Error : cannot create %s (%s).\n", path, strerror(errno)); return -1;}
+
+    memset(&rec->header, 0, sizeof(rec->header));
+    memcpy(rec->header.magic, PCF8591_FILE_MAGIC, sizeof(PCF8591_FILE_MAGIC));
+    rec->header.version = PCF8591_FILE_VERSION;
+    rec->header.block_size = PCF8591_FILE_BLOCK;
+    snprintf(rec->header.bus, sizeof(rec->header.bus), "%s", dev->bus);
+    rec->header.address = dev->address;
+    rec->header.mode = dev->mode;
+    rec->header.vref_mv = dev->vref_mv;
+    rec->header.sample_rate = sample_rate;
+    rec->header.start_ns = PCF8591_time_ns();
+
+    /* header block : rewritten with the number of blocks and the index position at the end */
+    if ((pwrite(rec->fd, zero, PCF8591_FILE_BLOCK, 0) != PCF8591_FILE_BLOCK) || (pwrite(rec->fd, &rec->header, sizeof(rec->header), 0) != sizeof(rec->header)))
+    {
+        printf("/!\\ Error : cannot write %s (%s).\n", path, strerror(errno));
+        close(rec->fd);
+        return -1;
+    }
+
+    rec->index = NULL;
+    rec->index_size = 0;
+    atomic_init(&rec->head, 0);
+    atomic_init(&rec->tail, 0);
+    atomic_init(&rec->nb_dropped, 0);
+    atomic_init(&rec->error, 0);
+    atomic_init(&rec->running, 1);
+    rec->nb_fill = 0;
+
+    if (pthread_create(&rec->thread, NULL, PCF8591_record_thread, rec) != 0)
+    {
+        printf("/!\\ Error : cannot start the writer thread.\n");
+        close(rec->fd);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Hand the block being filled to the writer thread.
+ * @param rec The recorder.
+ */
+static inline void PCF8591_record_flush(pcf8591_recorder_t *rec)
+{
+    size_t head = atomic_load_explicit(&rec->head, memory_order_relaxed);
+    pcf8591_file_block_t *block = &rec->ring[head & (PCF8591_RECORD_RING - 1)];
+
+    if (rec->nb_fill == 0){ return;}
+    block->nb_sample = rec->nb_fill;
+    block->sequence = head;
+    memset(&block->sample[rec->nb_fill], 0, (PCF8591_FILE_SAMPLES - rec->nb_fill) * sizeof(pcf8591_file_sample_t));
+    atomic_store_explicit(&rec->head, head + 1, memory_order_release);
+    rec->nb_fill = 0;
+}
+
+/**
+ * @brief Append samples to the capture file, without waiting for the disk.
+ * @param rec The recorder.
+ * @param samples Samples, in time order (as given by PCF8591_stream_read()).
+ * @param n Number of samples.
+ * @return Number of samples stored, the others were dropped because the writer thread is late.
+ * @warning Only one thread can write samples.
+ */
+static inline int PCF8591_record_write(pcf8591_recorder_t *rec, const pcf8591_sample_t *samples, int n)
+{
+    int stored = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        size_t head = atomic_load_explicit(&rec->head, memory_order_relaxed);
+        pcf8591_file_block_t *block = &rec->ring[head & (PCF8591_RECORD_RING - 1)];
+
+        /* the block being filled must not be waiting for the writer thread */
+        if (head - atomic_load_explicit(&rec->tail, memory_order_acquire) >= PCF8591_RECORD_RING)
+        {
+            atomic_fetch_add_explicit(&rec->nb_dropped, n - i, memory_order_relaxed);
+            break;
+        }
+
+        if ((rec->nb_fill > 0) && (samples[i].timestamp_ns - block->first_ns >= PCF8591_FILE_SPAN_NS))
+        {
+            PCF8591_record_flush(rec); ///< the 32 bit offset would overflow
+            i--;
+            continue;
+        }
+        if (rec->nb_fill == 0){ block->first_ns = samples[i].timestamp_ns;}
+
+        block->sample[rec->nb_fill++] = (pcf8591_file_sample_t){
+            .offset_ns = samples[i].timestamp_ns - block->first_ns, .channel = samples[i].channel, .data = samples[i].data};
+        stored++;
+        if (rec->nb_fill == PCF8591_FILE_SAMPLES){ PCF8591_record_flush(rec);}
+    }
+    return stored;
+}
+
+/**
+ * @brief Write the last block and the index, then close the capture file.
+ * @param rec The recorder.
+ * @return 1 on success, -1 if a write failed.
+ */
+static inline int PCF8591_record_close(pcf8591_recorder_t *rec)
+{
+    PCF8591_record_flush(rec);
+    atomic_store_explicit(&rec->running, 0, memory_order_release);
+    pthread_join(rec->thread, NULL);
+
+    int result = atomic_load(&rec->error) ? -1 : 1;
+    size_t nb_block = atomic_load(&rec->tail);
+    rec->header.nb_block = nb_block;
+    rec->header.index_offset = PCF8591_FILE_BLOCK * (uint64_t)(1 + nb_block);
+
+    if ((result > 0) && (nb_block > 0))
+    {
+        ssize_t size = nb_block * sizeof(uint64_t);
+        if (pwrite(rec->fd, rec->index, size, rec->header.index_offset) != size){ result = -1;}
+    }
+    if ((result > 0) && (pwrite(rec->fd, &rec->header, sizeof(rec->header), 0) != sizeof(rec->header))){ result = -1;}
+    if (result < 0){ printf("/!\\ Error : cannot finish the capture file.\n");}
+
+    free(rec->index);
+    rec->index = NULL;
+    close(rec->fd);
+    return result;
+}
+
+/**
+ * @brief Return the number of samples dropped because the writer thread was late.
+ * @param rec The recorder.
+ */
+static inline unsigned long PCF8591_record_dropped(pcf8591_recorder_t *rec)
+{
+    return atomic_load_explicit(&rec->nb_dropped, memory_order_relaxed);
+}
+
+/**
+ * @brief Capture file reader.
+ */
+typedef struct
+{
+    const uint8_t *map;                   ///< Whole file, mapped read-only.
+    size_t size;                          ///< Size of the file.
+    const pcf8591_file_header_t *header;  ///< Header, in the mapping.
+    const pcf8591_file_block_t *blocks;   ///< Sample blocks, in the mapping.
+    const uint64_t *index;                ///< Block index, in the mapping (NULL if the file was not closed).
+    uint64_t nb_block;                    ///< Number of complete blocks.
+    uint64_t block;                       ///< Block of the next sample read.
+    uint32_t sample;                      ///< Next sample in the block.
+    pcf8591_t dev;                        ///< Converter settings of the record, for the mV conversion tables.
+} pcf8591_replay_t;
+
+/**
+ * @brief Map a capture file.
+ * @param replay The reader.
+ * @param path Path of the file.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_replay_open(pcf8591_replay_t *replay, const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0){ printf("/!\\ Error : cannot open %s (%s).\n", path, strerror(errno)); return -1;}
+    if ((fstat(fd, &st) < 0) || (st.st_size < PCF8591_FILE_BLOCK)){ printf("/!\\ Error : %s is not a capture file.\n", path); close(fd); return -1;}
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); ///< the mapping keeps the file
+    if (map == MAP_FAILED){ printf("/!\\ Error : cannot map %s (%s).\n", path, strerror(errno)); return -1;}
+
+    replay->map = map;
+    replay->size = st.st_size;
+    replay->header = map;
+    replay->blocks = (const pcf8591_file_block_t *)(replay->map + PCF8591_FILE_BLOCK);
+    if ((memcmp(replay->header->magic, PCF8591_FILE_MAGIC, sizeof(PCF8591_FILE_MAGIC)) != 0) || (replay->header->version != PCF8591_FILE_VERSION)
+        || (replay->header->block_size != PCF8591_FILE_BLOCK))
+    {
+        printf("/!\\ Error : %s is not a capture file.\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    /* a file not closed (crash, power loss) has no index : the complete blocks are still readable.
+       The header is not trusted : never more blocks than the file holds, and the index must lie after them. */
+    uint64_t nb_block_max = replay->size / PCF8591_FILE_BLOCK - 1;
+    uint64_t index_offset = replay->header->index_offset;
+    replay->nb_block = (replay->header->nb_block < nb_block_max) ? replay->header->nb_block : nb_block_max;
+    replay->index = NULL;
+    if ((index_offset != 0) && (index_offset >= PCF8591_FILE_BLOCK * (1 + replay->nb_block)) && (index_offset % sizeof(uint64_t) == 0)
+        && (index_offset <= replay->size) && (replay->nb_block * sizeof(uint64_t) <= replay->size - index_offset))
+    {
+        replay->index = (const uint64_t *)(replay->map + index_offset);
+    }
+    else
+    {
+        replay->nb_block = nb_block_max;
+    }
+    replay->block = 0;
+    replay->sample = 0;
+
+    memset(&replay->dev, 0, sizeof(replay->dev));
+    snprintf(replay->dev.bus, sizeof(replay->dev.bus), "%s", replay->header->bus);
+    replay->dev.fd = -1;
+    replay->dev.address = replay->header->address;
+    replay->dev.mode = replay->header->mode;
+    replay->dev.control = replay->dev.pending = -1;
+    pcf8591_set_vref(&replay->dev, replay->header->vref_mv);
+    return 1;
+}
+
+/**
+ * @brief Unmap a capture file.
+ * @param replay The reader.
+ */
+static inline void PCF8591_replay_close(pcf8591_replay_t *replay)
+{
+    munmap((void *)replay->map, replay->size);
+}
+
+/**
+ * @brief Return a sample block, in place (no copy).
+ * @param replay The reader.
+ * @param block Block number (0 to nb_block - 1).
+ * @return The block, NULL if it does not exist.
+ */
+static inline const pcf8591_file_block_t *PCF8591_replay_block(const pcf8591_replay_t *replay, uint64_t block)
+{
+    return (block < replay->nb_block) ? &replay->blocks[block] : NULL;
+}
+
+/**
+ * @brief Move the reader to the first sample at or after a time.
+ * @param replay The reader.
+ * @param time_ns CLOCK_MONOTONIC time of the record.
+ */
+static inline void PCF8591_replay_seek(pcf8591_replay_t *replay, uint64_t time_ns)
+{
+    /* binary search of the last block starting at or before the time */
+    uint64_t low = 0, high = replay->nb_block;
+    while (high - low > 1)
+    {
+        uint64_t middle = (low + high) / 2;
+        uint64_t first = replay->index ? replay->index[middle] : replay->blocks[middle].first_ns;
+        if (first <= time_ns){ low = middle;}
+        else { high = middle;}
+    }
+    replay->block = low;
+    replay->sample = 0;
+
+    const pcf8591_file_block_t *block = PCF8591_replay_block(replay, low);
+    while ((block != NULL) && (replay->sample < block->nb_sample) && (block->first_ns + block->sample[replay->sample].offset_ns < time_ns))
+    {
+        replay->sample++;
+    }
+}
+
+/**
+ * @brief Read the next samples, as PCF8591_stream_read() gives them for a live acquisition.
+ * @param replay The reader.
+ * @param samples Buffer that will get the samples, oldest first.
+ * @param nb_max Size of the buffer.
+ * @return Number of samples copied (0 at the end of the file).
+ */
+static inline int PCF8591_replay_read(pcf8591_replay_t *replay, pcf8591_sample_t *samples, int nb_max)
+{
+    int nb = 0;
+
+    while ((nb < nb_max) && (replay->block < replay->nb_block))
+    {
+        const pcf8591_file_block_t *block = &replay->blocks[replay->block];
+        while ((nb < nb_max) && (replay->sample < block->nb_sample))
+        {
+            const pcf8591_file_sample_t *sample = &block->sample[replay->sample++];
+            samples[nb++] = (pcf8591_sample_t){.timestamp_ns = block->first_ns + sample->offset_ns, .channel = sample->channel, .data = sample->data};
+        }
+        if (replay->sample >= block->nb_sample)
+        {
+            replay->block++;
+            replay->sample = 0;
+        }
+    }
+    return nb;
+}
+
+/**
+ * @brief Convert replayed samples to mV, with the input mode and Vref of the record.
+ * @param replay The reader.
+ * @param samples Samples read with PCF8591_replay_read().
+ * @param data_mv Buffer that will get the voltages (mV).
+ * @param n Number of samples.
+ */
+static inline void PCF8591_replay_to_mv(const pcf8591_replay_t *replay, const pcf8591_sample_t *samples, int16_t *data_mv, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        data_mv[i] = replay->dev.adc_mv[samples[i].channel & 0x03][samples[i].data];
+    }
+}
+
+#endif
@@ -0,0 +1,295 @@
+/**
+ * @brief Oscilloscope-style triggered capture of the PCF8591 ADC inputs
+
+ * @file PCF8591_scope.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -pthread to the gcc command line.
+ *
+ * A dedicated thread samples all the channels of the active input mode without interruption, with auto-increment
+ * bursts (pcf8591_read_burst()), and keeps the last scans in a ring buffer (pre-trigger memory).
+ * The trigger is evaluated on every scan, in the acquisition thread, with a few comparisons :
+ *  - PCF8591_TRIGGER_RISING / FALLING : edge through the level, re-armed once the signal went back past level -/+ hysteresis.
+ *  - PCF8591_TRIGGER_ABOVE / BELOW : level, armed at the start so it fires as soon as the signal is above / below the
+ *                                    level, then re-armed once the signal went back past level -/+ hysteresis.
+ *  - PCF8591_TRIGGER_WINDOW : fires when the signal leaves [level, high], re-armed once back inside by the hysteresis.
+ *
+ * When the trigger fires, the acquisition goes on until nb_post scans are in the ring, then the pre + post window
+ * is copied in the capture buffer and handed to the consumer (PCF8591_scope_get()). The acquisition thread never
+ * waits for the consumer : while the previous capture has not been read, the trigger is simply not evaluated.
+ *
+ * @warning Don't use the converter from another thread while the capture is running.
+ */
+
+#ifndef PCF8591_SCOPE_H
+#define PCF8591_SCOPE_H
+
+#include "PCF8591.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifndef PCF8591_SCOPE_RING
+#define PCF8591_SCOPE_RING 8192 ///< Scans kept in the pre-trigger ring (power of 2).
+#endif
+#ifndef PCF8591_SCOPE_MAX
+#define PCF8591_SCOPE_MAX 4096 ///< Highest number of scans of a capture (pre + post).
+#endif
+#ifndef PCF8591_SCOPE_BURST
+#define PCF8591_SCOPE_BURST 256 ///< Scans read in one transfer (about 90 ms at 100 kHz with 4 channels).
+#endif
+
+#if (PCF8591_SCOPE_RING & (PCF8591_SCOPE_RING - 1)) != 0
+#error "PCF8591_SCOPE_RING must be a power of 2"
+#endif
+#if PCF8591_SCOPE_RING < PCF8591_SCOPE_MAX + PCF8591_SCOPE_BURST
+#error "PCF8591_SCOPE_RING must hold a whole capture and a burst"
+#endif
+
+/**
+ * @brief Trigger types.
+ */
+typedef enum
+{
+    PCF8591_TRIGGER_RISING,
+    PCF8591_TRIGGER_FALLING,
+    PCF8591_TRIGGER_ABOVE,
+    PCF8591_TRIGGER_BELOW,
+    PCF8591_TRIGGER_WINDOW,
+} pcf8591_trigger_type_t;
+
+/**
+ * @brief Trigger configuration, in ADC codes (-128 to 127 on a differential input).
+ */
+typedef struct
+{
+    pcf8591_trigger_type_t type; ///< Trigger type.
+    uint8_t channel;             ///< Channel of the active mode watched.
+    int16_t level;               ///< Level, or low limit of the window.
+    int16_t high;                ///< High limit of the window (PCF8591_TRIGGER_WINDOW only).
+    int16_t hysteresis;          ///< Distance the signal must go back before the trigger is re-armed.
+} pcf8591_trigger_t;
+
+/**
+ * @brief One frozen capture.
+ */
+typedef struct
+{
+    int nb_input;                                    ///< Channels per scan.
+    int nb_scan;                                     ///< Scans in the capture.
+    int trigger_index;                               ///< Index of the scan that fired the trigger.
+    uint64_t trigger_ns;                             ///< CLOCK_MONOTONIC time of the trigger scan.
+    uint64_t timestamp_ns[PCF8591_SCOPE_MAX];        ///< Time of each scan (interpolated inside a burst).
+    uint8_t data[PCF8591_SCOPE_MAX][PCF8591_NB_CHANNEL]; ///< Data of each scan (two's complement for a differential input).
+} pcf8591_capture_t;
+
+/**
+ * @brief Triggered capture state.
+ */
+typedef struct
+{
+    pcf8591_t *dev;                                      ///< Converter sampled.
+    pcf8591_trigger_t trigger;                           ///< Trigger configuration.
+    int nb_input;                                        ///< Channels of the active mode.
+    int nb_pre;                                          ///< Scans kept before the trigger.
+    int nb_post;                                         ///< Scans kept after the trigger.
+    int single;                                          ///< 1 to stop after the first capture.
+    uint8_t ring[PCF8591_SCOPE_RING][PCF8591_NB_CHANNEL]; ///< Last scans.
+    uint64_t ring_ns[PCF8591_SCOPE_RING];                ///< Time of the last scans.
+    uint8_t burst[PCF8591_BLOCK_MAX];                    ///< Interleaved samples of one burst.
+    pcf8591_capture_t capture;                           ///< Capture handed to the consumer.
+    atomic_int ready;                                    ///< 1 while the capture waits for the consumer.
+    atomic_ullong nb_scan;                               ///< Scans acquired since the start.
+    atomic_ulong nb_trigger;                             ///< Captures made since the start.
+    atomic_int running;                                  ///< 1 while the acquisition thread is running.
+    atomic_int error;                                    ///< 1 if the acquisition stopped on an I2C error.
+    uint64_t start_ns;                                   ///< Start time of the acquisition.
+    pthread_t thread;                                    ///< Acquisition thread.
+} pcf8591_scope_t;
+
+/**
+ * @brief Trigger state machine, evaluated on every scan.
+ * @param trigger The trigger configuration.
+ * @param armed Arming state, updated.
+ * @param value Value of the watched channel.
+ * @return 1 if the trigger fires on this scan.
+ */
+static inline int PCF8591_scope_evaluate(const pcf8591_trigger_t *trigger, int *armed, int value)
+{
+    switch (trigger->type)
+    {
+        case PCF8591_TRIGGER_RISING :
+            if (value <= trigger->level - trigger->hysteresis){ *armed = 1;}
+            else if (*armed && (value >= trigger->level)){ *armed = 0; return 1;}
+            return 0;
+        case PCF8591_TRIGGER_FALLING :
+            if (value >= trigger->level + trigger->hysteresis){ *armed = 1;}
+            else if (*armed && (value <= trigger->level)){ *armed = 0; return 1;}
+            return 0;
+        case PCF8591_TRIGGER_ABOVE :
+            if (value <= trigger->level - trigger->hysteresis){ *armed = 1;}
+            else if (*armed && (value >= trigger->level)){ *armed = 0; return 1;}
+            return 0;
+        case PCF8591_TRIGGER_BELOW :
+            if (value >= trigger->level + trigger->hysteresis){ *armed = 1;}
+            else if (*armed && (value <= trigger->level)){ *armed = 0; return 1;}
+            return 0;
+        case PCF8591_TRIGGER_WINDOW :
+            if ((value >= trigger->level + trigger->hysteresis) && (value <= trigger->high - trigger->hysteresis)){ *armed = 1;}
+            else if (*armed && ((value < trigger->level) || (value > trigger->high))){ *armed = 0; return 1;}
+            return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Acquisition thread : sample continuously, evaluate the trigger and freeze the captures.
+ * @param arg The capture.
+ * @return NULL.
+ */
+static inline void *PCF8591_scope_thread(void *arg)
+{
+    pcf8591_scope_t *scope = arg;
+    int nb_input = scope->nb_input;
+    int channel = scope->trigger.channel;
+    int differential = pcf8591_is_differential(scope->dev->mode, channel);
+    uint64_t position = 0;   ///< scans written in the ring
+    uint64_t armed_at = 0;   ///< first scan of the current pre-trigger memory
+    uint64_t fired_at = 0;   ///< scan that fired the trigger
+    int fired = 0;
+    int armed = (scope->trigger.type == PCF8591_TRIGGER_ABOVE) || (scope->trigger.type == PCF8591_TRIGGER_BELOW); ///< a level trigger doesn't wait for an edge
+
+    while (atomic_load_explicit(&scope->running, memory_order_relaxed))
+    {
+        uint64_t start = PCF8591_time_ns();
+        if (pcf8591_read_burst(scope->dev, scope->burst, PCF8591_SCOPE_BURST) < 0)
+        {
+            atomic_store(&scope->error, 1);
+            break;
+        }
+        uint64_t end = PCF8591_time_ns();
+        int waiting = atomic_load_explicit(&scope->ready, memory_order_acquire); ///< capture not read yet
+
+        for (int i = 0; i < PCF8591_SCOPE_BURST; i++, position++)
+        {
+            uint8_t *scan = scope->ring[position & (PCF8591_SCOPE_RING - 1)];
+            memcpy(scan, scope->burst + i * nb_input, nb_input);
+            scope->ring_ns[position & (PCF8591_SCOPE_RING - 1)] = start + (end - start) * (i + 1) / PCF8591_SCOPE_BURST;
+
+            if (waiting){ armed_at = position + 1; continue;} ///< the pre-trigger memory restarts once the capture is read
+
+            if (!fired)
+            {
+                if (position - armed_at < (uint64_t)scope->nb_pre){ continue;} ///< pre-trigger memory not full yet
+                int value = differential ? (int8_t)scan[channel] : scan[channel];
+                if (PCF8591_scope_evaluate(&scope->trigger, &armed, value)){ fired = 1; fired_at = position;}
+            }
+            if (fired && (position - fired_at == (uint64_t)scope->nb_post))
+            {
+                /* freeze the window : nb_pre scans before the trigger, the trigger scan and nb_post - 1 after */
+                pcf8591_capture_t *capture = &scope->capture;
+                uint64_t first = fired_at - scope->nb_pre;
+                capture->nb_input = nb_input;
+                capture->nb_scan = scope->nb_pre + scope->nb_post;
+                capture->trigger_index = scope->nb_pre;
+                capture->trigger_ns = scope->ring_ns[fired_at & (PCF8591_SCOPE_RING - 1)];
+                for (int k = 0; k < capture->nb_scan; k++)
+                {
+                    memcpy(capture->data[k], scope->ring[(first + k) & (PCF8591_SCOPE_RING - 1)], PCF8591_NB_CHANNEL);
+                    capture->timestamp_ns[k] = scope->ring_ns[(first + k) & (PCF8591_SCOPE_RING - 1)];
+                }
+                atomic_store_explicit(&scope->ready, 1, memory_order_release);
+                atomic_fetch_add_explicit(&scope->nb_trigger, 1, memory_order_relaxed);
+                waiting = 1;
+                fired = 0;
+                armed = 0;
+                if (scope->single){ atomic_store(&scope->running, 0);}
+            }
+        }
+        atomic_fetch_add_explicit(&scope->nb_scan, PCF8591_SCOPE_BURST, memory_order_relaxed);
+    }
+    atomic_store(&scope->running, 0);
+    return NULL;
+}
+
+/**
+ * @brief Start the triggered capture.
+ * @param scope The capture.
+ * @param dev The converter (opened with pcf8591_open(), input mode already selected).
+ * @param trigger Trigger configuration.
+ * @param nb_pre Scans kept before the trigger.
+ * @param nb_post Scans kept from the trigger on (at least 1, nb_pre + nb_post up to PCF8591_SCOPE_MAX).
+ * @param single 1 to stop after the first capture, 0 to re-arm after each capture is read.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_scope_start(pcf8591_scope_t *scope, pcf8591_t *dev, const pcf8591_trigger_t *trigger, int nb_pre, int nb_post, int single)
+{
+    if ((nb_pre < 0) | (nb_post < 1) | (nb_pre + nb_post > PCF8591_SCOPE_MAX)){ printf("/!\\ Error : capture length not suported.\n"); return -1;}
+    if (pcf8591_control(dev, trigger->channel) < 0){ return -1;}
+
+    scope->dev = dev;
+    scope->trigger = *trigger;
+    scope->nb_input = pcf8591_nb_input(dev->mode);
+    scope->nb_pre = nb_pre;
+    scope->nb_post = nb_post;
+    scope->single = single;
+    scope->start_ns = PCF8591_time_ns();
+    atomic_init(&scope->ready, 0);
+    atomic_init(&scope->nb_scan, 0);
+    atomic_init(&scope->nb_trigger, 0);
+    atomic_init(&scope->running, 1);
+    atomic_init(&scope->error, 0);
+
+    if (pthread_create(&scope->thread, NULL, PCF8591_scope_thread, scope) != 0)
+    {
+        printf("/!\\ Error : cannot start the acquisition thread.\n");
+        atomic_store(&scope->running, 0);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stop the acquisition thread. A capture already frozen can still be read.
+ * @param scope The capture.
+ */
+static inline void PCF8591_scope_stop(pcf8591_scope_t *scope)
+{
+    atomic_store(&scope->running, 0);
+    pthread_join(scope->thread, NULL);
+}
+
+/**
+ * @brief Take the last capture, and re-arm the trigger.
+ * @param scope The capture.
+ * @param capture Structure that will get the capture.
+ * @return 1 if a capture was copied, 0 if no trigger happened since the last call.
+ */
+static inline int PCF8591_scope_get(pcf8591_scope_t *scope, pcf8591_capture_t *capture)
+{
+    if (!atomic_load_explicit(&scope->ready, memory_order_acquire)){ return 0;}
+
+    capture->nb_input = scope->capture.nb_input;
+    capture->nb_scan = scope->capture.nb_scan;
+    capture->trigger_index = scope->capture.trigger_index;
+    capture->trigger_ns = scope->capture.trigger_ns;
+    memcpy(capture->timestamp_ns, scope->capture.timestamp_ns, capture->nb_scan * sizeof(uint64_t));
+    memcpy(capture->data, scope->capture.data, capture->nb_scan * PCF8591_NB_CHANNEL);
+    atomic_store_explicit(&scope->ready, 0, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Return the achieved scan rate since the start of the acquisition.
+ * @param scope The capture.
+ * @return Scans per second (each scan holds all the channels of the mode).
+ */
+static inline double PCF8591_scope_rate(pcf8591_scope_t *scope)
+{
+    uint64_t elapsed = PCF8591_time_ns() - scope->start_ns;
+    return elapsed ? atomic_load_explicit(&scope->nb_scan, memory_order_relaxed) * 1e9 / elapsed : 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @brief This program checks the pipelined channel sequencer (PCF8591_sequence_read()) against the simulated PCF8591
+ *        of i2c_sim.h, which returns the conversion started by the previous byte read like the real converter.
+
+ * @file PCF8591_sequence_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -I../../i2c -o PCF8591_sequence_test PCF8591_sequence_test.c PCF8591.c ../../i2c/i2c_bus.c -pthread -lm
+ *
+ * Each input pin has its own voltage, so every channel of every input mode has its own code. For the four input
+ * modes, the sequencer plays several schedules (all the channels of the mode, repeated and unordered channels, one
+ * channel) in calls of various sizes, so the schedule wraps around inside a call and between two calls. Every sample
+ * must carry the channel of the schedule and the code of that channel.
+ *
+ * The program returns 0 when every sample is right, 1 otherwise.
+ */
+
+/* Library */
+#include "i2c_sim.h"
+#include "PCF8591.h"
+
+/* Voltage on A0, A1, A2 and A3 (mV) : distinct codes, differential inputs of both signs */
+static const int pin_mv[PCF8591_NB_CHANNEL] = {300, 1100, 2000, 1500};
+
+static i2c_sim_board_t board;
+static int nb_error = 0;
+
+/**
+ * @brief Return the code the PCF8591 gives for a channel of an input mode.
+ * @param mode Input mode (PCF8591_MODE_xxx).
+ * @param channel Channel of the mode.
+ * @return 8 bit code (two's complement for a differential input).
+ */
+uint8_t expected_code(uint8_t mode, uint8_t channel)
+{
+    int mv;
+    switch (mode)
+    {
+        case PCF8591_MODE_SINGLE : return lround(pin_mv[channel] * 255.0 / Vref);
+        case PCF8591_MODE_DIFF3 : mv = pin_mv[channel] - pin_mv[3]; break;
+        case PCF8591_MODE_MIXED : if (channel < 2){ return lround(pin_mv[channel] * 255.0 / Vref);} mv = pin_mv[2] - pin_mv[3]; break;
+        default : mv = (channel == 0) ? pin_mv[0] - pin_mv[1] : pin_mv[2] - pin_mv[3]; break;
+    }
+    return (uint8_t)(int8_t)lround(mv * 255.0 / Vref);
+}
+
+/**
+ * @brief Play a schedule in calls of the given sizes and check every sample.
+ * @param name Name of the case.
+ * @param mode Input mode.
+ * @param channels Schedule, NULL for all the channels of the mode.
+ * @param nb_channel Length of the schedule.
+ * @param calls Number of samples of each call, ended by 0.
+ */
+void check_sequence(const char *name, uint8_t mode, const uint8_t *channels, int nb_channel, const int *calls)
+{
+    pcf8591_sequence_t seq;
+    uint8_t channel[64], data[64];
+    int position = 0, nb_bad = 0, nb_sample = 0;
+
+    if (pcf8591_set_mode(&pcf8591_default, mode) < 0){ printf("FAIL %s : cannot set the mode\n", name); nb_error++; return;}
+    if (PCF8591_sequence_init(&seq, &pcf8591_default, channels, nb_channel) < 0){ printf("FAIL %s : bad schedule\n", name); nb_error++; return;}
+
+    for (const int *n = calls; *n > 0; n++)
+    {
+        if (PCF8591_sequence_read(&seq, channel, data, *n) != *n){ printf("FAIL %s : transfer failed\n", name); nb_error++; return;}
+        for (int i = 0; i < *n; i++, position++)
+        {
+            uint8_t want = seq.channel[position % seq.nb_channel];
+            if ((channel[i] != want) || (data[i] != expected_code(mode, want)))
+            {
+                if (nb_bad++ < 4){ printf("     %s sample %d : channel %d data %d, expected channel %d data %d\n", name, position, channel[i], data[i], want, expected_code(mode, want));}
+            }
+        }
+        nb_sample += *n;
+    }
+    printf("%s %-28s %3d samples\n", nb_bad ? "FAIL" : "ok  ", name, nb_sample);
+    if (nb_bad){ nb_error++;}
+}
+
+int main(void)
+{
+    static const uint8_t reorder[] = {2, 0, 0, 1};     ///< unordered, repeated channel
+    static const uint8_t repeat[] = {1, 1, 1};         ///< same control byte again and again
+    static const uint8_t single[] = {0};               ///< one channel : byte reads only
+    static const uint8_t pair[] = {1, 0};              ///< two channels of every mode
+    static const int one_scan[] = {4, 0};
+    static const int wrap[] = {3, 1, 6, 5, 7, 0};      ///< the schedule wraps inside and between the calls
+    static const int single_steps[] = {1, 1, 1, 2, 9, 1, 0};
+    static const struct { const char *name; uint8_t mode; } modes[] = {
+        {"single", PCF8591_MODE_SINGLE}, {"diff3", PCF8591_MODE_DIFF3}, {"mixed", PCF8591_MODE_MIXED}, {"diff2", PCF8591_MODE_DIFF2}};
+    char name[64];
+
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ board.pcf8591.input_mv[i] = pin_mv[i];}
+    PCF8591_i2c_connect();
+
+    for (int m = 0; m < 4; m++)
+    {
+        snprintf(name, sizeof(name), "%s all, one scan", modes[m].name);
+        check_sequence(name, modes[m].mode, NULL, 0, one_scan);
+        snprintf(name, sizeof(name), "%s all, wrap-around", modes[m].name);
+        check_sequence(name, modes[m].mode, NULL, 0, wrap);
+        snprintf(name, sizeof(name), "%s 1 0, wrap-around", modes[m].name);
+        check_sequence(name, modes[m].mode, pair, 2, wrap);
+        snprintf(name, sizeof(name), "%s 0 alone", modes[m].name);
+        check_sequence(name, modes[m].mode, single, 1, single_steps);
+        if (pcf8591_nb_input(modes[m].mode) > 2)
+        {
+            snprintf(name, sizeof(name), "%s 2 0 0 1", modes[m].name);
+            check_sequence(name, modes[m].mode, reorder, 4, wrap);
+            snprintf(name, sizeof(name), "%s 1 1 1", modes[m].name);
+            check_sequence(name, modes[m].mode, repeat, 3, single_steps);
+        }
+    }
+
+    printf("%s : %d failed case(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @brief Continuous acquisition of the PCF8591 ADC inputs in a background thread
+
+ * @file PCF8591_stream.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -pthread to the gcc command line.
+ *
+ * A dedicated thread samples the configured channels with the pipelined sequencer of PCF8591.h,
+ * as fast as the bus allows or at a fixed scan rate, and pushes timestamped samples in a
+ * single-producer / single-consumer lock-free ring buffer. The consumer drains the ring by batches
+ * with PCF8591_stream_read(), at its own pace.
+ *
+ * At a fixed scan rate, the pipeline is restarted after each sleep (one throw-away byte), otherwise the first sample
+ * of a scan would be the conversion started at the end of the previous scan, one period old. Each sample is stamped
+ * with the start of its conversion (the end of the transfer before the one that returns it).
+ *
+ * When the consumer is too slow and the ring is full, the new samples are dropped and counted as overruns:
+ * the acquisition thread never waits for the consumer.
+ *
+ * @warning Don't use the other read functions on the same converter while a stream is running, they share the same conversion pipeline.
+ */
+
+#ifndef PCF8591_STREAM_H
+#define PCF8591_STREAM_H
+
+#include "PCF8591.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifndef PCF8591_STREAM_SIZE
+#define PCF8591_STREAM_SIZE 4096 ///< Number of samples in the ring buffer (power of 2).
+#endif
+
+#if (PCF8591_STREAM_SIZE & (PCF8591_STREAM_SIZE - 1)) != 0
+#error "PCF8591_STREAM_SIZE must be a power of 2"
+#endif
+
+/**
+ * @brief One timestamped ADC sample.
+ */
+typedef struct
+{
+    uint64_t timestamp_ns; ///< CLOCK_MONOTONIC time at which the conversion was started, in ns.
+    uint8_t channel;       ///< ADC input (0 / 1 / 2 / 3).
+    uint8_t data;          ///< 8 bit data of the input (two's complement for a differential input).
+} pcf8591_sample_t;
+
+/**
+ * @brief Acquisition stream : ring buffer, sequencer and acquisition thread.
+ */
+typedef struct
+{
+    pcf8591_sample_t ring[PCF8591_STREAM_SIZE]; ///< Samples waiting for the consumer.
+    _Alignas(64) atomic_size_t head;            ///< Next slot written by the acquisition thread.
+    _Alignas(64) atomic_size_t tail;            ///< Next slot read by the consumer.
+    _Alignas(64) atomic_ulong nb_overrun;       ///< Samples dropped because the ring was full.
+    atomic_ulong nb_sample;                     ///< Samples acquired since the start.
+    atomic_int running;                         ///< 1 while the acquisition thread is running.
+    atomic_int error;                           ///< 1 if the acquisition stopped on an I2C error.
+    pcf8591_sequence_t sequence;                ///< Channel schedule.
+    unsigned int scan_rate_hz;                  ///< Scans of the schedule per second, 0 = as fast as the bus allows.
+    uint64_t start_ns;                          ///< Start time of the acquisition.
+    atomic_ullong stop_ns;                      ///< Stop time of the acquisition (0 while running).
+    pthread_t thread;                           ///< Acquisition thread.
+} pcf8591_stream_t;
+
+/**
+ * @brief Acquisition thread : sample the schedule and push the samples in the ring.
+ * @param arg The stream.
+ * @return NULL.
+ */
+static inline void *PCF8591_stream_thread(void *arg)
+{
+    pcf8591_stream_t *stream = arg;
+    uint64_t period_ns = stream->scan_rate_hz ? 1000000000ull / stream->scan_rate_hz : 0;
+    uint64_t deadline = PCF8591_time_ns();
+    uint64_t transfer_end = 0; ///< end of the last transfer : start of the pending conversion
+
+    while (atomic_load_explicit(&stream->running, memory_order_relaxed))
+    {
+        for (int i = 0; i < stream->sequence.nb_channel; i++)
+        {
+            pcf8591_sample_t sample;
+            sample.timestamp_ns = stream->sequence.primed ? transfer_end : PCF8591_time_ns(); ///< not primed : started by the call
+            if (PCF8591_sequence_read(&stream->sequence, &sample.channel, &sample.data, 1) < 0)
+            {
+                atomic_store(&stream->error, 1);
+                atomic_store(&stream->running, 0);
+                break;
+            }
+            transfer_end = PCF8591_time_ns();
+
+            /* single producer : only this thread writes head, the consumer only writes tail */
+            size_t head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+            size_t tail = atomic_load_explicit(&stream->tail, memory_order_acquire);
+            if (head - tail >= PCF8591_STREAM_SIZE)
+            {
+                atomic_fetch_add_explicit(&stream->nb_overrun, 1, memory_order_relaxed);
+            }
+            else
+            {
+                stream->ring[head & (PCF8591_STREAM_SIZE - 1)] = sample;
+                atomic_store_explicit(&stream->head, head + 1, memory_order_release);
+            }
+            atomic_fetch_add_explicit(&stream->nb_sample, 1, memory_order_relaxed);
+        }
+
+        if (period_ns)
+        {
+            /* absolute deadline : the transfer time does not add up from one scan to the next */
+            deadline += period_ns;
+            PCF8591_sleep_until(deadline);
+            stream->sequence.primed = 0; ///< the pending conversion is one period old : start a new one
+        }
+    }
+    atomic_store(&stream->stop_ns, PCF8591_time_ns());
+    return NULL;
+}
+
+/**
+ * @brief Start the continuous acquisition of a channel schedule.
+ * @param stream The stream to start.
+ * @param dev The converter to sample (opened with pcf8591_open()).
+ * @param channels List of the channels to sample (0 / 1 / 2 / 3 in the input mode of the converter). NULL for all the channels of the mode.
+ * @param nb_channel Number of channels in the list.
+ * @param scan_rate_hz Scans of the whole list per second, 0 to sample as fast as the bus allows.
+ * @return 1 on success, -1 on error.
+ */
+static inline int PCF8591_stream_start(pcf8591_stream_t *stream, pcf8591_t *dev, const uint8_t *channels, int nb_channel, unsigned int scan_rate_hz)
+{
+    if (PCF8591_sequence_init(&stream->sequence, dev, channels, nb_channel) < 0){return -1;}
+
+    atomic_init(&stream->head, 0);
+    atomic_init(&stream->tail, 0);
+    atomic_init(&stream->nb_overrun, 0);
+    atomic_init(&stream->nb_sample, 0);
+    atomic_init(&stream->running, 1);
+    atomic_init(&stream->error, 0);
+    stream->scan_rate_hz = scan_rate_hz;
+    stream->start_ns = PCF8591_time_ns();
+    atomic_init(&stream->stop_ns, 0);
+
+    if (pthread_create(&stream->thread, NULL, PCF8591_stream_thread, stream) != 0)
+    {
+        printf("/!\\ Error : cannot start the acquisition thread.\n");
+        atomic_store(&stream->running, 0);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stop the acquisition thread. The samples still in the ring can be read afterwards.
+ * @param stream The stream to stop.
+ */
+static inline void PCF8591_stream_stop(pcf8591_stream_t *stream)
+{
+    atomic_store(&stream->running, 0);
+    pthread_join(stream->thread, NULL);
+}
+
+/**
+ * @brief Drain a batch of samples from the ring.
+ * @param stream The running or stopped stream.
+ * @param samples Buffer that will get the samples, oldest first.
+ * @param nb_max Size of the buffer.
+ * @return Number of samples copied (0 if the ring is empty).
+ * @warning Only one thread can read a stream.
+ */
+static inline int PCF8591_stream_read(pcf8591_stream_t *stream, pcf8591_sample_t *samples, int nb_max)
+{
+    size_t tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&stream->head, memory_order_acquire);
+    size_t nb = head - tail;
+
+    if (nb > (size_t)nb_max){ nb = nb_max;}
+    for (size_t i = 0; i < nb; i++)
+    {
+        samples[i] = stream->ring[(tail + i) & (PCF8591_STREAM_SIZE - 1)];
+    }
+    atomic_store_explicit(&stream->tail, tail + nb, memory_order_release);
+    return nb;
+}
+
+/**
+ * @brief Convert a batch of samples to mV with the conversion tables of the converter.
+ * @param stream The stream the samples were read from.
+ * @param samples Samples drained by PCF8591_stream_read().
+ * @param data_mv Buffer that will get the voltage of each sample in mV.
+ * @param n Number of samples.
+ */
+static inline void PCF8591_stream_to_mv(const pcf8591_stream_t *stream, const pcf8591_sample_t *samples, int16_t *data_mv, int n)
+{
+    const pcf8591_t *dev = stream->sequence.dev;
+    for (int i = 0; i < n; i++)
+    {
+        data_mv[i] = dev->adc_mv[samples[i].channel & 0x03][samples[i].data];
+    }
+}
+
+/**
+ * @brief Return the number of samples dropped because the ring was full.
+ * @param stream The stream.
+ */
+static inline unsigned long PCF8591_stream_overrun(pcf8591_stream_t *stream)
+{
+    return atomic_load_explicit(&stream->nb_overrun, memory_order_relaxed);
+}
+
+/**
+ * @brief Return the achieved sample rate since the start of the acquisition.
+ * @param stream The stream.
+ * @return Samples per second (all channels together).
+ */
+static inline double PCF8591_stream_rate(pcf8591_stream_t *stream)
+{
+    uint64_t end = atomic_load(&stream->stop_ns);
+    if (end == 0){ end = PCF8591_time_ns();}
+    if (end <= stream->start_ns){ return 0;}
+    return atomic_load_explicit(&stream->nb_sample, memory_order_relaxed) * 1e9 / (end - stream->start_ns);
+}
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @brief Waveform generator for the PCF8591 DAC output (wavetable + direct digital synthesis)
+
+ * @file PCF8591_wave.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4, DAC/ADC PCF8591
+ * compilation : add -lm to the gcc command line.
+ *
+ * One period of the waveform is precomputed in a 256 entries table of DAC codes (sine, triangle, saw,
+ * square with duty cycle or any user table). A 32 bit phase accumulator walks through the table :
+ * every sample adds the tuning word (frequency * 2^32 / sample rate) to the phase and the 8 upper bits
+ * of the phase give the table index, so the frequency resolution is sample rate / 2^32.
+ *
+ * The samples are sent by blocks with pcf8591_write_block() and every block is released on an absolute
+ * CLOCK_MONOTONIC deadline, so the output frequency does not drift with the transfer and wakeup times.
+ *  - block_size = 1 : one DAC write per sample, for sample rates well below the bus rate.
+ *  - block_size > 1 : the samples of a block leave at the bus rate, in bulk pieces of PCF8591_BULK_CHUNK samples, so
+ *                     set the sample rate a little below PCF8591_BUS_SAMPLE_RATE to leave room for the address and the
+ *                     control byte of every piece, the gap between pieces and the real-time accesses going between them.
+ */
+
+#ifndef PCF8591_WAVE_H
+#define PCF8591_WAVE_H
+
+#include "PCF8591.h"
+
+#ifndef PCF8591_I2C_CLOCK
+#define PCF8591_I2C_CLOCK 100000 ///< I2C bus clock (Hz), 100 kHz by default on the Rpi.
+#endif
+
+#define PCF8591_BUS_SAMPLE_RATE (PCF8591_I2C_CLOCK / 9.0) ///< DAC samples per second in a block transfer (8 data bits + ACK).
+#define PCF8591_WAVE_SIZE 256 ///< Number of entries of a wavetable.
+
+/**
+ * @brief Predefined waveforms.
+ */
+typedef enum
+{
+    PCF8591_WAVE_SINE,
+    PCF8591_WAVE_TRIANGLE,
+    PCF8591_WAVE_SAW,
+    PCF8591_WAVE_SQUARE,
+} pcf8591_waveform_t;
+
+/**
+ * @brief Waveform generator state.
+ */
+typedef struct
+{
+    pcf8591_t *dev;                   ///< Converter driven.
+    uint8_t table[PCF8591_WAVE_SIZE]; ///< One period of the waveform, in DAC codes.
+    uint32_t phase;                   ///< Phase accumulator, the 8 upper bits index the table.
+    uint32_t tuning;                  ///< Phase increment per sample.
+    double sample_rate;               ///< Nominal sample rate (Hz).
+    size_t block_size;                ///< Samples sent in one pcf8591_write_block().
+    uint64_t start_ns;                ///< Time of the first block (0 before the first run).
+    uint64_t deadline_ns;             ///< Release time of the next block.
+    uint64_t nb_sample;               ///< Samples output since the start.
+    uint64_t nb_late;                 ///< Blocks released more than one block period after their deadline.
+    int64_t max_late_ns;              ///< Worst release delay.
+    int64_t sum_late_ns;              ///< Sum of the release delays (for the mean).
+    uint64_t nb_block;                ///< Blocks output since the start.
+} pcf8591_wave_t;
+
+/**
+ * @brief Initialise a waveform generator.
+ * @param wave The generator.
+ * @param dev The converter to drive (opened with pcf8591_open()).
+ * @param sample_rate Nominal sample rate (Hz).
+ * @param block_size Samples sent in one pcf8591_write_block() (1 to PCF8591_BLOCK_MAX - 1).
+ * @return 1 on success, -1 on bad argument.
+ */
+static inline int PCF8591_wave_init(pcf8591_wave_t *wave, pcf8591_t *dev, double sample_rate, size_t block_size)
+{
+    if ((sample_rate <= 0) | (block_size < 1) | (block_size > PCF8591_BLOCK_MAX - 1)){ printf("/!\\ Error : bad waveform sample rate or block size.\n"); return -1;}
+
+    memset(wave, 0, sizeof(*wave));
+    wave->dev = dev;
+    wave->sample_rate = sample_rate;
+    wave->block_size = block_size;
+    return 1;
+}
+
+/**
+ * @brief Return the normalised value of a predefined waveform.
+ * @param waveform PCF8591_WAVE_SINE / PCF8591_WAVE_TRIANGLE / PCF8591_WAVE_SAW / PCF8591_WAVE_SQUARE.
+ * @param i Entry of the wavetable (0 to PCF8591_WAVE_SIZE - 1).
+ * @param duty Duty cycle of the square waveform in % (ignored for the others).
+ * @return Value between 0 and 1.
+ */
+static inline double PCF8591_wave_shape(pcf8591_waveform_t waveform, int i, int duty)
+{
+    double x = (double)i / PCF8591_WAVE_SIZE; ///< position in the period, 0 to 1
+    switch (waveform)
+    {
+        case PCF8591_WAVE_SINE :
+            return 0.5 + 0.5 * sin(2 * M_PI * x);
+        case PCF8591_WAVE_TRIANGLE :
+            return (x < 0.5) ? 2 * x : 2 - 2 * x;
+        case PCF8591_WAVE_SAW :
+            return x;
+        case PCF8591_WAVE_SQUARE :
+            return (i * 100 < duty * PCF8591_WAVE_SIZE) ? 1 : 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill the wavetable with a predefined waveform.
+ * @param wave The generator.
+ * @param waveform PCF8591_WAVE_SINE / PCF8591_WAVE_TRIANGLE / PCF8591_WAVE_SAW / PCF8591_WAVE_SQUARE.
+ * @param low Lowest DAC code of the waveform.
+ * @param high Highest DAC code of the waveform.
+ * @param duty Duty cycle of the square waveform in % (ignored for the others).
+ */
+static inline void PCF8591_wave_table(pcf8591_wave_t *wave, pcf8591_waveform_t waveform, uint8_t low, uint8_t high, int duty)
+{
+    double amplitude = high - low;
+
+    for (int i = 0; i < PCF8591_WAVE_SIZE; i++)
+    {
+        wave->table[i] = (uint8_t)(low + lround(PCF8591_wave_shape(waveform, i, duty) * amplitude));
+    }
+}
+
+/**
+ * @brief Fill the wavetable with a predefined waveform given in mV.
+ * The voltages are converted once with the DAC table of the converter, so the output costs nothing more per sample.
+ * @param wave The generator.
+ * @param waveform PCF8591_WAVE_SINE / PCF8591_WAVE_TRIANGLE / PCF8591_WAVE_SAW / PCF8591_WAVE_SQUARE.
+ * @param low_mv Lowest voltage of the waveform (mV).
+ * @param high_mv Highest voltage of the waveform (mV).
+ * @param duty Duty cycle of the square waveform in % (ignored for the others).
+ */
+static inline void PCF8591_wave_table_mv(pcf8591_wave_t *wave, pcf8591_waveform_t waveform, int low_mv, int high_mv, int duty)
+{
+    for (int i = 0; i < PCF8591_WAVE_SIZE; i++)
+    {
+        wave->table[i] = pcf8591_mv_to_data(wave->dev, low_mv + lround(PCF8591_wave_shape(waveform, i, duty) * (high_mv - low_mv)));
+    }
+}
+
+/**
+ * @brief Load a user defined period in the wavetable.
+ * @param wave The generator.
+ * @param table One period of the waveform, 256 DAC codes.
+ */
+static inline void PCF8591_wave_arbitrary(pcf8591_wave_t *wave, const uint8_t table[PCF8591_WAVE_SIZE])
+{
+    memcpy(wave->table, table, PCF8591_WAVE_SIZE);
+}
+
+/**
+ * @brief Set the output frequency.
+ * @param wave The generator.
+ * @param frequency Requested frequency (Hz), from 0 to less than half the sample rate (above, the samples alias it).
+ * @return Frequency really synthesised after the quantisation of the tuning word (Hz), -1 on bad frequency.
+ */
+static inline double PCF8591_wave_set_frequency(pcf8591_wave_t *wave, double frequency)
+{
+    if (!((frequency >= 0) && (frequency < wave->sample_rate / 2))){ printf("/!\\ Error : waveform frequency %.3f Hz not below half the sample rate.\n", frequency); return -1;}
+    wave->tuning = (uint32_t)llround(frequency * 4294967296.0 / wave->sample_rate);
+    return wave->tuning * wave->sample_rate / 4294967296.0;
+}
+
+/**
+ * @brief Compute the next samples of the waveform.
+ * @param wave The generator.
+ * @param samples Buffer that will get the DAC codes.
+ * @param n Number of samples.
+ */
+static inline void PCF8591_wave_fill(pcf8591_wave_t *wave, uint8_t *samples, size_t n)
+{
+    uint32_t phase = wave->phase;
+    for (size_t i = 0; i < n; i++)
+    {
+        samples[i] = wave->table[phase >> 24];
+        phase += wave->tuning;
+    }
+    wave->phase = phase;
+}
+
+/**
+ * @brief Output samples on the DAC, block by block, on absolute deadlines.
+ * Consecutive calls continue the same timeline, so the waveform can be output in slices.
+ * @param wave The generator.
+ * @param nb_sample Number of samples to output (rounded up to a whole number of blocks).
+ * @return 1 on success, -1 if a transfer failed.
+ */
+static inline int PCF8591_wave_run(pcf8591_wave_t *wave, uint64_t nb_sample)
+{
+    uint8_t block[PCF8591_BLOCK_MAX];
+    uint64_t block_ns = (uint64_t)llround(wave->block_size * 1e9 / wave->sample_rate);
+
+    if (wave->start_ns == 0)
+    {
+        wave->start_ns = PCF8591_time_ns();
+        wave->deadline_ns = wave->start_ns;
+    }
+
+    for (uint64_t done = 0; done < nb_sample; done += wave->block_size)
+    {
+        PCF8591_wave_fill(wave, block, wave->block_size); ///< computed before the deadline
+        PCF8591_sleep_until(wave->deadline_ns);
+
+        int64_t late = (int64_t)(PCF8591_time_ns() - wave->deadline_ns);
+        if (late > 0)
+        {
+            wave->sum_late_ns += late;
+            if (late > wave->max_late_ns){ wave->max_late_ns = late;}
+            if (late > (int64_t)block_ns){ wave->nb_late++;}
+        }
+
+        if (pcf8591_write_block(wave->dev, block, wave->block_size) < 0){return -1;}
+        wave->nb_sample += wave->block_size;
+        wave->nb_block++;
+        wave->deadline_ns += block_ns;
+    }
+    return 1;
+}
+
+/**
+ * @brief Return the measured sample rate since the first block.
+ * @param wave The generator.
+ */
+static inline double PCF8591_wave_rate(const pcf8591_wave_t *wave)
+{
+    uint64_t elapsed = PCF8591_time_ns() - wave->start_ns;
+    if ((wave->start_ns == 0) | (elapsed == 0)){ return 0;}
+    return wave->nb_sample * 1e9 / elapsed;
+}
+
+/**
+ * @brief Return the effective output frequency since the first block : the tuning word applied to the measured sample
+ *        rate (PCF8591_wave_rate()). It is computed, not measured on the output.
+ * @param wave The generator.
+ */
+static inline double PCF8591_wave_frequency(const pcf8591_wave_t *wave)
+{
+    return wave->tuning * PCF8591_wave_rate(wave) / 4294967296.0;
+}
+
+/**
+ * @brief Display the requested, synthesised and effective frequencies and the timing error of the block releases.
+ * @param wave The generator.
+ * @param frequency Requested frequency (Hz).
+ */
+static inline void PCF8591_wave_report(const pcf8591_wave_t *wave, double frequency)
+{
+    double effective = PCF8591_wave_frequency(wave);
+    printf("Waveform : requested %.3f Hz, synthesised %.3f Hz, effective %.3f Hz at the measured rate (error %+.3f %%)\n",
+           frequency, wave->tuning * wave->sample_rate / 4294967296.0, effective, 100 * (effective - frequency) / frequency);
+    printf("> %.0f samples/s, release delay mean %.1f us max %.1f us, %llu blocks more than one block late\n",
+           PCF8591_wave_rate(wave), wave->nb_block ? wave->sum_late_ns / 1e3 / wave->nb_block : 0,
+           wave->max_late_ns / 1e3, (unsigned long long)wave->nb_late);
+}
+
+#endif
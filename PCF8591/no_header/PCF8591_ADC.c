@@ -87,6 +87,7 @@
 #include <sys/ioctl.h>
 #include <stdint.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 #include <math.h>
  
 #define PCF8591_I2C_ADDR 0x48 ///< PCF8591 i2c address
@@ -98,7 +99,7 @@
 /* Fonctions */
 unsigned short int PCF8591_read_voltage_mv(uint8_t channel);
 void PCF8591_i2c_connect (void);
-void PCF8591_read_data(const void *BufControl, size_t sizeWBuf, int sizeRBuf,uint8_t *data_in);
+int PCF8591_read_data(const void *BufControl, size_t sizeWBuf, int sizeRBuf,uint8_t *data_in);
 
 
 char *i2c_chip = RPI_I2C_DEVICE;
@@ -129,7 +130,7 @@ int main(void)
         /* Methode 2 : activer l'auto incrémentation et récupérer toute les valeurs en une seul fois et l'afficher */
 
         buffer[0] = 0x04; ///< Control byte 0b0000 0100 -> Auto-increment mode
-        PCF8591_read_data(buffer,1,5,A_voltage_data); ///< Read voltage on all inputs
+        if (PCF8591_read_data(buffer,1,5,A_voltage_data) < 0){ sleep(1); continue;} ///< Read voltage on all inputs
 
         printf("Voltage on ADC :\n> A0 --> %xx\n> A1 --> %xx\n> A2 --> %xx\n> A3 --> %xx\n\n",A_voltage_data[1],A_voltage_data[2],A_voltage_data[3],A_voltage_data[4]);
         sleep(1);
@@ -173,18 +174,36 @@ unsigned short int PCF8591_read_voltage_mv(uint8_t channel)
 
 /**
  * @brief Transmet en communication I²C les octets de controls "BufControl" et stock la reception dans le buffer "data_in"
+ *        (une seule transaction I²C avec START répété quand le bit de sortie analogique est à 1)
  * @param BufControl --> buffer des octets de controles 
  * @param sizeWbuf   --> taille du buffer BufControl
  * @param data_in    --> buffer de reception
  * @param sizeRbuf   --> taille du buffer de reception 
- * @return rien
+ * @return 1 en cas de succès, -1 en cas d'erreur (composant absent, erreur de bus)
  * @warning neccesite l'execution de PCF8591_i2c_connect() avant utilisation 
  */
-void PCF8591_read_data(const void *BufControl, size_t sizeWBuf, int sizeRBuf,uint8_t *data_in)
+int PCF8591_read_data(const void *BufControl, size_t sizeWBuf, int sizeRBuf,uint8_t *data_in)
 {
-    write(fd, BufControl,sizeWBuf);
-    usleep(100000);
-    read(fd, data_in, sizeRBuf);
+    const uint8_t *buffer = BufControl;
+
+    if ((buffer[0] & 0x40) == 0x40)
+    {
+        /* sortie analogique active : l'oscillateur tourne, écriture et lecture en une seule transaction (START répété) */
+        struct i2c_msg messages[2] = {
+            {.addr = PCF8591_I2C_ADDR, .flags = 0, .len = sizeWBuf, .buf = (uint8_t *)BufControl},
+            {.addr = PCF8591_I2C_ADDR, .flags = I2C_M_RD, .len = sizeRBuf, .buf = data_in},
+        };
+        struct i2c_rdwr_ioctl_data packets = {.msgs = messages, .nmsgs = 2};
+        if (ioctl(fd, I2C_RDWR, &packets) < 0){ printf("/!\\ Error : I2C transfer failed.\n"); return -1;}
+    }
+    else
+    {
+        /* sortie analogique désactivée : il faut laisser l'oscillateur démarrer avant la lecture */
+        if (write(fd, BufControl,sizeWBuf) != (ssize_t)sizeWBuf){ printf("/!\\ Error : I2C write failed.\n"); return -1;}
+        usleep(100000);
+        if (read(fd, data_in, sizeRBuf) != sizeRBuf){ printf("/!\\ Error : I2C read failed.\n"); return -1;}
+    }
+    return 1;
 }
 
 /*
@@ -86,6 +86,7 @@
 #include <stdint.h>
 #include <linux/i2c-dev.h>
 #include <math.h>
+#include <time.h>
  
 #define PCF8591_I2C_ADDR 0x48 ///< PCF8591 i2c address
 #define RPI_I2C_DEVICE "/dev/i2c-1"
@@ -96,6 +97,7 @@
 /* Fonctions */
 void PCF8591_i2c_connect (void);
 void PCF8591_write_voltage(int voltage_mv);
+void attente_absolue(struct timespec *echeance, long long duree_ns);
 
 char *i2c_chip = RPI_I2C_DEVICE;
 int fd;
@@ -112,16 +114,20 @@ int main(void)
 {
     PCF8591_i2c_connect(); 
     
-    /* Définit le temps d'attent des états haut et bas */
-    int HighSleepTime = 1000000 * CYCLE_RATIO /  FREQUENCY;
-    int LowSleepTime = 1000000 * (100 - CYCLE_RATIO) /  FREQUENCY;
+    /* Définit la durée des états haut et bas (ns) */
+    long long HighTime = 1000000000LL * CYCLE_RATIO / 100 / FREQUENCY;
+    long long LowTime = 1000000000LL * (100 - CYCLE_RATIO) / 100 / FREQUENCY;
+
+    /* Les fronts sont placés sur des échéances absolues : le temps d'écriture I²C ne s'ajoute pas à chaque période */
+    struct timespec echeance;
+    clock_gettime(CLOCK_MONOTONIC, &echeance);
 
     while(1)
     {
         PCF8591_write_voltage(HIGH_STATE);
-        usleep(HighSleepTime);
+        attente_absolue(&echeance, HighTime);
         PCF8591_write_voltage(LOW_STATE);
-        usleep(LowSleepTime);
+        attente_absolue(&echeance, LowTime);
     }
 }
 
@@ -157,4 +163,21 @@ void PCF8591_write_voltage(int voltage_mv)
     uint8_t voltage_data = voltage_mv * 0xff / Vref;
     uint8_t BufControl[2] = {PCF8591_DAC_RQST,voltage_data};
     write(fd, BufControl, 0x02);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Avance l'échéance de "duree_ns" et attend jusqu'à cette échéance absolue
+ * @param echeance --> échéance courante (CLOCK_MONOTONIC), mise à jour
+ * @param duree_ns --> durée à ajouter à l'échéance (ns)
+ * @return rien
+ */
+void attente_absolue(struct timespec *echeance, long long duree_ns)
+{
+    echeance->tv_nsec += duree_ns;
+    while (echeance->tv_nsec >= 1000000000)
+    {
+        echeance->tv_nsec -= 1000000000;
+        echeance->tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, echeance, NULL);
+}
@@ -21,6 +21,15 @@
  * lc1543_delete(&tlc);
  * ``` 
  * 
+ * Le capteur HTS221 est lu via i2c_transport.h (accès registre par I2C_RDWR, sans libi2c), sur le bus
+ * partagé de i2c_bus.h : ouvert au premier appel de senseHat_humidity() puis gardé ouvert. Les registres de
+ * calibration et de mesure sont lus en un seul lot (i2c_batch.h), soit un seul ioctl.
+ * senseHat_humidity_async() fait la même mesure sans bloquer l'appelant : les accès sont confiés au thread du bus
+ * (i2c_async.h), qui relance la lecture de l'état de la conversion toutes les 25 ms au lieu de dormir dans delay().
+ * La sonde USDT sensehat:set_pixels (i2c_probe.h) date chaque image de senseHat_setPixels() pour perf et bpftrace.
+ * C'est une écriture dans le framebuffer (/dev/fb0), pas un accès I2C : adresse 0, 0 octet sur le bus, début, fin,
+ * premier pixel. Le driver rpisense-fb envoie ensuite l'image au contrôleur des leds de son côté.
+ * gcc -Wall -I../../i2c ... ../../i2c/i2c_bus.c -pthread
  */
 
 #ifndef SENSE_HAT_H
@@ -42,7 +51,10 @@
 #define SENSE_HAT_FILESIZE (SENSE_HAT_NUM_WORDS * sizeof(uint16_t))
 #endif
 
+#ifndef DEV_PATH
+/** @brief bus i2c du capteur d'humidité HTS221 */
 #define DEV_PATH "/dev/i2c-1"
+#endif
 #define DEV_ID 0x5F
 #define WHO_AM_I 0x0F
 
@@ -104,8 +116,11 @@
 #include <linux/fb.h>
 #include <poll.h>
 #include <dirent.h>
-#include <i2c/smbus.h>
 #include <linux/i2c-dev.h>
+#include "i2c_async.h"
+#include "i2c_probe.h"
+
+I2C_PROBE_DEFINE(sensehat, set_pixels);
 
 
 
@@ -166,6 +181,22 @@ int senseHat_init()
     return SENSE_HAT_SUCCESS;
 }
 
+/**
+ * @brief initialisation de la matrice de leds sur un tampon mémoire, sans /dev/fb0 (bus simulé, banc de mesure)
+ * 
+ * @param buffer tampon de SENSE_HAT_NUM_WORDS pixels, NULL pour utiliser un tampon interne
+ * @return SENSE_HAT_SUCCESS
+ */
+int senseHat_init_memory(uint16_t *buffer)
+{
+    static uint16_t memory[SENSE_HAT_NUM_WORDS];
+
+    fbfd = -1;
+    map = buffer ? buffer : memory;
+    p = map; // on met la position du pointeur à 0
+    return SENSE_HAT_SUCCESS;
+}
+
 void senseHat_clear(int color)
 {
     for (int i = 0; i < SENSE_HAT_NUM_WORDS; i++)
@@ -182,11 +213,13 @@ void senseHat_setPixel(int x, int y, int color)
 
 void senseHat_setPixels(int mapping[64])
 {
+    I2C_PROBE_BEGIN(sensehat, set_pixels, start_ns);
     p = map;
     for(int i = 0; i < SENSE_HAT_NUM_WORDS; i++)
     {
         *(p + i) = mapping[i];
     }
+    I2C_PROBE_END(sensehat, set_pixels, start_ns, 0, 0, mapping[0]); ///< framebuffer : pas d'adresse, rien sur le bus
 }
 
 int senseHat_getPixel(int x, int y)
@@ -222,74 +255,27 @@ void senseHat_flipR()
 
 void delay(int);
 
-int senseHat_humidity(void) {
-    int fd = 0;
-    uint8_t status = 0;
-
-    /* open i2c comms */
-    if ((fd = open(DEV_PATH, O_RDWR)) < 0) {
-        perror("Unable to open i2c device");
-        exit(1);
-    }
-
-    /* configure i2c slave */
-    if (ioctl(fd, I2C_SLAVE, DEV_ID) < 0) {
-        perror("Unable to configure i2c slave device");
-        close(fd);
-        exit(1);
-    }
-
-    /* check we are who we should be */
-    if (i2c_smbus_read_byte_data(fd, WHO_AM_I) != 0xBC) {
-        printf("%s\n", "who_am_i error");
-        close(fd);
-        exit(1);
-    }
-
-    /* Power down the device (clean start) */
-    i2c_smbus_write_byte_data(fd, CTRL_REG1, 0x00);
-
-    /* Turn on the humidity sensor analog front end in single shot mode  */
-    i2c_smbus_write_byte_data(fd, CTRL_REG1, 0x84);
-
-    /* Run one-shot measurement (temperature and humidity). The set bit will be reset by the
-     * sensor itself after execution (self-clearing bit) */
-    i2c_smbus_write_byte_data(fd, CTRL_REG2, 0x01);
-
-    /* Wait until the measurement is completed */
-    do {
-        delay(25); /* 25 milliseconds */
-        status = i2c_smbus_read_byte_data(fd, CTRL_REG2);
-    } while (status != 0);
-
-    /* Read calibration temperature LSB (ADC) data
-     * (temperature calibration x-data for two points)
-     */
-    uint8_t t0_out_l = i2c_smbus_read_byte_data(fd, T0_OUT_L);
-    uint8_t t0_out_h = i2c_smbus_read_byte_data(fd, T0_OUT_H);
-    uint8_t t1_out_l = i2c_smbus_read_byte_data(fd, T1_OUT_L);
-    uint8_t t1_out_h = i2c_smbus_read_byte_data(fd, T1_OUT_H);
-
-    /* Read calibration temperature (°C) data
-     * (temperature calibration y-data for two points)
-     */
-    uint8_t t0_degC_x8 = i2c_smbus_read_byte_data(fd, T0_degC_x8);
-    uint8_t t1_degC_x8 = i2c_smbus_read_byte_data(fd, T1_degC_x8);
-    uint8_t t1_t0_msb = i2c_smbus_read_byte_data(fd, T1_T0_MSB);
-
-    /* Read calibration relative humidity LSB (ADC) data
-     * (humidity calibration x-data for two points)
-     */
-    uint8_t h0_out_l = i2c_smbus_read_byte_data(fd, H0_T0_OUT_L);
-    uint8_t h0_out_h = i2c_smbus_read_byte_data(fd, H0_T0_OUT_H);
-    uint8_t h1_out_l = i2c_smbus_read_byte_data(fd, H1_T0_OUT_L);
-    uint8_t h1_out_h = i2c_smbus_read_byte_data(fd, H1_T0_OUT_H);
+/** @brief registres de calibration et de mesure du HTS221, lus en un lot */
+static const uint8_t senseHat_hts221_reg[17] = {
+    T0_OUT_L, T0_OUT_H, T1_OUT_L, T1_OUT_H, T0_degC_x8, T1_degC_x8, T1_T0_MSB,
+    H0_T0_OUT_L, H0_T0_OUT_H, H1_T0_OUT_L, H1_T0_OUT_H, H0_rH_x2, H1_rH_x2,
+    TEMP_OUT_L, TEMP_OUT_H, H_T_OUT_L, H_T_OUT_H
+};
 
-    /* Read relative humidity (% rH) data
-     * (humidity calibration y-data for two points)
-     */
-    uint8_t h0_rh_x2 = i2c_smbus_read_byte_data(fd, H0_rH_x2);
-    uint8_t h1_rh_x2 = i2c_smbus_read_byte_data(fd, H1_rH_x2);
+/**
+ * @brief calcule la température et l'humidité à partir des registres lus (ordre de senseHat_hts221_reg)
+ * 
+ * @param value valeurs des 17 registres
+ * @param T_DegC température ambiante en °C
+ * @param H_rH humidité relative en %
+ */
+static inline void senseHat_hts221_compute(const uint8_t value[17], double *T_DegC, double *H_rH)
+{
+    uint8_t t0_out_l = value[0], t0_out_h = value[1], t1_out_l = value[2], t1_out_h = value[3];
+    uint8_t t0_degC_x8 = value[4], t1_degC_x8 = value[5], t1_t0_msb = value[6];
+    uint8_t h0_out_l = value[7], h0_out_h = value[8], h1_out_l = value[9], h1_out_h = value[10];
+    uint8_t h0_rh_x2 = value[11], h1_rh_x2 = value[12];
+    uint8_t t_out_l = value[13], t_out_h = value[14], h_t_out_l = value[15], h_t_out_h = value[16];
 
     /* make 16 bit values (bit shift)
      * (temperature calibration x-values)
@@ -328,37 +314,253 @@ int senseHat_humidity(void) {
     double h_gradient_m = (H1_rH - H0_rH) / (H1_T0_OUT - H0_T0_OUT);
     double h_intercept_c = H1_rH - (h_gradient_m * H1_T0_OUT);
 
-    /* Read the ambient temperature measurement (2 bytes to read) */
-    uint8_t t_out_l = i2c_smbus_read_byte_data(fd, TEMP_OUT_L);
-    uint8_t t_out_h = i2c_smbus_read_byte_data(fd, TEMP_OUT_H);
-
     /* make 16 bit value */
     int16_t T_OUT = t_out_h << 8 | t_out_l;
 
-    /* Read the ambient humidity measurement (2 bytes to read) */
-    uint8_t h_t_out_l = i2c_smbus_read_byte_data(fd, H_T_OUT_L);
-    uint8_t h_t_out_h = i2c_smbus_read_byte_data(fd, H_T_OUT_H);
-
     /* make 16 bit value */
     int16_t H_T_OUT = h_t_out_h << 8 | h_t_out_l;
 
     /* Calculate ambient temperature */
-    double T_DegC = (t_gradient_m * T_OUT) + t_intercept_c;
+    *T_DegC = (t_gradient_m * T_OUT) + t_intercept_c;
 
     /* Calculate ambient humidity */
-    double H_rH = (h_gradient_m * H_T_OUT) + h_intercept_c;
+    *H_rH = (h_gradient_m * H_T_OUT) + h_intercept_c;
+}
+
+int senseHat_humidity(void) {
+    static i2c_bus_t *bus = NULL;
+    uint8_t status = 0;
+
+    /* open i2c comms (once, shared with the other drivers) */
+    if (bus == NULL) {
+        if ((bus = i2c_bus_get(DEV_PATH)) == NULL) {
+            perror("Unable to open i2c device");
+            exit(1);
+        }
+
+        /* check we are who we should be */
+        if (i2c_bus_read_reg(bus, DEV_ID, WHO_AM_I) != 0xBC) {
+            printf("%s\n", "who_am_i error");
+            i2c_bus_put(bus);
+            exit(1);
+        }
+    }
+
+    /* Power down the device (clean start) */
+    i2c_bus_write_reg(bus, DEV_ID, CTRL_REG1, 0x00);
+
+    /* Turn on the humidity sensor analog front end in single shot mode  */
+    i2c_bus_write_reg(bus, DEV_ID, CTRL_REG1, 0x84);
+
+    /* Run one-shot measurement (temperature and humidity). The set bit will be reset by the
+     * sensor itself after execution (self-clearing bit) */
+    i2c_bus_write_reg(bus, DEV_ID, CTRL_REG2, 0x01);
+
+    /* Wait until the measurement is completed */
+    do {
+        delay(25); /* 25 milliseconds */
+        status = i2c_bus_read_reg(bus, DEV_ID, CTRL_REG2);
+    } while (status != 0);
+
+    /* Read the calibration registers (temperature and humidity x/y-data for two points)
+     * and the ambient measurements in one batch : one ioctl(I2C_RDWR) for the 17 registers
+     */
+    uint8_t value[17];
+    i2c_op_t op[17];
+    i2c_batch_t batch;
+    i2c_batch_init(&batch, bus);
+    for (int i = 0; i < 17; i++) {
+        i2c_batch_add(&batch, i2c_op_read_reg(&op[i], DEV_ID, senseHat_hts221_reg[i], &value[i]));
+    }
+    if (i2c_batch_flush(&batch) < 0) {
+        printf("%s\n", "i2c read error");
+        i2c_bus_write_reg(bus, DEV_ID, CTRL_REG1, 0x00);
+        return SENSE_HAT_ERR;
+    }
+
+    double T_DegC, H_rH;
+    senseHat_hts221_compute(value, &T_DegC, &H_rH);
 
     /* Output */
     printf("Temp (from humid) = %.1f°C\n", T_DegC);
     printf("Humidity = %.0f%% rH\n", H_rH);
 
     /* Power down the device */
-    i2c_smbus_write_byte_data(fd, CTRL_REG1, 0x00);
-    close(fd);
+    i2c_bus_write_reg(bus, DEV_ID, CTRL_REG1, 0x00);
 
     return (0);
 }
 
+#ifndef SENSE_HAT_POLL_NS
+/** @brief intervalle de lecture de l'état de la conversion en mode asynchrone (25 ms, comme delay(25)) */
+#define SENSE_HAT_POLL_NS 25000000ull
+#endif
+#ifndef SENSE_HAT_POLL_MAX
+/** @brief nombre de lectures de l'état avant d'abandonner la mesure (1 s) */
+#define SENSE_HAT_POLL_MAX 40
+#endif
+
+typedef struct senseHat_humidity_request senseHat_humidity_request_t;
+
+/**
+ * @brief mesure asynchrone du HTS221 (senseHat_humidity_async()), fournie par l'appelant et valide jusqu'à la fin
+ */
+struct senseHat_humidity_request
+{
+    i2c_async_t *async;     ///< thread du bus
+    i2c_op_t op[23];        ///< WHO_AM_I, démarrage (3), état, registres (17), arrêt (ou relecture de WHO_AM_I)
+    uint8_t who_am_i;       ///< identifiant lu
+    uint8_t status;         ///< CTRL_REG2 lu, 0 quand la conversion est finie
+    uint8_t value[17];      ///< registres lus (ordre de senseHat_hts221_reg)
+    int nb_poll;            ///< lectures de l'état faites
+    int result;             ///< SENSE_HAT_SUCCESS ou SENSE_HAT_ERR à la fin
+    double temperature;     ///< température en °C
+    double humidity;        ///< humidité relative en %
+    void (*done)(senseHat_humidity_request_t *req); ///< appelée à la fin dans le thread du bus, ou NULL
+    void *arg;              ///< donnée de l'appelant
+};
+
+/**
+ * @brief fin de la mesure (opération d'arrêt du capteur) : calcul du résultat, appel de done
+ */
+static inline void senseHat_humidity_finish(i2c_op_t *op)
+{
+    senseHat_humidity_request_t *req = op->arg;
+
+    for (int i = 5; (i < 22) && (req->result == SENSE_HAT_SUCCESS); i++) {
+        if (req->op[i].status != I2C_OP_DONE) {
+            req->result = SENSE_HAT_ERR;
+        }
+    }
+    if (req->result == SENSE_HAT_SUCCESS) {
+        senseHat_hts221_compute(req->value, &req->temperature, &req->humidity);
+    }
+    if (req->done) {
+        req->done(req);
+    }
+}
+
+/**
+ * @brief dernière opération de la mesure : arrêt du capteur, ou relecture de WHO_AM_I quand le capteur n'a pas été
+ *        reconnu (rien n'est écrit sur un composant inconnu). Sa fin appelle done ou la poste dans la file.
+ */
+static inline void senseHat_humidity_end(senseHat_humidity_request_t *req, int power_down)
+{
+    if (power_down) {
+        i2c_op_write_reg(&req->op[22], DEV_ID, CTRL_REG1, 0x00);
+    }
+    else {
+        i2c_op_read_reg(&req->op[22], DEV_ID, WHO_AM_I, &req->who_am_i);
+    }
+    req->op[22].done = senseHat_humidity_finish;
+    req->op[22].arg = req;
+    req->op[22].post = (req->done == NULL);
+    if (i2c_async_submit(req->async, &req->op[22]) < 0) {
+        req->result = SENSE_HAT_ERR;
+        senseHat_humidity_finish(&req->op[22]);
+    }
+}
+
+/**
+ * @brief lecture de l'état de la conversion : relancée 25 ms plus tard tant que la conversion n'est pas finie,
+ *        puis lecture des 17 registres et arrêt du capteur en un seul lot
+ */
+static inline void senseHat_humidity_poll(i2c_op_t *op)
+{
+    senseHat_humidity_request_t *req = op->arg;
+
+    if ((op->status != I2C_OP_DONE) || (++req->nb_poll > SENSE_HAT_POLL_MAX)) {
+        req->result = SENSE_HAT_ERR;
+    }
+    else if (req->status != 0) {
+        i2c_op_read_reg(op, DEV_ID, CTRL_REG2, &req->status);
+        op->done = senseHat_humidity_poll;
+        op->arg = req;
+        if (i2c_async_submit_in(req->async, op, SENSE_HAT_POLL_NS) < 0) {
+            req->result = SENSE_HAT_ERR;
+        }
+        else {
+            return;
+        }
+    }
+    else {
+        for (int i = 0; i < 17; i++) {
+            i2c_async_submit(req->async, i2c_op_read_reg(&req->op[5 + i], DEV_ID, senseHat_hts221_reg[i], &req->value[i]));
+        }
+    }
+
+    senseHat_humidity_end(req, 1);
+}
+
+/**
+ * @brief lecture de WHO_AM_I : les écritures de démarrage ne partent que si le capteur est bien un HTS221,
+ *        comme dans senseHat_humidity()
+ */
+static inline void senseHat_humidity_start(i2c_op_t *op)
+{
+    senseHat_humidity_request_t *req = op->arg;
+
+    if ((op->status != I2C_OP_DONE) || (req->who_am_i != 0xBC)) {
+        printf("%s\n", "who_am_i error");
+        req->result = SENSE_HAT_ERR;
+        senseHat_humidity_end(req, 0);
+        return;
+    }
+
+    /* power down, turn on in single shot mode and run one-shot measurement */
+    i2c_op_write_reg(&req->op[1], DEV_ID, CTRL_REG1, 0x00);
+    i2c_op_write_reg(&req->op[2], DEV_ID, CTRL_REG1, 0x84);
+    i2c_op_write_reg(&req->op[3], DEV_ID, CTRL_REG2, 0x01);
+    for (int i = 1; i < 4; i++) {
+        if (i2c_async_submit(req->async, &req->op[i]) < 0) {
+            req->result = SENSE_HAT_ERR;
+            senseHat_humidity_end(req, 1);
+            return;
+        }
+    }
+
+    /* first status read 25 ms later */
+    i2c_op_read_reg(&req->op[4], DEV_ID, CTRL_REG2, &req->status);
+    req->op[4].done = senseHat_humidity_poll;
+    req->op[4].arg = req;
+    if (i2c_async_submit_in(req->async, &req->op[4], SENSE_HAT_POLL_NS) < 0) {
+        req->result = SENSE_HAT_ERR;
+        senseHat_humidity_end(req, 1);
+    }
+}
+
+/**
+ * @brief lance une mesure de température et d'humidité sans attendre : le thread du bus lit WHO_AM_I, démarre la
+ *        conversion si le capteur est bien un HTS221, lit son état toutes les 25 ms puis les registres.
+ * 
+ * A la fin, req->result, req->temperature et req->humidity sont remplis et done(req) est appelée dans le thread du
+ * bus ; sans done, l'opération &req->op[22] (arg => req) arrive dans la file des opérations terminées (i2c_async_fd(),
+ * i2c_async_reap()).
+ * 
+ * @param async thread du bus du Sense HAT (i2c_async_open(async, DEV_PATH))
+ * @param req mesure, à ne pas modifier avant la fin
+ * @param done fonction de fin (ne doit pas bloquer), ou NULL
+ * @param arg donnée de l'appelant (req->arg)
+ * @return SENSE_HAT_SUCCESS, SENSE_HAT_ERR si le thread du bus est arrêté
+ */
+int senseHat_humidity_async(i2c_async_t *async, senseHat_humidity_request_t *req, void (*done)(senseHat_humidity_request_t *req), void *arg)
+{
+    memset(req, 0, sizeof(*req));
+    req->async = async;
+    req->result = SENSE_HAT_SUCCESS;
+    req->done = done;
+    req->arg = arg;
+
+    /* check we are who we should be : the measurement is started by the completion of the read */
+    i2c_op_read_reg(&req->op[0], DEV_ID, WHO_AM_I, &req->who_am_i);
+    req->op[0].done = senseHat_humidity_start;
+    req->op[0].arg = req;
+    if (i2c_async_submit(async, &req->op[0]) < 0) {
+        return SENSE_HAT_ERR;
+    }
+    return SENSE_HAT_SUCCESS;
+}
+
 void delay(int t) {
     usleep(t * 1000);
 }
@@ -4,7 +4,7 @@
  *
  *  Uses the mmap method to map the led device into memory
  *
- *  Build with:  gcc -Wall -O2 led_matrix.c -o led_matrix
+ *  Build with:  gcc -Wall -O2 -I../../i2c led_matrix_2.c ../../i2c/i2c_bus.c -o led_matrix -pthread
  *               or just 'make'
  *
  *  Tested with:  Sense HAT v1.0 / Raspberry Pi 3 B+ / Raspbian GNU/Linux 10 (buster)
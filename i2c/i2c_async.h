@@ -0,0 +1,361 @@
+/**
+ * @brief Asynchronous I2C requests : the operations are run by a worker thread of the bus, the caller doesn't wait
+ *
+ * @file i2c_async.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ * compilation : add i2c_bus.c and -pthread to the gcc command line.
+ *
+ * i2c_async_open() starts one worker thread on a shared bus (i2c_bus.h). The application submits operations of
+ * i2c_batch.h (i2c_op_t) with i2c_async_submit() and goes on with its work :
+ *  - the worker runs the operations submitted since its last wake-up together, in as few ioctl(I2C_RDWR) as possible
+ *    (i2c_batch_flush()).
+ *  - an operation can wait for a date (op->at_ns, CLOCK_MONOTONIC) : a conversion in progress (HTS221 one-shot,
+ *    ...) is polled again later by the worker, no thread sleeps in a driver call.
+ *  - once done, the completion function of the operation (op->done) is called in the worker thread, then the
+ *    operation is put in the completion queue if op->post is set. The queue is read with i2c_async_reap(), its
+ *    eventfd (i2c_async_fd()) is readable while it is not empty, so it can be watched with poll() / epoll next to the
+ *    other descriptors of the application (joystick, sockets, timers).
+ *
+ * The drivers provide async versions of their accesses : pcf8591_async_read_all(), pcf8591_async_write_data(),
+ * PCF8574_async_read(), PCF8574_async_write(), senseHat_humidity_async().
+ *
+ * @warning An operation belongs to the worker from i2c_async_submit() to its completion (and, if posted, until it
+ *          is reaped) : don't modify it or its buffers meanwhile. A completion function runs in the worker thread, it
+ *          must not block ; it can submit other operations, or submit again its own operation if it isn't posted.
+ *          A device driven through the worker isn't used by the synchronous functions at the same time.
+ */
+
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "i2c_batch.h"
+
+/**
+ * @brief Worker of one bus and its queues.
+ */
+typedef struct
+{
+    i2c_bus_t *bus;               ///< Bus of the operations.
+    pthread_t thread;             ///< Worker thread.
+    pthread_mutex_t lock;         ///< Protects the queues and stop.
+    pthread_cond_t wake;          ///< Signals the worker (CLOCK_MONOTONIC).
+    i2c_op_t *ready, *ready_tail; ///< Operations to run, in submission order.
+    i2c_op_t *timed;              ///< Operations waiting for their date, sorted by date.
+    i2c_op_t *posted, *posted_tail; ///< Completion queue.
+    int efd;                      ///< eventfd, readable while the completion queue is not empty.
+    int stop;                     ///< Set by i2c_async_close().
+    int priority;                 ///< Class of the bus accesses of the worker (i2c_async_set_class()).
+    i2c_batch_t batch;            ///< Batch of the worker (counters nb_done, nb_ioctl, nb_replay).
+    unsigned long nb_submit;      ///< Operations submitted.
+    unsigned long nb_wakeup;      ///< Batches run by the worker.
+} i2c_async_t;
+
+/**
+ * @brief Return the CLOCK_MONOTONIC time in ns (the dates of op->at_ns).
+ */
+static inline uint64_t i2c_async_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Put a done operation in the completion queue. Called with the lock held.
+ */
+static inline void i2c_async_post(i2c_async_t *async, i2c_op_t *op)
+{
+    op->next = NULL;
+    if (async->posted_tail){ async->posted_tail->next = op;}
+    else { async->posted = op;}
+    async->posted_tail = op;
+}
+
+/**
+ * @brief Move the operations whose date has come to the ready queue. Called with the lock held.
+ * @return Date of the next timed operation, 0 if there is none.
+ */
+static inline uint64_t i2c_async_due(i2c_async_t *async, uint64_t now_ns)
+{
+    while (async->timed && (async->timed->at_ns <= now_ns))
+    {
+        i2c_op_t *op = async->timed;
+        async->timed = op->next;
+        op->next = NULL;
+        if (async->ready_tail){ async->ready_tail->next = op;}
+        else { async->ready = op;}
+        async->ready_tail = op;
+    }
+    return async->timed ? async->timed->at_ns : 0;
+}
+
+/**
+ * @brief Worker thread : run the ready operations in batches, sleep until the next submission or date.
+ * @param arg The worker (i2c_async_t).
+ * @return NULL.
+ */
+static inline void *i2c_async_worker(void *arg)
+{
+    i2c_async_t *async = arg;
+    i2c_op_t *op[I2C_BATCH_OP_MAX];
+    int post[I2C_BATCH_OP_MAX];
+
+    pthread_mutex_lock(&async->lock);
+    for (;;)
+    {
+        uint64_t next_ns = i2c_async_due(async, i2c_async_time_ns());
+        if (async->ready == NULL)
+        {
+            if (async->stop){ break;}
+            if (next_ns == 0){ pthread_cond_wait(&async->wake, &async->lock);}
+            else
+            {
+                struct timespec deadline = {.tv_sec = next_ns / 1000000000ull, .tv_nsec = next_ns % 1000000000ull};
+                pthread_cond_timedwait(&async->wake, &async->lock, &deadline);
+            }
+            continue;
+        }
+
+        /* take the ready operations, run them without the lock (their completion can submit) */
+        int nb_op = 0;
+        while (async->ready && (nb_op < I2C_BATCH_OP_MAX))
+        {
+            op[nb_op] = async->ready;
+            async->ready = op[nb_op]->next;
+            post[nb_op] = op[nb_op]->post; ///< read before the completion, which can free or reuse an operation not posted
+            nb_op++;
+        }
+        if (async->ready == NULL){ async->ready_tail = NULL;}
+        async->nb_wakeup++;
+        i2c_bus_set_class(async->priority);
+        pthread_mutex_unlock(&async->lock);
+
+        for (int i = 0; i < nb_op; i++){ i2c_batch_add(&async->batch, op[i]);}
+        i2c_batch_flush(&async->batch);
+
+        pthread_mutex_lock(&async->lock);
+        int nb_post = 0;
+        for (int i = 0; i < nb_op; i++)
+        {
+            if (post[i]){ i2c_async_post(async, op[i]); nb_post++;}
+        }
+        if (nb_post)
+        {
+            uint64_t one = 1;
+            if (write(async->efd, &one, sizeof(one)) < 0){} ///< only fails when the counter is saturated, the fd is readable anyway
+        }
+    }
+
+    /* closing : the operations still waiting for their date are cancelled */
+    int nb_cancel = 0;
+    while (async->timed)
+    {
+        i2c_op_t *cancel = async->timed;
+        async->timed = cancel->next;
+        pthread_mutex_unlock(&async->lock);
+        int posted = cancel->post;
+        cancel->status = I2C_OP_ERROR;
+        if (cancel->done){ cancel->done(cancel);}
+        pthread_mutex_lock(&async->lock);
+        if (posted){ i2c_async_post(async, cancel); nb_cancel++;}
+    }
+    if (nb_cancel)
+    {
+        uint64_t one = 1;
+        if (write(async->efd, &one, sizeof(one)) < 0){}
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+/**
+ * @brief Open a bus and start its worker thread.
+ * @param async The worker.
+ * @param name Bus device file ("/dev/i2c-1") or name of a simulated bus.
+ * @return 1 on success, -1 on error.
+ */
+static inline int i2c_async_open(i2c_async_t *async, const char *name)
+{
+    pthread_condattr_t attr;
+
+    memset(async, 0, sizeof(*async));
+    if ((async->bus = i2c_bus_get(name)) == NULL){ return -1;}
+    if ((async->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+        printf("/!\\ Error : eventfd failed (%s).\n", strerror(errno));
+        i2c_bus_put(async->bus);
+        return -1;
+    }
+    i2c_batch_init(&async->batch, async->bus);
+    async->priority = I2C_CLASS_INPUT;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&async->wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&async->thread, NULL, i2c_async_worker, async) != 0)
+    {
+        printf("/!\\ Error : cannot start the I2C worker thread.\n");
+        pthread_cond_destroy(&async->wake);
+        pthread_mutex_destroy(&async->lock);
+        close(async->efd);
+        i2c_bus_put(async->bus);
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stop the worker and release the bus. The ready operations are run first, the operations waiting for
+ *        their date complete with I2C_OP_ERROR. The posted operations not reaped are dropped.
+ * @param async The worker.
+ */
+static inline void i2c_async_close(i2c_async_t *async)
+{
+    pthread_mutex_lock(&async->lock);
+    async->stop = 1;
+    pthread_cond_signal(&async->wake);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+
+    pthread_cond_destroy(&async->wake);
+    pthread_mutex_destroy(&async->lock);
+    close(async->efd);
+    i2c_bus_put(async->bus);
+    async->bus = NULL;
+}
+
+/**
+ * @brief Set the class of the bus accesses of the worker (i2c_bus.h), I2C_CLASS_INPUT by default.
+ * @param async The worker.
+ * @param priority I2C_CLASS_RT / I2C_CLASS_INPUT / I2C_CLASS_BULK.
+ * @return 1 on success, -1 on a bad class.
+ */
+static inline int i2c_async_set_class(i2c_async_t *async, int priority)
+{
+    if ((priority < 0) || (priority >= I2C_CLASS_NB)){ printf("/!\\ Error : unknown I2C priority class %d.\n", priority); return -1;}
+    pthread_mutex_lock(&async->lock);
+    async->priority = priority;
+    pthread_mutex_unlock(&async->lock);
+    return 1;
+}
+
+/**
+ * @brief Submit an operation filled with i2c_op_xxx() to the worker.
+ *        Before the call, set op->done / op->arg for a completion function, op->post to get it in the completion
+ *        queue, op->at_ns to start it at a date.
+ * @param async The worker.
+ * @param op The operation, owned by the worker until its completion.
+ * @return 1 on success, -1 if the worker is stopping.
+ */
+static inline int i2c_async_submit(i2c_async_t *async, i2c_op_t *op)
+{
+    pthread_mutex_lock(&async->lock);
+    if (async->stop)
+    {
+        pthread_mutex_unlock(&async->lock);
+        printf("/!\\ Error : I2C worker closed.\n");
+        return -1;
+    }
+    op->status = I2C_OP_QUEUED;
+    op->next = NULL;
+    async->nb_submit++;
+    if (op->at_ns == 0)
+    {
+        if (async->ready_tail){ async->ready_tail->next = op;}
+        else { async->ready = op;}
+        async->ready_tail = op;
+    }
+    else
+    {
+        i2c_op_t **p = &async->timed;
+        while (*p && ((*p)->at_ns <= op->at_ns)){ p = &(*p)->next;}
+        op->next = *p;
+        *p = op;
+    }
+    pthread_cond_signal(&async->wake);
+    pthread_mutex_unlock(&async->lock);
+    return 1;
+}
+
+/**
+ * @brief Submit an operation to start after a delay.
+ * @param async The worker.
+ * @param op The operation.
+ * @param delay_ns Delay from now.
+ * @return 1 on success, -1 if the worker is stopping.
+ */
+static inline int i2c_async_submit_in(i2c_async_t *async, i2c_op_t *op, uint64_t delay_ns)
+{
+    op->at_ns = i2c_async_time_ns() + delay_ns;
+    return i2c_async_submit(async, op);
+}
+
+/**
+ * @brief Return the eventfd of the completion queue, readable while posted operations are waiting for
+ *        i2c_async_reap().
+ */
+static inline int i2c_async_fd(const i2c_async_t *async)
+{
+    return async->efd;
+}
+
+/**
+ * @brief Take done operations from the completion queue, without waiting.
+ * @param async The worker.
+ * @param op Array that will get the operations (their status is I2C_OP_DONE or I2C_OP_ERROR).
+ * @param nb_max Size of the array.
+ * @return Number of operations taken.
+ */
+static inline int i2c_async_reap(i2c_async_t *async, i2c_op_t **op, int nb_max)
+{
+    uint64_t count;
+    int nb = 0;
+
+    pthread_mutex_lock(&async->lock);
+    if (read(async->efd, &count, sizeof(count)) < 0){} ///< EAGAIN when already reset
+    while (async->posted && (nb < nb_max))
+    {
+        op[nb] = async->posted;
+        async->posted = op[nb]->next;
+        op[nb++]->next = NULL;
+    }
+    if (async->posted == NULL){ async->posted_tail = NULL;}
+    else
+    {
+        count = 1;
+        if (write(async->efd, &count, sizeof(count)) < 0){} ///< operations left : stays readable
+    }
+    pthread_mutex_unlock(&async->lock);
+    return nb;
+}
+
+/**
+ * @brief Wait for done operations and take them from the completion queue.
+ * @param async The worker.
+ * @param op Array that will get the operations.
+ * @param nb_max Size of the array.
+ * @param timeout_ms Longest wait in ms, -1 without limit.
+ * @return Number of operations taken (0 on timeout), -1 on error.
+ */
+static inline int i2c_async_wait(i2c_async_t *async, i2c_op_t **op, int nb_max, int timeout_ms)
+{
+    struct pollfd fds = {.fd = async->efd, .events = POLLIN};
+
+    int result = poll(&fds, 1, timeout_ms);
+    if ((result < 0) && (errno == EINTR)){ return 0;}
+    if (result < 0){ printf("/!\\ Error : poll failed (%s).\n", strerror(errno)); return -1;}
+    return result ? i2c_async_reap(async, op, nb_max) : 0;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @brief This program checks the asynchronous requests of i2c_async.h on the simulated board of i2c_sim.h : completion
+ *        queue and eventfd, delayed operations, HTS221 measurement without blocking, errors and cancel on close.
+
+ * @file i2c_async_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -I. -I../PCF8591/header -I../PCF8574 -I../Sense_HAT/code_c -o i2c_async_test i2c_async_test.c ../PCF8591/header/PCF8591.c ../PCF8574/PCF8574.c i2c_bus.c -lm -pthread
+ *
+ * The program returns 0 when every check passes, 1 otherwise.
+ */
+
+/* Library */
+#include "Sense_hat.h" ///< before PCF8591.h : its "resolution" macro clashes with linux/input.h
+#include "PCF8591.h"
+#include "PCF8574.h"
+#include "i2c_sim.h"
+#include <poll.h>
+#include <math.h>
+#include <stdatomic.h>
+
+static i2c_sim_board_t board;
+static int nb_error = 0;
+static atomic_int humidity_done;
+
+/**
+ * @brief Display the result of a check and count the failures.
+ */
+void check(const char *name, int ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok){ nb_error++;}
+}
+
+/**
+ * @brief Completion of the HTS221 measurement, in the thread of the bus.
+ */
+void on_humidity(senseHat_humidity_request_t *req)
+{
+    (void)req;
+    atomic_store(&humidity_done, 1);
+}
+
+int main(void)
+{
+    i2c_async_t async;
+    senseHat_humidity_request_t req;
+    i2c_op_t op[2], *done[4];
+    uint8_t data[PCF8591_NB_CHANNEL + 1], port, byte;
+    int ok;
+
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ board.pcf8591.input_mv[i] = 500 + 700 * i;}
+    board.pcf8574.latch = 0xA5;
+    board.hts221.temperature_c = 23.5;
+    board.hts221.humidity_rh = 45.0;
+    board.hts221.conversion_ns = 60000000; ///< 60 ms : several status reads
+    PCF8591_i2c_connect();
+    PCF8574_init();
+    check("open", i2c_async_open(&async, "/dev/i2c-1") == 1);
+
+    /* HTS221 measurement : the submit returns at once, the other devices are served during the conversion */
+    uint64_t start = i2c_async_time_ns();
+    check("humidity : submitted", senseHat_humidity_async(&async, &req, on_humidity, NULL) == SENSE_HAT_SUCCESS);
+    check("humidity : the submit doesn't wait", i2c_async_time_ns() - start < 5000000);
+    int nb_cycle = 0;
+    ok = 1;
+    while (!atomic_load(&humidity_done) && (i2c_async_time_ns() - start < 2000000000ull))
+    {
+        pcf8591_async_read_all(&async, &pcf8591_default, &op[0], data);
+        PCF8574_async_read(&async, &op[1], &port);
+        for (int nb = 0; nb < 2;)
+        {
+            int n = i2c_async_wait(&async, done, 4, 1000);
+            if (n <= 0){ ok = 0; break;}
+            nb += n;
+        }
+        ok &= (op[0].status == I2C_OP_DONE) && (op[1].status == I2C_OP_DONE) && (port == 0xA5);
+        for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ ok &= (data[i + 1] == lround((500 + 700 * i) * 255.0 / Vref));}
+        nb_cycle++;
+    }
+    check("humidity : done", atomic_load(&humidity_done));
+    check("humidity : other devices read during the conversion", ok && (nb_cycle > 1));
+    check("humidity : status polled until the end of the conversion", req.nb_poll >= 2);
+    check("humidity : result", (req.result == SENSE_HAT_SUCCESS) && (fabs(req.temperature - 23.5) < 0.5) && (fabs(req.humidity - 45.0) < 1.0));
+
+    /* another device at the HTS221 address : nothing is written, the measurement fails */
+    board.hts221.reg[I2C_SIM_HTS221_WHO_AM_I] = 0x00;
+    board.hts221.reg[I2C_SIM_HTS221_CTRL_REG1] = 0x5A;
+    unsigned long nb_conversion = board.hts221.nb_conversion;
+    atomic_store(&humidity_done, 0);
+    start = i2c_async_time_ns();
+    check("bad WHO_AM_I : submitted", senseHat_humidity_async(&async, &req, on_humidity, NULL) == SENSE_HAT_SUCCESS);
+    while (!atomic_load(&humidity_done) && (i2c_async_time_ns() - start < 2000000000ull)){ usleep(1000);}
+    check("bad WHO_AM_I : error", atomic_load(&humidity_done) && (req.result == SENSE_HAT_ERR));
+    check("bad WHO_AM_I : no control register written", (board.hts221.reg[I2C_SIM_HTS221_CTRL_REG1] == 0x5A) && (board.hts221.nb_conversion == nb_conversion));
+    board.hts221.reg[I2C_SIM_HTS221_WHO_AM_I] = 0xBC;
+    board.hts221.reg[I2C_SIM_HTS221_CTRL_REG1] = 0x00;
+
+    /* completion queue : eventfd readable once an operation is done, empty after the reap */
+    i2c_op_read(&op[0], 0x20, &byte, 1)->post = 1;
+    i2c_async_submit(&async, &op[0]);
+    struct pollfd pfd = {.fd = i2c_async_fd(&async), .events = POLLIN};
+    check("eventfd : readable after the completion", (poll(&pfd, 1, 1000) == 1) && (i2c_async_reap(&async, done, 4) == 1) && (done[0] == &op[0]));
+    check("eventfd : empty after the reap", (poll(&pfd, 1, 0) == 0) && (i2c_async_reap(&async, done, 4) == 0));
+
+    /* delayed operation */
+    i2c_op_read(&op[0], 0x20, &byte, 1)->post = 1;
+    start = i2c_async_time_ns();
+    i2c_async_submit_in(&async, &op[0], 20000000);
+    check("delayed : done", (i2c_async_wait(&async, done, 4, 1000) == 1) && (op[0].status == I2C_OP_DONE));
+    check("delayed : not before its date", i2c_async_time_ns() - start >= 20000000);
+
+    /* device that doesn't answer */
+    i2c_op_read(&op[0], 0x50, &byte, 1)->post = 1;
+    i2c_async_submit(&async, &op[0]);
+    check("absent device : error", (i2c_async_wait(&async, done, 4, 1000) == 1) && (op[0].status == I2C_OP_ERROR));
+
+    /* close : the operations waiting for their date are cancelled */
+    i2c_op_read(&op[1], 0x48, &byte, 1)->post = 1;
+    i2c_async_submit_in(&async, &op[1], 5000000000ull);
+    i2c_async_close(&async);
+    check("close : delayed operation cancelled", op[1].status == I2C_OP_ERROR);
+
+    printf("%s : %d failed check(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
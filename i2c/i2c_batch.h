@@ -0,0 +1,244 @@
+/**
+ * @brief Batched I2C operations : the operations queued by the drivers are run in as few ioctl(I2C_RDWR) calls as possible
+ *
+ * @file i2c_batch.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ * compilation : add i2c_bus.c and -pthread to the gcc command line.
+ *
+ * An operation (i2c_op_t) is a write, a read, or a write followed by a read after a repeated START, on one slave.
+ * The drivers fill operations (i2c_op_write(), i2c_op_read_reg(), pcf8591_batch_read_all(), PCF8574_batch_write(), ...)
+ * and queue them with i2c_batch_add(). i2c_batch_flush() packs the messages of the queued operations, each with
+ * its own slave address, into one ioctl(I2C_RDWR) of up to I2C_RDWR_IOCTL_MAX_MSGS messages (42), then gives every
+ * operation its status and calls its completion function.
+ *
+ * A sensor cycle on a shared bus (PCF8591 inputs, PCF8574 port, HTS221 registers, ...) then costs one system call
+ * instead of one or two per device, and no ioctl(I2C_SLAVE).
+ *
+ * The adapter stops the whole ioctl at the first NACK without telling which message failed : the operations of a
+ * failed ioctl are then run again one by one to give each its own status. The operations before the failing one are
+ * run twice, so only batch operations which can be repeated (register reads and writes, port and DAC writes).
+ *
+ * @warning A batch is filled and flushed by one thread (the bus itself is locked during each ioctl).
+ *          The operations and their buffers must stay valid until the flush.
+ */
+
+#ifndef I2C_BATCH_H
+#define I2C_BATCH_H
+
+#include "i2c_bus.h"
+
+#ifndef I2C_BATCH_OP_MAX
+#define I2C_BATCH_OP_MAX 64 ///< Operations queued before an automatic flush.
+#endif
+#define I2C_BATCH_MSG_MAX I2C_RDWR_IOCTL_MAX_MSGS ///< Messages in one ioctl(I2C_RDWR) (kernel limit).
+#define I2C_OP_INLINE 4 ///< Short writes (register address, control byte) are copied in the operation.
+
+#define I2C_OP_QUEUED 0 ///< Operation waiting for the flush.
+#define I2C_OP_DONE 1   ///< Operation done.
+#define I2C_OP_ERROR -1 ///< Operation failed (NACK, bus error).
+
+typedef struct i2c_op i2c_op_t;
+
+/**
+ * @brief One operation on one slave : write, read or write then read (repeated START).
+ */
+struct i2c_op
+{
+    uint16_t address;               ///< 7 bit address of the slave.
+    uint8_t *tx;                    ///< Bytes written, NULL for a read.
+    uint16_t tx_len;                ///< Number of bytes written.
+    uint8_t *rx;                    ///< Buffer of the bytes read, NULL for a write.
+    uint16_t rx_len;                ///< Number of bytes read.
+    uint8_t data[I2C_OP_INLINE];    ///< Copy of a short write.
+    int status;                     ///< I2C_OP_QUEUED / I2C_OP_DONE / I2C_OP_ERROR.
+    void (*done)(i2c_op_t *op);     ///< Called after the flush with the status set (can be NULL).
+    void *arg;                      ///< Data of the completion function.
+    i2c_op_t *next;                 ///< Queues of i2c_async.h.
+    uint64_t at_ns;                 ///< i2c_async.h : CLOCK_MONOTONIC time before which the operation doesn't start, 0 = now.
+    int post;                       ///< i2c_async.h : 1 to put the operation in the completion queue once done.
+};
+
+/**
+ * @brief Operations queued on one bus.
+ */
+typedef struct
+{
+    i2c_bus_t *bus;                     ///< Bus of the operations.
+    i2c_op_t *op[I2C_BATCH_OP_MAX];     ///< Queued operations, run in this order.
+    int nb_op;                          ///< Number of queued operations.
+    unsigned long nb_done;              ///< Operations run.
+    unsigned long nb_ioctl;             ///< ioctl(I2C_RDWR) made.
+    unsigned long nb_replay;            ///< Operations run again alone after a failed ioctl.
+} i2c_batch_t;
+
+/**
+ * @brief Fill an operation.
+ * @param op The operation.
+ * @param address 7 bit address of the slave.
+ * @param tx Bytes to write (copied when up to I2C_OP_INLINE bytes), NULL for a read.
+ * @param tx_len Number of bytes to write.
+ * @param rx Buffer that will get the bytes read, NULL for a write.
+ * @param rx_len Number of bytes to read.
+ * @return The operation.
+ */
+static inline i2c_op_t *i2c_op_write_read(i2c_op_t *op, uint16_t address, const uint8_t *tx, uint16_t tx_len, uint8_t *rx, uint16_t rx_len)
+{
+    op->address = address;
+    op->tx_len = tx ? tx_len : 0;
+    op->rx = rx;
+    op->rx_len = rx ? rx_len : 0;
+    if (op->tx_len <= I2C_OP_INLINE)
+    {
+        if (op->tx_len){ memcpy(op->data, tx, op->tx_len);}
+        op->tx = op->data;
+    }
+    else
+    {
+        op->tx = (uint8_t *)tx;
+    }
+    op->status = I2C_OP_QUEUED;
+    op->done = NULL;
+    op->arg = NULL;
+    op->next = NULL;
+    op->at_ns = 0;
+    op->post = 0;
+    return op;
+}
+
+/** @brief Fill a write operation. */
+static inline i2c_op_t *i2c_op_write(i2c_op_t *op, uint16_t address, const uint8_t *tx, uint16_t tx_len)
+{
+    return i2c_op_write_read(op, address, tx, tx_len, NULL, 0);
+}
+
+/** @brief Fill a read operation. */
+static inline i2c_op_t *i2c_op_read(i2c_op_t *op, uint16_t address, uint8_t *rx, uint16_t rx_len)
+{
+    return i2c_op_write_read(op, address, NULL, 0, rx, rx_len);
+}
+
+/** @brief Fill a register read operation (register address written, one byte read after a repeated START). */
+static inline i2c_op_t *i2c_op_read_reg(i2c_op_t *op, uint16_t address, uint8_t reg, uint8_t *value)
+{
+    return i2c_op_write_read(op, address, &reg, 1, value, 1);
+}
+
+/** @brief Fill a register write operation. */
+static inline i2c_op_t *i2c_op_write_reg(i2c_op_t *op, uint16_t address, uint8_t reg, uint8_t value)
+{
+    uint8_t buffer[2] = {reg, value};
+    return i2c_op_write_read(op, address, buffer, 2, NULL, 0);
+}
+
+/**
+ * @brief Return the number of messages of an operation (1 or 2).
+ */
+static inline int i2c_op_nb_msg(const i2c_op_t *op)
+{
+    return ((op->tx_len > 0) || (op->rx_len == 0)) + (op->rx_len > 0);
+}
+
+/**
+ * @brief Add the messages of an operation to a message array.
+ * @return Number of messages added.
+ */
+static inline int i2c_op_messages(const i2c_op_t *op, struct i2c_msg *messages)
+{
+    int nb = 0;
+    if ((op->tx_len > 0) || (op->rx_len == 0)){ messages[nb++] = (struct i2c_msg){.addr = op->address, .flags = 0, .len = op->tx_len, .buf = op->tx};}
+    if (op->rx_len > 0){ messages[nb++] = (struct i2c_msg){.addr = op->address, .flags = I2C_M_RD, .len = op->rx_len, .buf = op->rx};}
+    return nb;
+}
+
+/**
+ * @brief Give an operation its status and call its completion function.
+ */
+static inline void i2c_op_complete(i2c_batch_t *batch, i2c_op_t *op, int status)
+{
+    op->status = status;
+    batch->nb_done++;
+    if (op->done){ op->done(op);}
+}
+
+/**
+ * @brief Initialize an empty batch.
+ * @param batch The batch.
+ * @param bus Bus of the operations (i2c_bus_get()).
+ */
+static inline void i2c_batch_init(i2c_batch_t *batch, i2c_bus_t *bus)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->bus = bus;
+}
+
+/**
+ * @brief Run the queued operations and empty the batch.
+ * @param batch The batch.
+ * @return 1 if every operation is done, -1 if at least one failed (see the status of each operation).
+ */
+static inline int i2c_batch_flush(i2c_batch_t *batch)
+{
+    struct i2c_msg messages[I2C_BATCH_MSG_MAX];
+    int result = 1;
+
+    for (int first = 0; first < batch->nb_op;)
+    {
+        /* as many whole operations as the ioctl accepts */
+        int nb_message = 0;
+        int last = first;
+        while ((last < batch->nb_op) && (nb_message + i2c_op_nb_msg(batch->op[last]) <= I2C_BATCH_MSG_MAX))
+        {
+            nb_message += i2c_op_messages(batch->op[last], &messages[nb_message]);
+            last++;
+        }
+
+        batch->nb_ioctl++;
+        if (i2c_bus_transfer(batch->bus, messages, nb_message) >= 0)
+        {
+            for (int i = first; i < last; i++){ i2c_op_complete(batch, batch->op[i], I2C_OP_DONE);}
+        }
+        else if (last - first == 1)
+        {
+            i2c_op_complete(batch, batch->op[first], I2C_OP_ERROR);
+            result = -1;
+        }
+        else
+        {
+            /* the failing message is unknown : run the operations alone */
+            for (int i = first; i < last; i++)
+            {
+                int nb = i2c_op_messages(batch->op[i], messages);
+                batch->nb_ioctl++;
+                batch->nb_replay++;
+                int ok = (i2c_bus_transfer(batch->bus, messages, nb) >= 0);
+                i2c_op_complete(batch, batch->op[i], ok ? I2C_OP_DONE : I2C_OP_ERROR);
+                if (!ok){ result = -1;}
+            }
+        }
+        first = last;
+    }
+    batch->nb_op = 0;
+    return result;
+}
+
+/**
+ * @brief Queue an operation filled with i2c_op_xxx(). The batch is flushed first when it is full.
+ * @param batch The batch.
+ * @param op The operation, valid until the flush.
+ * @return 1 on success, -1 if the automatic flush had a failed operation.
+ */
+static inline int i2c_batch_add(i2c_batch_t *batch, i2c_op_t *op)
+{
+    int result = 1;
+
+    if (batch->nb_op == I2C_BATCH_OP_MAX){ result = i2c_batch_flush(batch);}
+    op->status = I2C_OP_QUEUED;
+    batch->op[batch->nb_op++] = op;
+    return result;
+}
+
+#endif
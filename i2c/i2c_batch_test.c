@@ -0,0 +1,101 @@
+/**
+ * @brief This program checks the batched operations of i2c_batch.h on the simulated board of i2c_sim.h : packing of
+ *        several devices in one ioctl(I2C_RDWR), replay of a failed ioctl and split at the kernel message limit.
+
+ * @file i2c_batch_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -I. -I../PCF8591/header -I../PCF8574 -o i2c_batch_test i2c_batch_test.c ../PCF8591/header/PCF8591.c ../PCF8574/PCF8574.c i2c_bus.c -lm -pthread
+ *
+ * The program returns 0 when every check passes, 1 otherwise.
+ */
+
+/* Library */
+#include "PCF8591.h"
+#include "PCF8574.h"
+#include "i2c_sim.h"
+
+static i2c_sim_board_t board;
+static int nb_error = 0;
+
+/**
+ * @brief Display the result of a check and count the failures.
+ */
+void check(const char *name, int ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok){ nb_error++;}
+}
+
+/**
+ * @brief Return the PCF8591 code of a voltage.
+ */
+uint8_t code(double mv)
+{
+    return lround(mv * 255 / Vref);
+}
+
+int main(void)
+{
+    i2c_batch_t batch;
+    i2c_op_t op[6], many[100];
+    uint8_t data[PCF8591_NB_CHANNEL + 1], port, ghost, who, value[100];
+    int ok;
+
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ board.pcf8591.input_mv[i] = 500 + 700 * i;}
+    PCF8591_i2c_connect();
+    PCF8574_init();
+    i2c_bus_t *bus = i2c_bus_get("/dev/i2c-1");
+
+    /* three devices in one ioctl */
+    i2c_batch_init(&batch, bus);
+    pcf8591_batch_read_all(&batch, &pcf8591_default, &op[0], data);
+    PCF8574_batch_write(&batch, &op[1], 0x5A);
+    PCF8574_batch_read(&batch, &op[2], &port);
+    i2c_batch_add(&batch, i2c_op_read_reg(&op[3], 0x5F, 0x0F, &who));
+    pcf8591_batch_write_data(&batch, &pcf8591_default, &op[4], 200);
+    check("batch of 3 devices : flush", i2c_batch_flush(&batch) == 1);
+    check("batch of 3 devices : one ioctl", (batch.nb_ioctl == 1) && (batch.nb_replay == 0));
+    ok = 1;
+    for (int i = 0; i < 5; i++){ ok &= (op[i].status == I2C_OP_DONE);}
+    check("batch of 3 devices : every operation done", ok);
+    ok = 1;
+    for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ ok &= (data[i + 1] == code(500 + 700 * i));}
+    check("batch of 3 devices : PCF8591 inputs", ok);
+    check("batch of 3 devices : PCF8574 port written then read", (port == 0x5A) && (board.pcf8574.latch == 0x5A));
+    check("batch of 3 devices : HTS221 WHO_AM_I", who == 0xBC);
+    check("batch of 3 devices : PCF8591 DAC", board.pcf8591.dac == 200);
+
+    /* a device that doesn't answer : the ioctl fails, the operations are run again one by one */
+    i2c_batch_init(&batch, bus);
+    pcf8591_batch_read_all(&batch, &pcf8591_default, &op[0], data);
+    i2c_batch_add(&batch, i2c_op_read(&op[1], 0x50, &ghost, 1));
+    PCF8574_batch_read(&batch, &op[2], &port);
+    check("absent device : flush fails", i2c_batch_flush(&batch) == -1);
+    check("absent device : only its operation fails", (op[0].status == I2C_OP_DONE) && (op[1].status == I2C_OP_ERROR) && (op[2].status == I2C_OP_DONE));
+    check("absent device : one failed ioctl + 3 replays", (batch.nb_ioctl == 4) && (batch.nb_replay == 3));
+    check("absent device : data of the other devices", (data[1] == code(500)) && (port == 0x5A));
+
+    /* PCF8591 pending conversion left by the batch : the next single read is still right */
+    check("read after a batch", PCF8591_read_data(2) == code(1900));
+
+    /* 100 register reads : automatic flush at I2C_BATCH_OP_MAX, 21 operations (42 messages) per ioctl */
+    i2c_batch_init(&batch, bus);
+    memset(value, 0, sizeof(value));
+    for (int i = 0; i < 100; i++){ i2c_batch_add(&batch, i2c_op_read_reg(&many[i], 0x5F, 0x0F, &value[i]));}
+    check("100 operations : flush", i2c_batch_flush(&batch) == 1);
+    ok = 1;
+    for (int i = 0; i < 100; i++){ ok &= (value[i] == 0xBC) && (many[i].status == I2C_OP_DONE);}
+    check("100 operations : every operation done", ok);
+    int per_ioctl = I2C_BATCH_MSG_MAX / 2;
+    int nb_ioctl = (I2C_BATCH_OP_MAX + per_ioctl - 1) / per_ioctl + (100 - I2C_BATCH_OP_MAX + per_ioctl - 1) / per_ioctl;
+    check("100 operations : split at the message limit", batch.nb_ioctl == (unsigned long)nb_ioctl);
+
+    i2c_bus_put(bus);
+    printf("%s : %d failed check(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
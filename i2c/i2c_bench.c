@@ -0,0 +1,553 @@
+/**
+ * @brief This program measures every driver API of the repository (PCF8591, PCF8574, Sense HAT, SSD1306) on the
+ *        real I2C bus or on the simulated bus, and writes one JSON line per measurement.
+
+ * @file i2c_bench.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 with the boards, or none (simulated bus)
+ * compilation : gcc -Wall -O2 -I. -I../PCF8591/header -I../PCF8574 -I../Sense_HAT/code_c -I../joy-it/SSD1306-master/lib
+ *               -o i2c_bench i2c_bench.c ../PCF8591/header/PCF8591.c ../PCF8574/PCF8574.c i2c_bus.c -lm -pthread
+ *
+ * usage : ./i2c_bench [-b sim|linux] [-d /dev/i2c-1] [-c clock_hz] [-n iterations] [-f filter] [-o results.json]
+ *  - sim   : simulated board of i2c_sim.h, transactions timed with the bus clock (-c, 100 kHz by default, 0 = no latency).
+ *  - linux : /dev/i2c-N. A driver whose device doesn't answer is skipped. The LED matrix uses /dev/fb0 when it is the
+ *            Sense HAT framebuffer, a memory buffer otherwise.
+ *
+ * Every result line gives ops/s, the latency of one call (mean, p50, p99, max, log2 histogram in ns), and the calls
+ * made on the bus per operation : open / close / set_address / read / write / transfer of the transport, each one
+ * is a system call on i2c-dev, plus the usleep() of the drivers. On the simulated bus the counts are the system calls
+ * the same operation makes on the real bus.
+ *
+ * sensor_cycle reads the PCF8591 inputs, writes its DAC, writes and reads the PCF8574 port and reads the HTS221
+ * measurement registers with one call per operation, sensor_cycle_batched does the same in one batch (i2c_batch.h),
+ * sensor_cycle_async submits it to the worker thread of the bus (i2c_async.h) and waits for it on the eventfd.
+ *
+ * Built with -DI2C_TRACE, the bus accesses of the whole run are recorded per device and operation (i2c_trace.h) and
+ * written on stderr at the end, or at any time with "kill -USR1 <pid>".
+ *
+ * PCF8591_write_data_display_load measures the DAC write while another thread refreshes the SSD1306 without pause :
+ * the DAC is in the real-time class of the bus, the frames in the bulk class (i2c_bus.h). Its bus counts are those of
+ * the DAC writes only : the display thread has its own counters, written on stderr after the measurement with the
+ * waits of each class.
+ *
+ * The counting transport is the transport of the process (i2c_bus.c) : it sees the calls of every driver.
+ *
+ * @warning senseHat_humidity() waits 25 ms per call and SSD1306_UpdateScreen() sends 1 kB : their number of iterations
+ *          is divided by 20 and by 10.
+ */
+
+/* Library */
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Calls made on the transport and usleep() of the drivers, counted from several threads (async worker, display).
+ */
+typedef struct
+{
+    atomic_ulong nb_call;  ///< Operations (one system call each on i2c-dev).
+    atomic_ulong nb_byte;  ///< Bytes read and written.
+    atomic_ulong nb_sleep; ///< usleep() of the drivers.
+} bench_count_t;
+
+static bench_count_t bench_count;                  ///< counters of the measured operations
+static __thread bench_count_t *bench_thread_count; ///< counters of a load thread, NULL for bench_count
+
+static inline bench_count_t *bench_count_get(void)
+{
+    return bench_thread_count ? bench_thread_count : &bench_count;
+}
+
+static inline void bench_count_add(atomic_ulong *counter, unsigned long n)
+{
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+/* a function-like macro is not expanded again inside its own definition, so the real function is called */
+#define usleep(...) (bench_count_add(&bench_count_get()->nb_sleep, 1), usleep(__VA_ARGS__))
+
+/* bus of every driver, chosen at run time */
+static const char *bench_bus = "/dev/i2c-1";
+#define DEV_PATH bench_bus
+#define TWI_I2C_DEVICE bench_bus
+
+#include "Sense_hat.h" ///< before PCF8591.h : its "resolution" macro clashes with linux/input.h
+#include "PCF8591.h"
+#include "PCF8574.h"
+#include "i2c_sim.h"
+#include "ssd1306.c"
+#include "twi_linux.c"
+
+#define BENCH_ITERATION 1000 ///< Default number of calls of each measurement.
+#define BENCH_HIST_MAX 32    ///< log2 buckets of the latency histogram (1 ns to 2 s).
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                         Counting transport                                                   */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+/**
+ * @brief Transport measured : the calls are counted in the counters of the calling thread, then forwarded.
+ */
+typedef struct
+{
+    const i2c_transport_t *base; ///< Transport measured.
+} bench_counter_t;
+
+static bench_counter_t bench_counter;
+
+static int bench_open(void *ctx, const char *bus)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    return c->base->bus_open(c->base->ctx, bus);
+}
+
+static int bench_close(void *ctx, int fd)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    return c->base->bus_close(c->base->ctx, fd);
+}
+
+static int bench_set_address(void *ctx, int fd, uint16_t address)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    return c->base->set_address(c->base->ctx, fd, address);
+}
+
+static ssize_t bench_read(void *ctx, int fd, void *buffer, size_t size)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    bench_count_add(&bench_count_get()->nb_byte, size);
+    return c->base->bus_read(c->base->ctx, fd, buffer, size);
+}
+
+static ssize_t bench_write(void *ctx, int fd, const void *buffer, size_t size)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    bench_count_add(&bench_count_get()->nb_byte, size);
+    return c->base->bus_write(c->base->ctx, fd, buffer, size);
+}
+
+static int bench_transfer(void *ctx, int fd, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    bench_counter_t *c = ctx;
+    bench_count_add(&bench_count_get()->nb_call, 1);
+    for (unsigned int i = 0; i < nb_msg; i++){ bench_count_add(&bench_count_get()->nb_byte, messages[i].len);}
+    return c->base->transfer(c->base->ctx, fd, messages, nb_msg);
+}
+
+static const i2c_transport_t bench_transport = {
+    .name = "bench", .bus_open = bench_open, .bus_close = bench_close, .set_address = bench_set_address,
+    .bus_read = bench_read, .bus_write = bench_write, .transfer = bench_transfer, .ctx = &bench_counter};
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                              Measurement                                                     */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+static const char *bench_backend = "sim";
+static unsigned long bench_clock_hz = 100000;
+static const char *bench_filter = NULL;
+static FILE *bench_out;
+static const char *bench_fb = "memory";
+
+static i2c_sim_board_t board; ///< simulated board (sim backend)
+static int bench_sim_pixels[SENSE_HAT_NUM_WORDS];
+static unsigned int bench_channel;
+
+/**
+ * @brief Return the monotonic time in ns.
+ */
+static uint64_t bench_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Call an operation n times and write its result line.
+ * @param name Name of the measurement (name of the API).
+ * @param device Device used, for the result line.
+ * @param operation Operation measured.
+ * @param n Number of calls.
+ */
+static void bench_run(const char *name, const char *device, void (*operation)(void), int n)
+{
+    if (bench_filter && !strstr(name, bench_filter)){ return;}
+    if (n < 1){ n = 1;}
+
+    uint64_t *latency = malloc(n * sizeof(uint64_t));
+    if (latency == NULL){ printf("/!\\ Error : cannot allocate %d latencies.\n", n); return;}
+
+    operation(); ///< warm up : first open, caches of the drivers
+    atomic_store(&bench_count.nb_call, 0);
+    atomic_store(&bench_count.nb_byte, 0);
+    atomic_store(&bench_count.nb_sleep, 0);
+
+    uint64_t start = bench_time_ns();
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t t = bench_time_ns();
+        operation();
+        latency[i] = bench_time_ns() - t;
+    }
+    uint64_t elapsed = bench_time_ns() - start;
+
+    /* one snapshot of the counters for both outputs */
+    unsigned long nb_call = atomic_load(&bench_count.nb_call);
+    unsigned long nb_byte = atomic_load(&bench_count.nb_byte);
+    unsigned long nb_sleep = atomic_load(&bench_count.nb_sleep);
+
+    unsigned long hist[BENCH_HIST_MAX] = {0};
+    int nb_bucket = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int bucket = 0;
+        while ((bucket < BENCH_HIST_MAX - 1) && ((latency[i] >> (bucket + 1)) != 0)){ bucket++;}
+        hist[bucket]++;
+        if (bucket + 1 > nb_bucket){ nb_bucket = bucket + 1;}
+    }
+    qsort(latency, n, sizeof(uint64_t), bench_compare);
+
+    fprintf(bench_out, "{\"bench\":\"%s\",\"device\":\"%s\",\"backend\":\"%s\",\"bus\":\"%s\",\"clock_hz\":%lu,\"iterations\":%d,"
+            "\"ops_per_s\":%.1f,\"mean_ns\":%.0f,\"p50_ns\":%lu,\"p99_ns\":%lu,\"max_ns\":%lu,"
+            "\"bus_calls_per_op\":%.3f,\"sleeps_per_op\":%.3f,\"syscalls_per_op\":%.3f,\"bytes_per_op\":%.1f,\"hist_log2_ns\":[",
+            name, device, bench_backend, bench_bus, (strcmp(bench_backend, "sim") == 0) ? bench_clock_hz : 0, n,
+            n * 1e9 / elapsed, (double)elapsed / n, (unsigned long)latency[n / 2], (unsigned long)latency[(n * 99) / 100],
+            (unsigned long)latency[n - 1], (double)nb_call / n, (double)nb_sleep / n,
+            (double)(nb_call + nb_sleep) / n, (double)nb_byte / n);
+    for (int i = 0; i < nb_bucket; i++){ fprintf(bench_out, "%s%lu", i ? "," : "", hist[i]);}
+    fprintf(bench_out, "]}\n");
+    fflush(bench_out);
+
+    fprintf(stderr, "%-24s %10.0f ops/s  p50 %9lu ns  p99 %9lu ns  max %9lu ns  %5.2f syscalls/op\n", name, n * 1e9 / elapsed,
+            (unsigned long)latency[n / 2], (unsigned long)latency[(n * 99) / 100], (unsigned long)latency[n - 1],
+            (double)(nb_call + nb_sleep) / n);
+    free(latency);
+}
+
+/**
+ * @brief Write the result line of a measurement which can't run.
+ */
+static void bench_skip(const char *name, const char *device, const char *reason)
+{
+    if (bench_filter && !strstr(name, bench_filter)){ return;}
+    fprintf(bench_out, "{\"bench\":\"%s\",\"device\":\"%s\",\"backend\":\"%s\",\"bus\":\"%s\",\"skipped\":\"%s\"}\n",
+            name, device, bench_backend, bench_bus, reason);
+    fprintf(stderr, "%-24s skipped : %s\n", name, reason);
+}
+
+/**
+ * @brief Check that a device answers on the bus (one byte read).
+ * @return 1 if the device answers, 0 otherwise.
+ */
+static int bench_probe(uint16_t address)
+{
+    uint8_t data;
+    struct i2c_msg message = {.addr = address, .flags = I2C_M_RD, .len = 1, .buf = &data};
+
+    int fd = i2c_open(bench_bus);
+    if (fd < 0){ return 0;}
+    int present = (i2c_transfer(fd, &message, 1) >= 0);
+    i2c_close(fd);
+    return present;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                              Operations                                                      */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+static void op_pcf8591_read_data(void){ PCF8591_read_data(bench_channel++ % PCF8591_NB_CHANNEL);}
+static void op_pcf8591_read_voltage_mv(void){ PCF8591_read_voltage_mv(bench_channel++ % PCF8591_NB_CHANNEL);}
+static void op_pcf8591_write_data(void){ PCF8591_write_data(bench_channel++ & 0xFF);}
+
+static void op_pcf8574_read_data(void){ PCF8574_read_data();}
+static void op_pcf8574_digitalWrite(void){ PCF8574_digitalWrite(bench_channel & 0x07, (bench_channel >> 3) & 1); bench_channel++;}
+
+static void op_senseHat_humidity(void){ senseHat_humidity();}
+static void op_senseHat_setPixels(void){ senseHat_setPixels(bench_sim_pixels);}
+static void op_senseHat_getPixels(void){ senseHat_getPixels();}
+static void op_senseHat_flipR(void){ senseHat_flipR();}
+
+static void op_ssd1306_UpdateScreen(void){ SSD1306_UpdateScreen(SSD1306_ADDR);}
+static void op_ssd1306_DrawString(void){ SSD1306_SetPosition(0, 2); SSD1306_DrawString("SSD1306 OLED DRIVER");}
+static void op_ssd1306_DrawLine(void){ SSD1306_DrawLine(0, MAX_X, 0, MAX_Y - 1);}
+
+/* display load : frames sent by another thread during the measurement, counted apart */
+static atomic_int bench_display_running;
+static bench_count_t bench_display_count;
+static unsigned long bench_display_frames;
+
+static void *bench_display_thread(void *arg)
+{
+    (void)arg;
+    bench_thread_count = &bench_display_count;
+    bench_display_frames = 0;
+    while (atomic_load_explicit(&bench_display_running, memory_order_relaxed))
+    {
+        SSD1306_UpdateScreen(SSD1306_ADDR);
+        bench_display_frames++;
+    }
+    return NULL;
+}
+
+/* sensor cycle : PCF8591 inputs and DAC, PCF8574 port, HTS221 measurement registers */
+static i2c_bus_t *bench_i2c;
+static const uint8_t bench_hts221_reg[4] = {H_T_OUT_L, H_T_OUT_H, TEMP_OUT_L, TEMP_OUT_H};
+
+static void op_cycle(void)
+{
+    uint8_t data_in[PCF8591_NB_CHANNEL];
+
+    pcf8591_read_all_data(&pcf8591_default, data_in);
+    PCF8591_write_data(bench_channel & 0xFF);
+    PCF8574_write_data(bench_channel++ & 0xFF);
+    PCF8574_read_data();
+    for (int i = 0; i < 4; i++){ i2c_bus_read_reg(bench_i2c, DEV_ID, bench_hts221_reg[i]);}
+}
+
+static void op_cycle_batched(void)
+{
+    i2c_batch_t batch;
+    i2c_op_t op[8];
+    uint8_t data_in[PCF8591_NB_CHANNEL + 1], port, value[4];
+
+    i2c_batch_init(&batch, bench_i2c);
+    pcf8591_batch_read_all(&batch, &pcf8591_default, &op[0], data_in);
+    pcf8591_batch_write_data(&batch, &pcf8591_default, &op[1], bench_channel & 0xFF);
+    PCF8574_batch_write(&batch, &op[2], bench_channel++ & 0xFF);
+    PCF8574_batch_read(&batch, &op[3], &port);
+    for (int i = 0; i < 4; i++){ i2c_batch_add(&batch, i2c_op_read_reg(&op[4 + i], DEV_ID, bench_hts221_reg[i], &value[i]));}
+    i2c_batch_flush(&batch);
+}
+
+static i2c_async_t bench_async;
+
+static void op_cycle_async(void)
+{
+    i2c_op_t op[8], *done[8];
+    uint8_t data_in[PCF8591_NB_CHANNEL + 1], port, value[4];
+
+    pcf8591_async_read_all(&bench_async, &pcf8591_default, &op[0], data_in);
+    pcf8591_async_write_data(&bench_async, &pcf8591_default, &op[1], bench_channel & 0xFF);
+    PCF8574_async_write(&bench_async, &op[2], bench_channel++ & 0xFF);
+    PCF8574_async_read(&bench_async, &op[3], &port);
+    for (int i = 0; i < 4; i++)
+    {
+        i2c_op_read_reg(&op[4 + i], DEV_ID, bench_hts221_reg[i], &value[i])->post = 1;
+        i2c_async_submit(&bench_async, &op[4 + i]);
+    }
+    for (int nb = 0; nb < 8;){ nb += i2c_async_wait(&bench_async, done, 8, -1);}
+}
+
+/**
+ * @brief Send the printf() of the drivers to /dev/null, so that stdout only carries the result lines.
+ * @param quiet 1 to start, 0 to restore stdout.
+ */
+static void bench_quiet(int quiet)
+{
+    static int saved = -1;
+
+    fflush(stdout);
+    if (quiet && (saved < 0))
+    {
+        int null = open("/dev/null", O_WRONLY);
+        if (null < 0){ return;}
+        saved = dup(STDOUT_FILENO);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    else if (!quiet && (saved >= 0))
+    {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+        saved = -1;
+    }
+}
+
+/**
+ * @brief Check that the Sense HAT humidity sensor answers (WHO_AM_I register).
+ * @return 1 if the HTS221 answers, 0 otherwise.
+ */
+static int bench_probe_hts221(void)
+{
+    int fd = i2c_open(bench_bus);
+    if (fd < 0){ return 0;}
+    int present = (i2c_read_reg(fd, DEV_ID, WHO_AM_I) == 0xBC);
+    i2c_close(fd);
+    return present;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = BENCH_ITERATION;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:d:c:n:f:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': bench_backend = optarg; break;
+        case 'd': bench_bus = optarg; break;
+        case 'c': bench_clock_hz = strtoul(optarg, NULL, 0); break;
+        case 'n': n = atoi(optarg); break;
+        case 'f': bench_filter = optarg; break;
+        case 'o':
+            if ((bench_out = fopen(optarg, "w")) == NULL){ printf("/!\\ Error : cannot create %s.\n", optarg); return -1;}
+            break;
+        default:
+            printf("usage : %s [-b sim|linux] [-d /dev/i2c-1] [-c clock_hz] [-n iterations] [-f filter] [-o results.json]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    if (strcmp(bench_backend, "sim") == 0)
+    {
+        if (i2c_sim_board_init(&board, bench_bus) < 0){ return -1;}
+        if (bench_clock_hz){ i2c_sim_set_clock(&board.bus, bench_clock_hz);}
+        for (int i = 0; i < PCF8591_NB_CHANNEL; i++){ board.pcf8591.input_mv[i] = 800 * i + 400;}
+        bench_counter.base = i2c_transport;
+    }
+    else if (strcmp(bench_backend, "linux") == 0)
+    {
+        bench_counter.base = &i2c_transport_linux;
+    }
+    else
+    {
+        printf("/!\\ Error : backend %s not suported (sim or linux).\n", bench_backend);
+        return -1;
+    }
+    i2c_set_transport(&bench_transport);
+    if ((bench_out == NULL) && ((bench_out = fdopen(dup(STDOUT_FILENO), "w")) == NULL)){ return -1;} ///< kept when stdout is quiet
+    i2c_trace_dump_on_signal(SIGUSR1);
+    bench_quiet(1);
+
+    /* PCF8591 */
+    if (bench_probe(PCF8591_I2C_ADDR) && (pcf8591_open(&pcf8591_default, bench_bus, PCF8591_I2C_ADDR) > 0))
+    {
+        bench_run("PCF8591_read_data", "PCF8591", op_pcf8591_read_data, n);
+        bench_run("PCF8591_read_voltage_mv", "PCF8591", op_pcf8591_read_voltage_mv, n);
+        bench_run("PCF8591_write_data", "PCF8591", op_pcf8591_write_data, n);
+    }
+    else
+    {
+        bench_skip("PCF8591_read_data", "PCF8591", "no answer at 0x48");
+        bench_skip("PCF8591_read_voltage_mv", "PCF8591", "no answer at 0x48");
+        bench_skip("PCF8591_write_data", "PCF8591", "no answer at 0x48");
+    }
+
+    /* PCF8574 */
+    if (bench_probe(PCF8574_I2C_ADDR))
+    {
+        pcf8574_chip = (char *)bench_bus;
+        PCF8574_init();
+        bench_run("PCF8574_read_data", "PCF8574", op_pcf8574_read_data, n);
+        bench_run("PCF8574_digitalWrite", "PCF8574", op_pcf8574_digitalWrite, n);
+    }
+    else
+    {
+        bench_skip("PCF8574_read_data", "PCF8574", "no answer at 0x20");
+        bench_skip("PCF8574_digitalWrite", "PCF8574", "no answer at 0x20");
+    }
+
+    /* Sense HAT */
+    if (bench_probe_hts221())
+    {
+        bench_run("senseHat_humidity", "HTS221", op_senseHat_humidity, n / 20);
+    }
+    else
+    {
+        bench_skip("senseHat_humidity", "HTS221", "no answer at 0x5F");
+    }
+    if ((strcmp(bench_backend, "linux") == 0) && (access(SENSE_HAT_FILEPATH, F_OK) == 0) && (senseHat_init() == SENSE_HAT_SUCCESS))
+    {
+        bench_fb = SENSE_HAT_FILEPATH;
+    }
+    else
+    {
+        senseHat_init_memory(NULL);
+    }
+    for (int i = 0; i < SENSE_HAT_NUM_WORDS; i++){ bench_sim_pixels[i] = (i * 0x0841) & 0xFFFF;}
+    bench_run("senseHat_setPixels", bench_fb, op_senseHat_setPixels, n);
+    bench_run("senseHat_getPixels", bench_fb, op_senseHat_getPixels, n);
+    bench_run("senseHat_flipR", bench_fb, op_senseHat_flipR, n);
+
+    /* one cycle of the sensors, one call per device or one batch for the bus */
+    if (bench_probe(PCF8591_I2C_ADDR) && bench_probe(PCF8574_I2C_ADDR) && bench_probe_hts221() && ((bench_i2c = i2c_bus_get(bench_bus)) != NULL))
+    {
+        bench_run("sensor_cycle", "PCF8591+PCF8574+HTS221", op_cycle, n);
+        bench_run("sensor_cycle_batched", "PCF8591+PCF8574+HTS221", op_cycle_batched, n);
+        if (i2c_async_open(&bench_async, bench_bus) > 0)
+        {
+            bench_run("sensor_cycle_async", "PCF8591+PCF8574+HTS221", op_cycle_async, n);
+            i2c_async_close(&bench_async);
+        }
+        i2c_bus_put(bench_i2c);
+    }
+    else
+    {
+        bench_skip("sensor_cycle", "PCF8591+PCF8574+HTS221", "a device doesn't answer");
+        bench_skip("sensor_cycle_batched", "PCF8591+PCF8574+HTS221", "a device doesn't answer");
+        bench_skip("sensor_cycle_async", "PCF8591+PCF8574+HTS221", "a device doesn't answer");
+    }
+
+    /* SSD1306 */
+    if (bench_probe(SSD1306_ADDR) && (SSD1306_Init(SSD1306_ADDR) == SSD1306_SUCCESS))
+    {
+        SSD1306_ClearScreen();
+        bench_run("SSD1306_DrawString", "SSD1306", op_ssd1306_DrawString, n);
+        bench_run("SSD1306_DrawLine", "SSD1306", op_ssd1306_DrawLine, n);
+        bench_run("SSD1306_UpdateScreen", "SSD1306", op_ssd1306_UpdateScreen, n / 10);
+        if (bench_probe(PCF8591_I2C_ADDR))
+        {
+            pthread_t display;
+            atomic_store(&bench_display_running, 1);
+            if (pthread_create(&display, NULL, bench_display_thread, NULL) == 0)
+            {
+                bench_run("PCF8591_write_data_display_load", "PCF8591+SSD1306", op_pcf8591_write_data, n);
+                atomic_store(&bench_display_running, 0);
+                pthread_join(display, NULL);
+                fprintf(stderr, "display load : %lu frames, %lu bus calls, %lu bytes\n", bench_display_frames,
+                        atomic_load(&bench_display_count.nb_call), atomic_load(&bench_display_count.nb_byte));
+                i2c_bus_print_classes(twi_bus, stderr);
+            }
+        }
+        else
+        {
+            bench_skip("PCF8591_write_data_display_load", "PCF8591+SSD1306", "no answer at 0x48");
+        }
+        TWI_Close();
+    }
+    else
+    {
+        bench_skip("SSD1306_DrawString", "SSD1306", "no answer at 0x3C");
+        bench_skip("SSD1306_DrawLine", "SSD1306", "no answer at 0x3C");
+        bench_skip("SSD1306_UpdateScreen", "SSD1306", "no answer at 0x3C");
+        bench_skip("PCF8591_write_data_display_load", "PCF8591+SSD1306", "no answer at 0x3C");
+    }
+
+    bench_quiet(0);
+#ifdef I2C_TRACE
+    i2c_trace_dump(STDERR_FILENO);
+#endif
+    fclose(bench_out);
+    return 0;
+}
@@ -0,0 +1,36 @@
+/**
+ * @brief Process-wide state of the shared I2C buses
+ *
+ * @file i2c_bus.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ * compilation : add i2c_bus.c (from the i2c directory) to the gcc command line of every program using the drivers,
+ *               once, whatever the number of its translation units.
+ *
+ * The functions of i2c_transport.h and i2c_bus.h are inline, but the active transport, the registry of the buses, its
+ * lock, the class of each thread and the counters of i2c_trace.h are defined here, once per process : every
+ * translation unit (main program, drivers, the SSD1306 twi layer built as its own object, ...) runs on the same
+ * transport and gets the same descriptor, the same arbitration, the same slave cache and the same trace.
+ */
+
+#include "i2c_bus.h"
+
+const i2c_transport_t *i2c_transport = &i2c_transport_linux;
+
+i2c_bus_t i2c_buses[I2C_BUS_MAX];
+pthread_mutex_t i2c_buses_lock = PTHREAD_MUTEX_INITIALIZER;
+__thread int i2c_bus_thread_class = I2C_CLASS_INPUT;
+
+#ifdef I2C_TRACE
+_Atomic(i2c_trace_thread_t *) i2c_trace_threads = NULL;
+__thread i2c_trace_thread_t *i2c_trace_self = NULL;
+atomic_int i2c_trace_slot[128];
+atomic_int i2c_trace_address[I2C_TRACE_DEV_MAX];
+atomic_int i2c_trace_nb_slot = 0;
+pthread_mutex_t i2c_trace_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t i2c_trace_key;
+pthread_once_t i2c_trace_once = PTHREAD_ONCE_INIT;
+#endif
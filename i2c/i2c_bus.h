@@ -0,0 +1,502 @@
+/**
+ * @brief Shared I2C buses : one descriptor per adapter, cached slave address, serialized access
+ *
+ * @file i2c_bus.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ * compilation : add i2c_bus.c and -pthread to the gcc command line.
+ *
+ * The drivers (PCF8591.h, PCF8574.h, Sense_hat.h, the SSD1306 twi layer) don't open the bus themselves any more :
+ *  - i2c_bus_get() opens an adapter the first time it is asked for and returns the same bus to every driver after.
+ *    i2c_bus_put() closes it when its last user is gone.
+ *  - i2c_bus_read() / i2c_bus_write() take the slave address : the ioctl(I2C_SLAVE) is only made when the address
+ *    differs from the one already selected on the descriptor.
+ *  - i2c_bus_transfer() (ioctl I2C_RDWR) carries the address in every message, it never needs an ioctl(I2C_SLAVE).
+ *  - every access holds the bus, so the drivers can run in different threads. Without contention taking the bus
+ *    costs two short mutex sections and two clock_gettime() (vDSO), no system call.
+ *
+ * Priority classes : a thread accesses the bus in a class, I2C_CLASS_INPUT by default (i2c_bus_set_class()) :
+ *  - I2C_CLASS_RT    : DAC output and control loops (PCF8591 writes, PWM and loop threads).
+ *  - I2C_CLASS_INPUT : interactive input (ADC reads, PCF8574 port, sensors).
+ *  - I2C_CLASS_BULK  : display frames and logging (the SSD1306 twi layer).
+ * When the bus is released it goes to the highest class waiting, and a thread doesn't take a free bus while a
+ * higher class waits. A long bulk transfer is sent in pieces cut at message boundaries : between two pieces the
+ * holder calls i2c_bus_yield(), which lets the higher classes waiting go first. The wait of an RT access is then
+ * bounded by one piece (TWI_BULK_CHUNK bytes of the SSD1306 frame, about 3 ms at 100 kHz) instead of a whole frame.
+ *
+ * Each class of a bus counts its accesses, its wait for the bus (total, max, log2 histogram, waits longer than the
+ * deadline of the class) and the time it held the bus : i2c_bus_print_classes(). The yields are counted apart : an
+ * access which yields is still one access, the time it waits to take the bus back is in yield_ns, not in its wait.
+ *
+ * Built with -DI2C_TRACE, every access is also recorded per slave and per operation by i2c_trace.h.
+ *
+ * The registry of the buses and the class of each thread are defined once per process in i2c_bus.c : the drivers
+ * built in different translation units share the same bus, its lock and its slave cache.
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "i2c_transport.h"
+#include "i2c_trace.h"
+
+#ifndef I2C_BUS_MAX
+#define I2C_BUS_MAX 8 ///< Adapters open at the same time.
+#endif
+
+#define I2C_CLASS_RT 0    ///< Real-time : DAC output, control loops.
+#define I2C_CLASS_INPUT 1 ///< Interactive input : ADC, port, sensors (default class of a thread).
+#define I2C_CLASS_BULK 2  ///< Bulk : display frames, logging.
+#define I2C_CLASS_NB 3    ///< Number of classes.
+
+#ifndef I2C_BUS_DEADLINE_RT_NS
+#define I2C_BUS_DEADLINE_RT_NS 5000000ull     ///< Longest expected wait for the bus of the RT class (5 ms).
+#endif
+#ifndef I2C_BUS_DEADLINE_INPUT_NS
+#define I2C_BUS_DEADLINE_INPUT_NS 20000000ull ///< Longest expected wait for the bus of the INPUT class (20 ms).
+#endif
+#ifndef I2C_BUS_DEADLINE_BULK_NS
+#define I2C_BUS_DEADLINE_BULK_NS 0            ///< Longest expected wait for the bus of the BULK class (0 = none).
+#endif
+#define I2C_BUS_HIST_MAX 32 ///< log2 buckets of the wait histogram (1 ns to 2 s).
+
+/**
+ * @brief Accesses of one priority class on one bus.
+ */
+typedef struct
+{
+    unsigned long nb_lock;             ///< Accesses.
+    unsigned long nb_late;             ///< Waits longer than deadline_ns.
+    unsigned long nb_yield;            ///< Times the class gave the bus to a higher class (i2c_bus_yield()).
+    uint64_t yield_ns;                 ///< Total wait to take the bus back after a yield (not in wait_ns nor hold_ns).
+    uint64_t yield_max_ns;             ///< Longest wait to take the bus back after a yield.
+    uint64_t deadline_ns;              ///< Longest expected wait, 0 = no deadline (i2c_bus_set_deadline()).
+    uint64_t wait_ns;                  ///< Total wait for the bus.
+    uint64_t wait_max_ns;              ///< Longest wait for the bus.
+    uint64_t hold_ns;                  ///< Total time the bus was held.
+    uint64_t hold_max_ns;              ///< Longest time the bus was held.
+    unsigned long hist[I2C_BUS_HIST_MAX]; ///< Waits, bucket i = [2^i, 2^(i+1)[ ns.
+} i2c_bus_class_t;
+
+/**
+ * @brief One I2C adapter shared by the drivers.
+ */
+typedef struct
+{
+    char name[32];               ///< Bus device file ("/dev/i2c-1").
+    int fd;                      ///< Descriptor of the bus, -1 when the entry is free.
+    int nb_user;                 ///< Drivers using the bus.
+    int address;                 ///< Slave selected with ioctl(I2C_SLAVE), -1 when unknown.
+    pthread_mutex_t lock;        ///< Protects the arbitration state and the statistics (held shortly).
+    pthread_cond_t grant[I2C_CLASS_NB]; ///< Signals the waiters of a class that the bus is free.
+    int busy;                    ///< 1 while a thread holds the bus.
+    int owner_class;             ///< Class of the thread holding the bus.
+    uint64_t lock_ns;            ///< Time at which the bus was taken.
+    int nb_wait[I2C_CLASS_NB];   ///< Threads waiting for the bus, per class.
+    i2c_bus_class_t classes[I2C_CLASS_NB]; ///< Statistics per class.
+    unsigned long nb_select;     ///< ioctl(I2C_SLAVE) made.
+    unsigned long nb_select_hit; ///< ioctl(I2C_SLAVE) skipped, the address was already selected.
+} i2c_bus_t;
+
+/** @brief Class of the accesses of the calling thread (i2c_bus.c). */
+extern __thread int i2c_bus_thread_class;
+
+/**
+ * @brief Set the class of the bus accesses of the calling thread.
+ * @param priority I2C_CLASS_RT / I2C_CLASS_INPUT / I2C_CLASS_BULK.
+ * @return The previous class, to restore it.
+ */
+static inline int i2c_bus_set_class(int priority)
+{
+    int previous = i2c_bus_thread_class;
+    if ((priority >= 0) && (priority < I2C_CLASS_NB)){ i2c_bus_thread_class = priority;}
+    return previous;
+}
+
+/**
+ * @brief Return the CLOCK_MONOTONIC time in ns.
+ */
+static inline uint64_t i2c_bus_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/** @brief Buses of the process (i2c_bus.c). */
+extern i2c_bus_t i2c_buses[I2C_BUS_MAX];
+
+/** @brief Protects i2c_buses when a bus is opened or closed (i2c_bus.c). */
+extern pthread_mutex_t i2c_buses_lock;
+
+/**
+ * @brief Return the shared bus of an adapter, open it at the first call.
+ * @param name Bus device file ("/dev/i2c-1") or name of a simulated bus.
+ * @return The bus, NULL on error.
+ */
+static inline i2c_bus_t *i2c_bus_get(const char *name)
+{
+    i2c_bus_t *bus = NULL;
+
+    pthread_mutex_lock(&i2c_buses_lock);
+    for (int i = 0; i < I2C_BUS_MAX; i++)
+    {
+        if ((i2c_buses[i].nb_user > 0) && (strcmp(i2c_buses[i].name, name) == 0))
+        {
+            bus = &i2c_buses[i];
+            bus->nb_user++;
+            pthread_mutex_unlock(&i2c_buses_lock);
+            return bus;
+        }
+        if ((bus == NULL) && (i2c_buses[i].nb_user == 0)){ bus = &i2c_buses[i];}
+    }
+    if (bus == NULL)
+    {
+        pthread_mutex_unlock(&i2c_buses_lock);
+        printf("/!\\ Error : more than %d I2C buses open.\n", I2C_BUS_MAX);
+        return NULL;
+    }
+
+    int fd = i2c_open(name); ///< The i2c communication is initiated by opening a file.
+    if (fd < 0)
+    {
+        pthread_mutex_unlock(&i2c_buses_lock);
+        printf("Cannot initiate i2c connection on %s\n", name);
+        return NULL;
+    }
+    snprintf(bus->name, sizeof(bus->name), "%.31s", name);
+    bus->fd = fd;
+    bus->nb_user = 1;
+    bus->address = -1;
+    bus->nb_select = 0;
+    bus->nb_select_hit = 0;
+    bus->busy = 0;
+    memset(bus->nb_wait, 0, sizeof(bus->nb_wait));
+    memset(bus->classes, 0, sizeof(bus->classes));
+    bus->classes[I2C_CLASS_RT].deadline_ns = I2C_BUS_DEADLINE_RT_NS;
+    bus->classes[I2C_CLASS_INPUT].deadline_ns = I2C_BUS_DEADLINE_INPUT_NS;
+    bus->classes[I2C_CLASS_BULK].deadline_ns = I2C_BUS_DEADLINE_BULK_NS;
+    pthread_mutex_init(&bus->lock, NULL);
+    for (int c = 0; c < I2C_CLASS_NB; c++){ pthread_cond_init(&bus->grant[c], NULL);}
+    pthread_mutex_unlock(&i2c_buses_lock);
+    return bus;
+}
+
+/**
+ * @brief Release a bus returned by i2c_bus_get(), close it when its last user is gone.
+ * @param bus The bus (NULL is ignored).
+ */
+static inline void i2c_bus_put(i2c_bus_t *bus)
+{
+    if (bus == NULL){ return;}
+
+    pthread_mutex_lock(&i2c_buses_lock);
+    if ((bus->nb_user > 0) && (--bus->nb_user == 0))
+    {
+        i2c_close(bus->fd);
+        bus->fd = -1;
+        pthread_mutex_destroy(&bus->lock);
+        for (int c = 0; c < I2C_CLASS_NB; c++){ pthread_cond_destroy(&bus->grant[c]);}
+    }
+    pthread_mutex_unlock(&i2c_buses_lock);
+}
+
+/**
+ * @brief Check if a class higher than the given one waits for the bus. Called with bus->lock held.
+ */
+static inline int i2c_bus_higher_waiting(const i2c_bus_t *bus, int priority)
+{
+    for (int c = 0; c < priority; c++)
+    {
+        if (bus->nb_wait[c] > 0){ return 1;}
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait until a class can take the bus, then take it. Called with bus->lock held.
+ * @return Time at which the bus was taken.
+ */
+static inline uint64_t i2c_bus_acquire(i2c_bus_t *bus, int priority)
+{
+    if (bus->busy || i2c_bus_higher_waiting(bus, priority))
+    {
+        bus->nb_wait[priority]++;
+        do
+        {
+            pthread_cond_wait(&bus->grant[priority], &bus->lock);
+        } while (bus->busy || i2c_bus_higher_waiting(bus, priority));
+        bus->nb_wait[priority]--;
+    }
+    bus->busy = 1;
+    bus->owner_class = priority;
+    return i2c_bus_time_ns();
+}
+
+/**
+ * @brief Free the bus and wake the highest class waiting. Called with bus->lock held.
+ */
+static inline void i2c_bus_release(i2c_bus_t *bus)
+{
+    bus->busy = 0;
+    for (int c = 0; c < I2C_CLASS_NB; c++)
+    {
+        if (bus->nb_wait[c] > 0){ pthread_cond_signal(&bus->grant[c]); break;}
+    }
+}
+
+/**
+ * @brief Take the bus for several accesses in a row (the i2c_bus_xxx() functions take it for one access),
+ *        in the class of the calling thread.
+ * @param bus The bus.
+ */
+static inline void i2c_bus_lock(i2c_bus_t *bus)
+{
+    int priority = i2c_bus_thread_class;
+    uint64_t start_ns = i2c_bus_time_ns();
+
+    pthread_mutex_lock(&bus->lock);
+    bus->lock_ns = i2c_bus_acquire(bus, priority);
+
+    /* wait accounting */
+    i2c_bus_class_t *stat = &bus->classes[priority];
+    uint64_t wait_ns = bus->lock_ns - start_ns;
+    int bucket = 0;
+    while ((bucket < I2C_BUS_HIST_MAX - 1) && ((wait_ns >> (bucket + 1)) != 0)){ bucket++;}
+    stat->nb_lock++;
+    stat->wait_ns += wait_ns;
+    if (wait_ns > stat->wait_max_ns){ stat->wait_max_ns = wait_ns;}
+    if (stat->deadline_ns && (wait_ns > stat->deadline_ns)){ stat->nb_late++;}
+    stat->hist[bucket]++;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+/**
+ * @brief Give the bus back after i2c_bus_lock(), to the highest class waiting.
+ * @param bus The bus.
+ */
+static inline void i2c_bus_unlock(i2c_bus_t *bus)
+{
+    uint64_t hold_ns = i2c_bus_time_ns() - bus->lock_ns;
+
+    pthread_mutex_lock(&bus->lock);
+    i2c_bus_class_t *stat = &bus->classes[bus->owner_class];
+    stat->hold_ns += hold_ns;
+    if (hold_ns > stat->hold_max_ns){ stat->hold_max_ns = hold_ns;}
+    i2c_bus_release(bus);
+    pthread_mutex_unlock(&bus->lock);
+}
+
+/**
+ * @brief Preemption point of a long transfer : give the bus to the higher classes waiting, then take it again.
+ *        Call it between two messages of a bulk transfer, never inside a combined transaction.
+ *        The access goes on : its wait to take the bus back is counted in yield_ns, not as a new access, and the time
+ *        the bus was given away is not in its hold time.
+ * @param bus The bus, taken with i2c_bus_lock().
+ * @return 1 if the bus was given away, 0 if no higher class was waiting.
+ */
+static inline int i2c_bus_yield(i2c_bus_t *bus)
+{
+    pthread_mutex_lock(&bus->lock);
+    int priority = bus->owner_class;
+    if (!i2c_bus_higher_waiting(bus, priority)){ pthread_mutex_unlock(&bus->lock); return 0;}
+
+    uint64_t lock_ns = bus->lock_ns, start_ns = i2c_bus_time_ns();
+    i2c_bus_release(bus);
+    uint64_t wait_ns = i2c_bus_acquire(bus, priority) - start_ns;
+    bus->lock_ns = lock_ns + wait_ns; ///< the higher classes changed it
+
+    i2c_bus_class_t *stat = &bus->classes[priority];
+    stat->nb_yield++;
+    stat->yield_ns += wait_ns;
+    if (wait_ns > stat->yield_max_ns){ stat->yield_max_ns = wait_ns;}
+    pthread_mutex_unlock(&bus->lock);
+    return 1;
+}
+
+/**
+ * @brief Change the deadline of a class on a bus : the waits longer than it are counted in nb_late.
+ * @param bus The bus.
+ * @param priority I2C_CLASS_RT / I2C_CLASS_INPUT / I2C_CLASS_BULK.
+ * @param deadline_ns Longest expected wait for the bus, 0 = no deadline.
+ * @return 1 on success, -1 on a bad class.
+ */
+static inline int i2c_bus_set_deadline(i2c_bus_t *bus, int priority, uint64_t deadline_ns)
+{
+    if ((priority < 0) || (priority >= I2C_CLASS_NB)){ printf("/!\\ Error : unknown I2C priority class %d.\n", priority); return -1;}
+    pthread_mutex_lock(&bus->lock);
+    bus->classes[priority].deadline_ns = deadline_ns;
+    pthread_mutex_unlock(&bus->lock);
+    return 1;
+}
+
+/**
+ * @brief Copy the statistics of the classes of a bus.
+ * @param bus The bus.
+ * @param classes Array of I2C_CLASS_NB entries that will get the statistics.
+ */
+static inline void i2c_bus_get_classes(i2c_bus_t *bus, i2c_bus_class_t classes[I2C_CLASS_NB])
+{
+    pthread_mutex_lock(&bus->lock);
+    memcpy(classes, bus->classes, sizeof(bus->classes));
+    pthread_mutex_unlock(&bus->lock);
+}
+
+/**
+ * @brief Display the accesses, waits and hold times of each class of a bus.
+ * @param bus The bus.
+ * @param out Output stream (stdout, stderr, a log file).
+ */
+static inline void i2c_bus_print_classes(i2c_bus_t *bus, FILE *out)
+{
+    static const char *name[I2C_CLASS_NB] = {"rt", "input", "bulk"};
+    i2c_bus_class_t classes[I2C_CLASS_NB];
+
+    i2c_bus_get_classes(bus, classes);
+    for (int c = 0; c < I2C_CLASS_NB; c++)
+    {
+        i2c_bus_class_t *stat = &classes[c];
+        if (stat->nb_lock == 0){ continue;}
+        fprintf(out, "%s %-5s : %8lu accesses, wait mean %8.1f us max %8.1f us, late %lu (deadline %.1f ms), hold mean %8.1f us max %8.1f us, yield %lu (wait max %.1f us)\n",
+                bus->name, name[c], stat->nb_lock, stat->wait_ns / 1e3 / stat->nb_lock, stat->wait_max_ns / 1e3,
+                stat->nb_late, stat->deadline_ns / 1e6, stat->hold_ns / 1e3 / stat->nb_lock, stat->hold_max_ns / 1e3, stat->nb_yield,
+                stat->yield_max_ns / 1e3);
+    }
+}
+
+/**
+ * @brief Select the slave of the next read() / write(), without system call when it is already selected.
+ * @param bus The bus, taken with i2c_bus_lock().
+ * @param address 7 bit address of the slave.
+ * @return 0 on success, -1 on error.
+ */
+static inline int i2c_bus_select(i2c_bus_t *bus, uint16_t address)
+{
+    if (bus->address == address)
+    {
+        bus->nb_select_hit++;
+        return 0;
+    }
+    bus->nb_select++;
+    if (i2c_set_address(bus->fd, address) < 0)
+    {
+        bus->address = -1;
+        return -1;
+    }
+    bus->address = address;
+    return 0;
+}
+
+/**
+ * @brief Read bytes from a slave in one transaction.
+ * @param bus The bus.
+ * @param address 7 bit address of the slave.
+ * @param buffer Buffer that will get the data.
+ * @param size Number of bytes.
+ * @return Number of bytes read, -1 on error.
+ */
+static inline ssize_t i2c_bus_read(i2c_bus_t *bus, uint16_t address, void *buffer, size_t size)
+{
+    ssize_t result = -1;
+
+    i2c_bus_lock(bus);
+    if (i2c_bus_select(bus, address) == 0)
+    {
+        I2C_TRACE_BEGIN(start_ns);
+        result = i2c_read(bus->fd, buffer, size);
+        I2C_TRACE_END(start_ns, I2C_TRACE_READ, address, size, result < 0);
+    }
+    i2c_bus_unlock(bus);
+    return result;
+}
+
+/**
+ * @brief Write bytes to a slave in one transaction.
+ * @param bus The bus.
+ * @param address 7 bit address of the slave.
+ * @param buffer Data.
+ * @param size Number of bytes.
+ * @return Number of bytes written, -1 on error.
+ */
+static inline ssize_t i2c_bus_write(i2c_bus_t *bus, uint16_t address, const void *buffer, size_t size)
+{
+    ssize_t result = -1;
+
+    i2c_bus_lock(bus);
+    if (i2c_bus_select(bus, address) == 0)
+    {
+        I2C_TRACE_BEGIN(start_ns);
+        result = i2c_write(bus->fd, buffer, size);
+        I2C_TRACE_END(start_ns, I2C_TRACE_WRITE, address, size, result < 0);
+    }
+    i2c_bus_unlock(bus);
+    return result;
+}
+
+/**
+ * @brief Run messages in one combined transaction (ioctl I2C_RDWR) on a bus already taken with i2c_bus_lock().
+ * @param bus The bus, taken with i2c_bus_lock().
+ * @param messages Messages.
+ * @param nb_msg Number of messages.
+ * @return 0 or more on success, -1 on error.
+ */
+static inline int i2c_bus_transfer_locked(i2c_bus_t *bus, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    I2C_TRACE_BEGIN(start_ns);
+    int result = i2c_transfer(bus->fd, messages, nb_msg);
+    I2C_TRACE_TRANSFER_END(start_ns, messages, nb_msg, result < 0);
+    return result;
+}
+
+/**
+ * @brief Run messages in one combined transaction (ioctl I2C_RDWR), each message carries its slave address.
+ * @param bus The bus.
+ * @param messages Messages.
+ * @param nb_msg Number of messages.
+ * @return 0 or more on success, -1 on error.
+ */
+static inline int i2c_bus_transfer(i2c_bus_t *bus, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    i2c_bus_lock(bus);
+    int result = i2c_bus_transfer_locked(bus, messages, nb_msg);
+    i2c_bus_unlock(bus);
+    return result;
+}
+
+/**
+ * @brief Read a register of a slave (register address written, then one byte read after a repeated START).
+ * @return Register value, -1 on error.
+ */
+static inline int i2c_bus_read_reg(i2c_bus_t *bus, uint16_t address, uint8_t reg)
+{
+    i2c_bus_lock(bus);
+    I2C_TRACE_BEGIN(start_ns);
+    int result = i2c_read_reg(bus->fd, address, reg);
+    I2C_TRACE_END(start_ns, I2C_TRACE_READ_REG, address, 2, result < 0);
+    i2c_bus_unlock(bus);
+    return result;
+}
+
+/**
+ * @brief Write a register of a slave.
+ * @return 0 on success, -1 on error.
+ */
+static inline int i2c_bus_write_reg(i2c_bus_t *bus, uint16_t address, uint8_t reg, uint8_t value)
+{
+    i2c_bus_lock(bus);
+    I2C_TRACE_BEGIN(start_ns);
+    int result = i2c_write_reg(bus->fd, address, reg, value);
+    I2C_TRACE_END(start_ns, I2C_TRACE_WRITE_REG, address, 2, result < 0);
+    i2c_bus_unlock(bus);
+    return result;
+}
+
+#endif
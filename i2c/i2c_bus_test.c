@@ -0,0 +1,126 @@
+/**
+ * @brief This program checks the priority classes of i2c_bus.h on the simulated board of i2c_sim.h : PCF8591 DAC writes
+ *        of the real-time class while another thread sends SSD1306 frames in the bulk class, at 400 kHz.
+
+ * @file i2c_bus_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -I. -I../PCF8591/header -I../joy-it/SSD1306-master/lib -o i2c_bus_test i2c_bus_test.c ../PCF8591/header/PCF8591.c i2c_bus.c -lm -pthread
+ *
+ * The frames are cut in pieces and the DAC writes go between two pieces (i2c_bus_yield()) : the frames must reach the
+ * display intact, the real-time waits must stay under the deadline of the class, and the yields must not be counted
+ * as accesses of the bulk class. A block of DAC samples (pcf8591_write_block()) must be a bulk access too.
+ *
+ * The program returns 0 when every check passes, 1 otherwise.
+ */
+
+/* Library */
+#include "PCF8591.h"
+#include "i2c_sim.h"
+#include "ssd1306.c"
+#include "twi_linux.c"
+#include <stdatomic.h>
+
+#define NB_FRAME 20 ///< Frames sent under load.
+
+static i2c_sim_board_t board;
+static atomic_int display_running;
+static int nb_error = 0;
+
+/**
+ * @brief Display the result of a check and count the failures.
+ */
+void check(const char *name, int ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok){ nb_error++;}
+}
+
+/**
+ * @brief Check the waits of the real-time class : a wait is bounded by one piece of a frame, but the wakeups of a loaded
+ *        host can add some ms, so 1 % of the waits may pass the deadline. Without preemption most writes would wait
+ *        for a whole frame.
+ */
+int rt_on_time(const i2c_bus_class_t *rt)
+{
+    return (rt->nb_lock > 0) && (rt->nb_late * 100 <= rt->nb_lock) && (rt->wait_ns / rt->nb_lock < rt->deadline_ns / 4);
+}
+
+/**
+ * @brief Thread sending the frames.
+ */
+void *display(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < NB_FRAME; i++){ SSD1306_UpdateScreen(SSD1306_ADDR);}
+    atomic_store(&display_running, 0);
+    return NULL;
+}
+
+int main(void)
+{
+    i2c_bus_class_t before[I2C_CLASS_NB], after[I2C_CLASS_NB];
+    pthread_t thread;
+    unsigned long nb_write = 0;
+    uint8_t dac = 0;
+
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    i2c_sim_set_clock(&board.bus, 400000);
+    PCF8591_i2c_connect();
+    if (SSD1306_Init(SSD1306_ADDR) != SSD1306_SUCCESS){ printf("FAIL SSD1306 init\n"); return 1;}
+    SSD1306_ClearScreen();
+    SSD1306_DrawLine(0, MAX_X, 0, MAX_Y - 1);
+
+    /* accesses of one frame alone */
+    i2c_bus_get_classes(twi_bus, before);
+    SSD1306_UpdateScreen(SSD1306_ADDR);
+    i2c_bus_get_classes(twi_bus, after);
+    unsigned long per_frame = after[I2C_CLASS_BULK].nb_lock - before[I2C_CLASS_BULK].nb_lock;
+    check("one frame alone : no yield", after[I2C_CLASS_BULK].nb_yield == before[I2C_CLASS_BULK].nb_yield);
+
+    /* a block of DAC samples is a bulk access, not a real-time one */
+    uint8_t samples[3 * PCF8591_BULK_CHUNK + 5];
+    for (size_t i = 0; i < sizeof(samples); i++){ samples[i] = i;}
+    i2c_bus_get_classes(twi_bus, before);
+    check("DAC block : written", pcf8591_write_block(&pcf8591_default, samples, sizeof(samples)) == (int)sizeof(samples));
+    i2c_bus_get_classes(twi_bus, after);
+    check("DAC block : last sample latched", board.pcf8591.dac == samples[sizeof(samples) - 1]);
+    check("DAC block : one bulk access, no real-time one", (after[I2C_CLASS_BULK].nb_lock == before[I2C_CLASS_BULK].nb_lock + 1) && (after[I2C_CLASS_RT].nb_lock == before[I2C_CLASS_RT].nb_lock));
+
+    /* frames under DAC writes */
+    before[I2C_CLASS_BULK] = after[I2C_CLASS_BULK];
+    atomic_store(&display_running, 1);
+    pthread_create(&thread, NULL, display, NULL);
+    while (atomic_load(&display_running))
+    {
+        PCF8591_write_data(++dac);
+        nb_write++;
+        usleep(500);
+    }
+    pthread_join(thread, NULL);
+    i2c_bus_get_classes(twi_bus, after);
+
+    int intact = 1;
+    for (int y = 0; y < MAX_Y; y++)
+    {
+        for (int x = 0; x <= MAX_X; x++)
+        {
+            intact &= (i2c_sim_ssd1306_pixel(&board.ssd1306, x, y) == ((cacheMemLcd[(y / 8) * (MAX_X + 1) + x] >> (y % 8)) & 1));
+        }
+    }
+    check("frames : pixels intact", intact);
+    check("DAC : last value written", board.pcf8591.dac == dac);
+    check("RT : accesses counted", after[I2C_CLASS_RT].nb_lock >= nb_write);
+    check("RT : waits under the deadline", rt_on_time(&after[I2C_CLASS_RT]));
+    check("bulk : the frames gave the bus away", after[I2C_CLASS_BULK].nb_yield > before[I2C_CLASS_BULK].nb_yield);
+    check("bulk : yields not counted as accesses", after[I2C_CLASS_BULK].nb_lock - before[I2C_CLASS_BULK].nb_lock == NB_FRAME * per_frame);
+    check("bulk : wait after the yields counted apart", after[I2C_CLASS_BULK].yield_ns > 0);
+    i2c_bus_print_classes(twi_bus, stdout);
+
+    TWI_Close();
+    printf("%s : %d failed check(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * @brief This program checks the shared bus of i2c_bus.h when the drivers are built as separate objects, like the
+ *        documented SSD1306 build (main.c lib/ssd1306.c lib/twi.c lib/twi_linux.c) : one transport, one registry.
+
+ * @file i2c_multi_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -I. -I../PCF8591/header -I../joy-it/SSD1306-master/lib -o i2c_multi_test i2c_multi_test.c
+ *               ../joy-it/SSD1306-master/lib/ssd1306.c ../joy-it/SSD1306-master/lib/twi.c
+ *               ../joy-it/SSD1306-master/lib/twi_linux.c ../PCF8591/header/PCF8591.c i2c_bus.c -lm -pthread
+ *
+ * This file holds the simulated board and the PCF8591, the display is driven by the SSD1306 library built in its
+ * own translation units : the simulated transport selected here must reach it, and both must get the same bus.
+ * Then a thread sends frames while this unit writes the DAC at 400 kHz : the real-time writes must preempt the frames
+ * of the other unit (i2c_bus_yield()) and wait less than the deadline of their class.
+ *
+ * The program returns 0 when every check passes, 1 otherwise.
+ */
+
+/* Library */
+#include "PCF8591.h"
+#include "i2c_sim.h"
+#include "ssd1306.h"
+#include <stdatomic.h>
+
+#define NB_FRAME 10 ///< Frames sent under load.
+
+static i2c_sim_board_t board;
+static atomic_int display_running;
+static int nb_error = 0;
+
+/**
+ * @brief Display the result of a check and count the failures.
+ */
+void check(const char *name, int ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok){ nb_error++;}
+}
+
+/**
+ * @brief Row of the pixel drawn in a column : one pixel per column, on every page.
+ */
+int pattern_y(int x)
+{
+    return (x * 7) % MAX_Y;
+}
+
+/**
+ * @brief Check that the display shows the pattern and nothing else.
+ */
+int pattern_shown(void)
+{
+    int ok = 1;
+    for (int x = 0; x <= MAX_X; x++)
+    {
+        for (int y = 0; y < MAX_Y; y++){ ok &= (i2c_sim_ssd1306_pixel(&board.ssd1306, x, y) == (y == pattern_y(x)));}
+    }
+    return ok;
+}
+
+/**
+ * @brief Check the waits of the real-time class : a wait is bounded by one piece of a frame, but the wakeups of a loaded
+ *        host can add some ms, so 1 % of the waits may pass the deadline. Without preemption most writes would wait
+ *        for a whole frame.
+ */
+int rt_on_time(const i2c_bus_class_t *rt)
+{
+    return (rt->nb_lock > 0) && (rt->nb_late * 100 <= rt->nb_lock) && (rt->wait_ns / rt->nb_lock < rt->deadline_ns / 4);
+}
+
+/**
+ * @brief Thread sending the frames.
+ */
+void *display(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < NB_FRAME; i++){ SSD1306_UpdateScreen(SSD1306_ADDR);}
+    atomic_store(&display_running, 0);
+    return NULL;
+}
+
+int main(void)
+{
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    PCF8591_i2c_connect();
+    check("SSD1306 : init through the simulated transport", SSD1306_Init(SSD1306_ADDR) == SSD1306_SUCCESS);
+
+    /* one registry : the PCF8591 and the twi layer share one bus */
+    int nb_open = 0, nb_user = 0;
+    pthread_mutex_lock(&i2c_buses_lock);
+    for (int i = 0; i < I2C_BUS_MAX; i++)
+    {
+        if (i2c_buses[i].nb_user > 0){ nb_open++; nb_user = i2c_buses[i].nb_user;}
+    }
+    pthread_mutex_unlock(&i2c_buses_lock);
+    check("registry : one bus open, used by both drivers", (nb_open == 1) && (nb_user == 2));
+    i2c_bus_t *bus = i2c_bus_get("/dev/i2c-1");
+    check("registry : same descriptor", (bus != NULL) && (bus->fd == pcf8591_default.i2c->fd) && (bus == pcf8591_default.i2c));
+
+    /* a frame of the other translation unit reaches the simulated display */
+    SSD1306_ClearScreen();
+    for (int x = 0; x <= MAX_X; x++){ SSD1306_DrawPixel(x, pattern_y(x));}
+    check("SSD1306 : frame sent", SSD1306_UpdateScreen(SSD1306_ADDR) == SSD1306_SUCCESS);
+    check("SSD1306 : frame on the display", pattern_shown());
+
+    /* the accesses of both units are in the statistics of the same bus */
+    i2c_bus_class_t classes[I2C_CLASS_NB], before[I2C_CLASS_NB];
+    PCF8591_write_data(128);
+    i2c_bus_get_classes(bus, classes);
+    check("DAC : written", board.pcf8591.dac == 128);
+    check("classes : DAC and display on the same bus", (classes[I2C_CLASS_RT].nb_lock > 0) && (classes[I2C_CLASS_BULK].nb_lock > 0));
+
+    /* DAC writes of this unit during the frames of the other one */
+    pthread_t thread;
+    uint8_t dac = 0;
+    i2c_sim_set_clock(&board.bus, 400000);
+    i2c_bus_get_classes(bus, before);
+    atomic_store(&display_running, 1);
+    pthread_create(&thread, NULL, display, NULL);
+    while (atomic_load(&display_running))
+    {
+        PCF8591_write_data(++dac);
+        usleep(500);
+    }
+    pthread_join(thread, NULL);
+    i2c_bus_get_classes(bus, classes);
+    check("under load : frames intact", pattern_shown());
+    check("under load : last DAC value", board.pcf8591.dac == dac);
+    check("under load : the frames gave the bus to the DAC", classes[I2C_CLASS_BULK].nb_yield > before[I2C_CLASS_BULK].nb_yield);
+    check("under load : RT waits under the deadline", rt_on_time(&classes[I2C_CLASS_RT]));
+    i2c_bus_print_classes(bus, stdout);
+
+    i2c_bus_put(bus);
+    TWI_Close();
+    printf("%s : %d failed check(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @brief USDT probes of the drivers (perf, bpftrace, SystemTap)
+ *
+ * @file i2c_probe.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (aarch64 / armv7) or a PC (x86), gcc or clang.
+ * compilation : nothing to add, -DI2C_PROBE_DISABLE removes the probes.
+ *
+ * A probe is a "nop" instruction at the probe site, described in an ELF note (.note.stapsdt) with its provider, its
+ * name and where its arguments are (registers, stack, constants) : the format of <sys/sdt.h>, written here directly
+ * so the probes don't need the systemtap-sdt-dev package at build time. Each probe also has a semaphore (section
+ * .probes) that the tracer increments while it is attached : the probe and the reading of its timestamps are in a
+ * branch taken only then. Not attached, a probe costs one load and one branch not taken, no system call.
+ *
+ * The probes of the drivers all have the same arguments :
+ *  - arg0 : 7 bit I2C address of the device.
+ *  - arg1 : number of bytes on the bus (0 when the access was skipped by a cache).
+ *  - arg2 : CLOCK_MONOTONIC time at the start of the function, in ns (the clock of bpftrace nsecs).
+ *  - arg3 : CLOCK_MONOTONIC time at the end of the function, in ns.
+ *  - arg4 : value of the probe (channel, data, result, see the driver).
+ * They are fired at the end of the function. sensehat:set_pixels writes the framebuffer, not the bus : arg0 and arg1
+ * are 0.
+ *
+ * Probes : pcf8591:select_channel, pcf8591:read_data, pcf8591:write_data, pcf8574:read_data, pcf8574:write_data,
+ *          sensehat:set_pixels, ssd1306:update_screen.
+ *
+ * Examples :
+ *   bpftrace -e 'usdt:./app:pcf8591:read_data { @us[arg0] = hist((arg3 - arg2) / 1000); }'
+ *   perf probe -x ./app sdt_ssd1306:update_screen && perf record -e sdt_ssd1306:update_screen -e sched:sched_switch ...
+ *
+ * @warning The tracer must handle the USDT semaphores (bpftrace, perf with a 4.20 or newer kernel, SystemTap),
+ *          otherwise the probes are never reached. On 32 bit targets the timestamps are truncated to 32 bits.
+ */
+
+#ifndef I2C_PROBE_H
+#define I2C_PROBE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__GNUC__) && !defined(I2C_PROBE_DISABLE) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__))
+
+#if __SIZEOF_POINTER__ == 8
+#define I2C_PROBE_ASM_ADDR ".8byte"
+#else
+#define I2C_PROBE_ASM_ADDR ".4byte"
+#endif
+#if __SIZEOF_LONG__ == 8
+#define I2C_PROBE_ARG(n) "-8@%[a" #n "]" ///< signed 8 byte argument
+#else
+#define I2C_PROBE_ARG(n) "-4@%[a" #n "]" ///< signed 4 byte argument
+#endif
+
+/**
+ * @brief Declare the semaphore of a probe, once per translation unit, before the probe sites.
+ */
+#define I2C_PROBE_DEFINE(provider, name) \
+    __extension__ static volatile unsigned short provider##_##name##_semaphore __attribute__((used, section(".probes")))
+
+/**
+ * @brief Check if a tracer is attached to a probe.
+ */
+#define I2C_PROBE_ACTIVE(provider, name) __builtin_expect(provider##_##name##_semaphore != 0, 0)
+
+/**
+ * @brief Probe site with five arguments : nop + .note.stapsdt entry (format of <sys/sdt.h>).
+ */
+#define I2C_PROBE5(provider, name, arg0, arg1, arg2, arg3, arg4) \
+    __asm__ __volatile__ ( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: " I2C_PROBE_ASM_ADDR " 990b\n" \
+        I2C_PROBE_ASM_ADDR " _.stapsdt.base\n" \
+        I2C_PROBE_ASM_ADDR " " #provider "_" #name "_semaphore\n" \
+        ".asciz \"" #provider "\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"" I2C_PROBE_ARG(0) " " I2C_PROBE_ARG(1) " " I2C_PROBE_ARG(2) " " I2C_PROBE_ARG(3) " " I2C_PROBE_ARG(4) "\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        : \
+        : [a0] "nor" ((long)(arg0)), [a1] "nor" ((long)(arg1)), [a2] "nor" ((long)(arg2)), \
+          [a3] "nor" ((long)(arg3)), [a4] "nor" ((long)(arg4)))
+
+#else
+
+#define I2C_PROBE_DEFINE(provider, name) struct i2c_probe_unused
+#define I2C_PROBE_ACTIVE(provider, name) 0
+#define I2C_PROBE5(provider, name, arg0, arg1, arg2, arg3, arg4) \
+    do { (void)(arg0); (void)(arg1); (void)(arg2); (void)(arg3); (void)(arg4); } while (0)
+
+#endif
+
+/**
+ * @brief Return the CLOCK_MONOTONIC time in ns (timestamps of the probes).
+ */
+static inline uint64_t i2c_probe_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Start of a probed function : declares its start time, read only when a tracer is attached.
+ */
+#define I2C_PROBE_BEGIN(provider, name, start) \
+    uint64_t start = I2C_PROBE_ACTIVE(provider, name) ? i2c_probe_time_ns() : 0
+
+/**
+ * @brief End of a probed function : fire the probe (address, bytes, start, end, value) when a tracer is attached.
+ */
+#define I2C_PROBE_END(provider, name, start, address, bytes, value) \
+    do \
+    { \
+        if (I2C_PROBE_ACTIVE(provider, name)) \
+        { \
+            I2C_PROBE5(provider, name, (address), (bytes), (start), i2c_probe_time_ns(), (value)); \
+        } \
+    } while (0)
+
+#endif
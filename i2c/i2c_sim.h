@@ -0,0 +1,798 @@
+/**
+ * @brief Simulated I2C bus with behavioral models of the PCF8591, PCF8574, HTS221 and SSD1306
+
+ * @file i2c_sim.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none, any Linux computer.
+ * compilation : add -pthread to the gcc command line.
+ *
+ * i2c_transport_sim replaces the Linux i2c-dev transport of i2c_transport.h : the drivers open a simulated bus by
+ * its name ("/dev/i2c-1") and their transactions are run, byte by byte, on the device models attached to it.
+ * Each model sees the START / repeated START, the bytes and the STOP like the real chip :
+ *  - PCF8591 : control byte, conversion returned one read later, auto-increment, input modes, DAC output latch.
+ *  - PCF8574 : quasi-bidirectional port, a pin reads low when written low or pulled low from outside.
+ *  - HTS221  : register file with auto-increment, calibration registers, one-shot conversion and status bits.
+ *  - SSD1306 : control bytes (Co, D/C), commands with their arguments, addressing modes and GDDRAM.
+ *
+ * A transaction takes I2C_SIM clock time : a fixed time per message (START, address, STOP) and a time per byte,
+ * set by i2c_sim_set_latency() or i2c_sim_set_clock() (0 by default : as fast as possible). A bus runs one
+ * transaction at a time, like a real bus.
+ *
+ * The simulated buses live in the translation unit which includes this file (the main program) : the drivers built
+ * in other units reach them through the transport of the process (i2c_bus.c).
+ *
+ * Basic usage is:
+ * ```c
+ * static i2c_sim_board_t board;
+ * i2c_sim_board_init(&board, "/dev/i2c-1");  // bus with the 4 models at their default addresses, transport selected
+ * PCF8591_i2c_connect();                      // the drivers now talk to the models
+ * ```
+ */
+
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include "i2c_transport.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#define I2C_SIM_BUS_MAX 8 ///< Simulated buses.
+#define I2C_SIM_DEVICE_MAX 16 ///< Devices on one simulated bus.
+#define I2C_SIM_HANDLE_MAX 64 ///< Simulated buses open at the same time.
+#define I2C_SIM_FD_BASE 1000 ///< First descriptor given to a simulated bus (out of the range of the real files).
+
+typedef struct i2c_sim_device i2c_sim_device_t;
+
+/**
+ * @brief Device model : byte level interface of a slave.
+ */
+struct i2c_sim_device
+{
+    uint16_t address;                                     ///< 7 bit address.
+    const char *name;                                     ///< Model name.
+    void (*on_start)(i2c_sim_device_t *dev, int read);    ///< START or repeated START addressed to the device.
+    int (*on_write)(i2c_sim_device_t *dev, uint8_t data); ///< Byte received, return 1 for ACK and 0 for NACK.
+    uint8_t (*on_read)(i2c_sim_device_t *dev);            ///< Byte sent to the master.
+    void (*on_stop)(i2c_sim_device_t *dev);               ///< End of the transaction for the device (STOP or START to another slave).
+};
+
+/**
+ * @brief Simulated bus.
+ */
+typedef struct
+{
+    char name[32];                                  ///< Name opened by the drivers ("/dev/i2c-1").
+    i2c_sim_device_t *devices[I2C_SIM_DEVICE_MAX];  ///< Devices attached.
+    int nb_device;                                  ///< Number of devices.
+    uint64_t message_ns;                            ///< Time of a message besides its data bytes (START, address, STOP).
+    uint64_t byte_ns;                               ///< Time of a data byte.
+    pthread_mutex_t lock;                           ///< One transaction at a time.
+    unsigned long nb_transaction;                   ///< Transactions run (read, write or combined).
+    unsigned long nb_message;                       ///< Messages run.
+    unsigned long nb_byte;                          ///< Data bytes moved.
+    unsigned long nb_nack;                          ///< Transactions ended by a NACK.
+} i2c_sim_bus_t;
+
+/** @brief Simulated buses, by name. */
+static i2c_sim_bus_t *i2c_sim_buses[I2C_SIM_BUS_MAX];
+
+/** @brief Simulated buses open : bus and slave selected by i2c_set_address(). */
+static struct { i2c_sim_bus_t *bus; uint16_t address; } i2c_sim_handles[I2C_SIM_HANDLE_MAX];
+
+static inline uint64_t i2c_sim_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Create a simulated bus.
+ * @param bus The bus.
+ * @param name Name the drivers will open ("/dev/i2c-1").
+ * @return 1 on success, -1 if there are too many buses.
+ */
+static inline int i2c_sim_bus_init(i2c_sim_bus_t *bus, const char *name)
+{
+    for (int i = 0; i < I2C_SIM_BUS_MAX; i++)
+    {
+        if ((i2c_sim_buses[i] == NULL) || (i2c_sim_buses[i] == bus))
+        {
+            memset(bus, 0, sizeof(*bus));
+            snprintf(bus->name, sizeof(bus->name), "%s", name);
+            pthread_mutex_init(&bus->lock, NULL);
+            i2c_sim_buses[i] = bus;
+            return 1;
+        }
+    }
+    printf("/!\\ Error : too many simulated buses.\n");
+    return -1;
+}
+
+/**
+ * @brief Attach a device model to a simulated bus.
+ * @param bus The bus.
+ * @param dev The device (first member of a model).
+ * @return 1 on success, -1 if the bus is full or the address is used.
+ */
+static inline int i2c_sim_attach(i2c_sim_bus_t *bus, i2c_sim_device_t *dev)
+{
+    for (int i = 0; i < bus->nb_device; i++)
+    {
+        if (bus->devices[i]->address == dev->address){ printf("/!\\ Error : address 0x%x already used on %s.\n", dev->address, bus->name); return -1;}
+    }
+    if (bus->nb_device >= I2C_SIM_DEVICE_MAX){ printf("/!\\ Error : too many devices on %s.\n", bus->name); return -1;}
+    bus->devices[bus->nb_device++] = dev;
+    return 1;
+}
+
+/**
+ * @brief Set the time taken by the transactions of a bus.
+ * @param bus The bus.
+ * @param message_ns Time of each message besides its data bytes (START, address, STOP).
+ * @param byte_ns Time of each data byte.
+ */
+static inline void i2c_sim_set_latency(i2c_sim_bus_t *bus, uint64_t message_ns, uint64_t byte_ns)
+{
+    bus->message_ns = message_ns;
+    bus->byte_ns = byte_ns;
+}
+
+/**
+ * @brief Set the time taken by the transactions of a bus from its clock : 9 cycles per byte, 11 per message
+ * (START, address byte, STOP).
+ * @param bus The bus.
+ * @param clock_hz SCL frequency (100000, 400000...), 0 for no delay.
+ */
+static inline void i2c_sim_set_clock(i2c_sim_bus_t *bus, unsigned long clock_hz)
+{
+    if (clock_hz == 0){ i2c_sim_set_latency(bus, 0, 0); return;}
+    i2c_sim_set_latency(bus, 11000000000ull / clock_hz, 9000000000ull / clock_hz);
+}
+
+static inline i2c_sim_device_t *i2c_sim_find(i2c_sim_bus_t *bus, uint16_t address)
+{
+    for (int i = 0; i < bus->nb_device; i++)
+    {
+        if (bus->devices[i]->address == address){ return bus->devices[i];}
+    }
+    return NULL;
+}
+
+static inline i2c_sim_bus_t *i2c_sim_handle(int fd)
+{
+    int handle = fd - I2C_SIM_FD_BASE;
+    if ((handle < 0) || (handle >= I2C_SIM_HANDLE_MAX) || (i2c_sim_handles[handle].bus == NULL)){ errno = EBADF; return NULL;}
+    return i2c_sim_handles[handle].bus;
+}
+
+/**
+ * @brief Run a combined transaction on a simulated bus, then wait for the time the real bus would take.
+ * @return 0 on success, -1 with errno = ENXIO when a slave doesn't answer (NACK).
+ */
+static inline int i2c_sim_run(i2c_sim_bus_t *bus, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    uint64_t start_ns = i2c_sim_time_ns(), nb_byte = 0;
+    i2c_sim_device_t *current = NULL;
+    int result = 0;
+
+    pthread_mutex_lock(&bus->lock);
+    for (unsigned int m = 0; (m < nb_msg) && (result == 0); m++)
+    {
+        i2c_sim_device_t *dev = i2c_sim_find(bus, messages[m].addr);
+        if ((current != NULL) && (current != dev)){ current->on_stop(current);} ///< repeated START to another slave
+        current = dev;
+        if (dev == NULL){ result = -1; break;} ///< address not acknowledged
+
+        int read = messages[m].flags & I2C_M_RD;
+        dev->on_start(dev, read);
+        for (int i = 0; i < messages[m].len; i++)
+        {
+            if (read){ messages[m].buf[i] = dev->on_read(dev);}
+            else if (!dev->on_write(dev, messages[m].buf[i])){ result = -1; break;} ///< data not acknowledged
+        }
+        nb_byte += messages[m].len;
+    }
+    if (current != NULL){ current->on_stop(current);}
+
+    bus->nb_transaction++;
+    bus->nb_message += nb_msg;
+    bus->nb_byte += nb_byte;
+    if (result < 0){ bus->nb_nack++;}
+
+    /* the bus is held for the time of the transaction */
+    uint64_t busy_ns = nb_msg * bus->message_ns + nb_byte * bus->byte_ns;
+    if (busy_ns > 0)
+    {
+        uint64_t end_ns = start_ns + busy_ns;
+        struct timespec deadline = {.tv_sec = end_ns / 1000000000ull, .tv_nsec = end_ns % 1000000000ull};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR){}
+    }
+    pthread_mutex_unlock(&bus->lock);
+
+    if (result < 0){ errno = ENXIO;}
+    return result;
+}
+
+static inline int i2c_sim_open(void *ctx, const char *name)
+{
+    (void)ctx;
+    for (int i = 0; i < I2C_SIM_BUS_MAX; i++)
+    {
+        if ((i2c_sim_buses[i] == NULL) || (strcmp(i2c_sim_buses[i]->name, name) != 0)){ continue;}
+        for (int handle = 0; handle < I2C_SIM_HANDLE_MAX; handle++)
+        {
+            if (i2c_sim_handles[handle].bus == NULL)
+            {
+                i2c_sim_handles[handle].bus = i2c_sim_buses[i];
+                i2c_sim_handles[handle].address = 0;
+                return I2C_SIM_FD_BASE + handle;
+            }
+        }
+        errno = EMFILE;
+        return -1;
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+static inline int i2c_sim_close(void *ctx, int fd)
+{
+    (void)ctx;
+    if (i2c_sim_handle(fd) == NULL){ return -1;}
+    i2c_sim_handles[fd - I2C_SIM_FD_BASE].bus = NULL;
+    return 0;
+}
+
+static inline int i2c_sim_set_address(void *ctx, int fd, uint16_t address)
+{
+    (void)ctx;
+    if (i2c_sim_handle(fd) == NULL){ return -1;}
+    i2c_sim_handles[fd - I2C_SIM_FD_BASE].address = address;
+    return 0;
+}
+
+static inline ssize_t i2c_sim_read(void *ctx, int fd, void *buffer, size_t size)
+{
+    (void)ctx;
+    i2c_sim_bus_t *bus = i2c_sim_handle(fd);
+    if (bus == NULL){ return -1;}
+    struct i2c_msg message = {.addr = i2c_sim_handles[fd - I2C_SIM_FD_BASE].address, .flags = I2C_M_RD, .len = size, .buf = buffer};
+    return (i2c_sim_run(bus, &message, 1) < 0) ? -1 : (ssize_t)size;
+}
+
+static inline ssize_t i2c_sim_write(void *ctx, int fd, const void *buffer, size_t size)
+{
+    (void)ctx;
+    i2c_sim_bus_t *bus = i2c_sim_handle(fd);
+    if (bus == NULL){ return -1;}
+    struct i2c_msg message = {.addr = i2c_sim_handles[fd - I2C_SIM_FD_BASE].address, .flags = 0, .len = size, .buf = (uint8_t *)buffer};
+    return (i2c_sim_run(bus, &message, 1) < 0) ? -1 : (ssize_t)size;
+}
+
+static inline int i2c_sim_transfer(void *ctx, int fd, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    (void)ctx;
+    i2c_sim_bus_t *bus = i2c_sim_handle(fd);
+    if (bus == NULL){ return -1;}
+    return (i2c_sim_run(bus, messages, nb_msg) < 0) ? -1 : (int)nb_msg;
+}
+
+/** @brief Simulated transport : the buses created by i2c_sim_bus_init(). */
+static const i2c_transport_t i2c_transport_sim = {
+    .name = "sim", .bus_open = i2c_sim_open, .bus_close = i2c_sim_close, .set_address = i2c_sim_set_address,
+    .bus_read = i2c_sim_read, .bus_write = i2c_sim_write, .transfer = i2c_sim_transfer, .ctx = NULL};
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                   PCF8591                                                    */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+/**
+ * @brief PCF8591 model. Codes use the scale of PCF8591.h (code * Vref / 255).
+ */
+typedef struct
+{
+    i2c_sim_device_t dev;     ///< Device (first member).
+    int vref_mv;              ///< Reference voltage.
+    double input_mv[4];       ///< Voltage on AIN0 to AIN3, used when input is NULL.
+    double (*input)(void *arg, int pin, uint64_t time_ns); ///< Voltage on a pin at a time (signal generator), or NULL.
+    void *arg;                ///< Argument of input.
+    int loopback;             ///< Pin wired to AOUT (-1 for none).
+    uint8_t control;          ///< Control byte.
+    uint8_t dac;              ///< DAC register.
+    uint8_t pending;          ///< Conversion sent by the next byte read.
+    uint8_t channel;          ///< Channel of the next conversion.
+    int nb_written;           ///< Bytes received since the START.
+    unsigned long nb_conversion; ///< Conversions made.
+} i2c_sim_pcf8591_t;
+
+static inline double i2c_sim_pcf8591_pin(i2c_sim_pcf8591_t *m, int pin)
+{
+    if ((pin == m->loopback) && (m->control & 0x40)){ return (double)m->dac * m->vref_mv / 255;}
+    return m->input ? m->input(m->arg, pin, i2c_sim_time_ns()) : m->input_mv[pin];
+}
+
+static inline uint8_t i2c_sim_pcf8591_convert(i2c_sim_pcf8591_t *m)
+{
+    static const int nb_input[4] = {4, 3, 3, 2};
+    int mode = (m->control >> 4) & 0x03, ch = m->channel;
+    double mv;
+    int differential = 1;
+
+    m->nb_conversion++;
+    switch (mode)
+    {
+        case 0 : mv = i2c_sim_pcf8591_pin(m, ch); differential = 0; break;
+        case 1 : mv = (ch < 3) ? i2c_sim_pcf8591_pin(m, ch) - i2c_sim_pcf8591_pin(m, 3) : 0; break;
+        case 2 : if (ch < 2){ mv = i2c_sim_pcf8591_pin(m, ch); differential = 0;} else { mv = i2c_sim_pcf8591_pin(m, 2) - i2c_sim_pcf8591_pin(m, 3);} break;
+        default : mv = (ch == 0) ? i2c_sim_pcf8591_pin(m, 0) - i2c_sim_pcf8591_pin(m, 1) : i2c_sim_pcf8591_pin(m, 2) - i2c_sim_pcf8591_pin(m, 3); break;
+    }
+    if (m->control & 0x04){ m->channel = (m->channel + 1) % nb_input[mode];} ///< auto-increment
+
+    long code = lround(mv * 255 / m->vref_mv);
+    if (differential){ return (uint8_t)(code < -128 ? -128 : code > 127 ? 127 : code);}
+    return code < 0 ? 0 : code > 255 ? 255 : code;
+}
+
+static inline void i2c_sim_pcf8591_start(i2c_sim_device_t *dev, int read)
+{
+    (void)read;
+    ((i2c_sim_pcf8591_t *)dev)->nb_written = 0;
+}
+
+static inline int i2c_sim_pcf8591_write(i2c_sim_device_t *dev, uint8_t data)
+{
+    i2c_sim_pcf8591_t *m = (i2c_sim_pcf8591_t *)dev;
+    if (m->nb_written++ == 0)
+    {
+        m->control = data;
+        m->channel = data & 0x03;
+    }
+    else
+    {
+        m->dac = data; ///< every byte after the control byte is latched in the DAC
+    }
+    return 1;
+}
+
+static inline uint8_t i2c_sim_pcf8591_read(i2c_sim_device_t *dev)
+{
+    i2c_sim_pcf8591_t *m = (i2c_sim_pcf8591_t *)dev;
+    uint8_t data = m->pending; ///< result of the conversion started by the previous byte
+    m->pending = i2c_sim_pcf8591_convert(m);
+    return data;
+}
+
+static inline void i2c_sim_pcf8591_stop(i2c_sim_device_t *dev){ (void)dev;}
+
+/**
+ * @brief Initialize a PCF8591 model (power-on state, all inputs at 0 V).
+ * @param m The model.
+ * @param address I2C address (0x48 to 0x4F).
+ * @param vref_mv Reference voltage.
+ */
+static inline void i2c_sim_pcf8591_init(i2c_sim_pcf8591_t *m, uint16_t address, int vref_mv)
+{
+    memset(m, 0, sizeof(*m));
+    m->dev = (i2c_sim_device_t){.address = address, .name = "PCF8591", .on_start = i2c_sim_pcf8591_start,
+                                .on_write = i2c_sim_pcf8591_write, .on_read = i2c_sim_pcf8591_read, .on_stop = i2c_sim_pcf8591_stop};
+    m->vref_mv = vref_mv;
+    m->loopback = -1;
+    m->pending = 0x80; ///< first byte read after power-on
+}
+
+/**
+ * @brief Return the voltage on the AOUT pin of a PCF8591 model (0 when the DAC output is disabled).
+ * @param m The model.
+ */
+static inline double i2c_sim_pcf8591_aout_mv(const i2c_sim_pcf8591_t *m)
+{
+    return (m->control & 0x40) ? (double)m->dac * m->vref_mv / 255 : 0;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                   PCF8574                                                    */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+/**
+ * @brief PCF8574 model.
+ */
+typedef struct
+{
+    i2c_sim_device_t dev;  ///< Device (first member).
+    uint8_t latch;         ///< Output latch : 0 = pin driven low, 1 = weak pull-up (input).
+    uint8_t pulled_low;    ///< Pins driven low from outside (buttons, other devices).
+    unsigned long nb_write; ///< Bytes written in the latch.
+} i2c_sim_pcf8574_t;
+
+static inline void i2c_sim_pcf8574_start(i2c_sim_device_t *dev, int read){ (void)dev; (void)read;}
+static inline void i2c_sim_pcf8574_stop(i2c_sim_device_t *dev){ (void)dev;}
+
+static inline int i2c_sim_pcf8574_write(i2c_sim_device_t *dev, uint8_t data)
+{
+    i2c_sim_pcf8574_t *m = (i2c_sim_pcf8574_t *)dev;
+    m->latch = data;
+    m->nb_write++;
+    return 1;
+}
+
+static inline uint8_t i2c_sim_pcf8574_read(i2c_sim_device_t *dev)
+{
+    i2c_sim_pcf8574_t *m = (i2c_sim_pcf8574_t *)dev;
+    return m->latch & ~m->pulled_low; ///< quasi-bidirectional : a low wins
+}
+
+/**
+ * @brief Initialize a PCF8574 model (power-on state : all the pins high).
+ * @param m The model.
+ * @param address I2C address (0x20 to 0x27).
+ */
+static inline void i2c_sim_pcf8574_init(i2c_sim_pcf8574_t *m, uint16_t address)
+{
+    memset(m, 0, sizeof(*m));
+    m->dev = (i2c_sim_device_t){.address = address, .name = "PCF8574", .on_start = i2c_sim_pcf8574_start,
+                                .on_write = i2c_sim_pcf8574_write, .on_read = i2c_sim_pcf8574_read, .on_stop = i2c_sim_pcf8574_stop};
+    m->latch = 0xFF;
+}
+
+/**
+ * @brief Drive a pin of a PCF8574 model from outside.
+ * @param m The model.
+ * @param pin Pin (0 to 7).
+ * @param low 1 to pull the pin low, 0 to release it.
+ */
+static inline void i2c_sim_pcf8574_set_input(i2c_sim_pcf8574_t *m, int pin, int low)
+{
+    if (low){ m->pulled_low |= 1 << pin;}
+    else { m->pulled_low &= ~(1 << pin);}
+}
+
+/**
+ * @brief Return the level of the pins of a PCF8574 model.
+ * @param m The model.
+ */
+static inline uint8_t i2c_sim_pcf8574_pins(const i2c_sim_pcf8574_t *m)
+{
+    return m->latch & ~m->pulled_low;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                   HTS221                                                     */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+#define I2C_SIM_HTS221_WHO_AM_I 0x0F
+#define I2C_SIM_HTS221_AV_CONF 0x10
+#define I2C_SIM_HTS221_CTRL_REG1 0x20
+#define I2C_SIM_HTS221_CTRL_REG2 0x21
+#define I2C_SIM_HTS221_STATUS 0x27
+#define I2C_SIM_HTS221_H_OUT 0x28
+#define I2C_SIM_HTS221_T_OUT 0x2A
+
+/**
+ * @brief HTS221 model (humidity and temperature sensor of the Sense HAT).
+ * The calibration registers hold fixed values ; the outputs are computed from them, so a driver that applies
+ * the calibration reads back the temperature and humidity set in the model.
+ */
+typedef struct
+{
+    i2c_sim_device_t dev;     ///< Device (first member).
+    uint8_t reg[0x40];        ///< Registers.
+    uint8_t pointer;          ///< Register address of the next byte.
+    uint8_t increment;        ///< Register address auto-increment (bit 7 of the sub-address).
+    int nb_written;           ///< Bytes received since the START.
+    double temperature_c;     ///< Temperature measured.
+    double humidity_rh;       ///< Relative humidity measured (%).
+    uint64_t conversion_ns;   ///< Time of a one-shot conversion.
+    uint64_t ready_ns;        ///< End of the one-shot conversion running (0 for none).
+    unsigned long nb_conversion; ///< Conversions made.
+} i2c_sim_hts221_t;
+
+static inline void i2c_sim_hts221_put16(i2c_sim_hts221_t *m, uint8_t reg, int16_t value)
+{
+    m->reg[reg] = value & 0xFF;
+    m->reg[reg + 1] = (value >> 8) & 0xFF;
+}
+
+static inline int16_t i2c_sim_hts221_get16(const i2c_sim_hts221_t *m, uint8_t reg)
+{
+    return (int16_t)(m->reg[reg] | (m->reg[reg + 1] << 8));
+}
+
+/** @brief Fill the output registers from the calibration registers. */
+static inline void i2c_sim_hts221_convert(i2c_sim_hts221_t *m)
+{
+    double h0 = m->reg[0x30] / 2.0, h1 = m->reg[0x31] / 2.0;
+    double t0 = ((m->reg[0x35] & 0x03) << 8 | m->reg[0x32]) / 8.0, t1 = ((m->reg[0x35] & 0x0C) << 6 | m->reg[0x33]) / 8.0;
+    int16_t h0_out = i2c_sim_hts221_get16(m, 0x36), h1_out = i2c_sim_hts221_get16(m, 0x3A);
+    int16_t t0_out = i2c_sim_hts221_get16(m, 0x3C), t1_out = i2c_sim_hts221_get16(m, 0x3E);
+
+    double h = h0_out + (m->humidity_rh - h0) * (h1_out - h0_out) / (h1 - h0);
+    double t = t0_out + (m->temperature_c - t0) * (t1_out - t0_out) / (t1 - t0);
+    i2c_sim_hts221_put16(m, I2C_SIM_HTS221_H_OUT, h < INT16_MIN ? INT16_MIN : h > INT16_MAX ? INT16_MAX : lround(h));
+    i2c_sim_hts221_put16(m, I2C_SIM_HTS221_T_OUT, t < INT16_MIN ? INT16_MIN : t > INT16_MAX ? INT16_MAX : lround(t));
+    m->reg[I2C_SIM_HTS221_STATUS] = 0x03; ///< H_DA and T_DA
+    m->nb_conversion++;
+}
+
+/** @brief End the one-shot conversion when its time is over, or convert continuously when an output rate is set. */
+static inline void i2c_sim_hts221_update(i2c_sim_hts221_t *m)
+{
+    if ((m->ready_ns != 0) && (i2c_sim_time_ns() >= m->ready_ns))
+    {
+        i2c_sim_hts221_convert(m);
+        m->reg[I2C_SIM_HTS221_CTRL_REG2] &= ~0x01; ///< ONE_SHOT cleared by the sensor
+        m->ready_ns = 0;
+    }
+    else if ((m->reg[I2C_SIM_HTS221_CTRL_REG1] & 0x80) && (m->reg[I2C_SIM_HTS221_CTRL_REG1] & 0x03) && (m->reg[I2C_SIM_HTS221_STATUS] != 0x03))
+    {
+        i2c_sim_hts221_convert(m);
+    }
+}
+
+static inline void i2c_sim_hts221_start(i2c_sim_device_t *dev, int read)
+{
+    i2c_sim_hts221_t *m = (i2c_sim_hts221_t *)dev;
+    if (!read){ m->nb_written = 0;}
+}
+
+static inline void i2c_sim_hts221_stop(i2c_sim_device_t *dev){ (void)dev;}
+
+static inline int i2c_sim_hts221_write(i2c_sim_device_t *dev, uint8_t data)
+{
+    i2c_sim_hts221_t *m = (i2c_sim_hts221_t *)dev;
+
+    if (m->nb_written++ == 0)
+    {
+        m->pointer = data & 0x3F;
+        m->increment = data & 0x80;
+        return 1;
+    }
+
+    uint8_t reg = m->pointer;
+    if ((reg == I2C_SIM_HTS221_AV_CONF) || ((reg >= I2C_SIM_HTS221_CTRL_REG1) && (reg <= 0x22))){ m->reg[reg] = data;} ///< other registers are read-only
+    if ((reg == I2C_SIM_HTS221_CTRL_REG2) && (data & 0x01) && (m->reg[I2C_SIM_HTS221_CTRL_REG1] & 0x80))
+    {
+        m->ready_ns = i2c_sim_time_ns() + m->conversion_ns; ///< one-shot started
+        if (m->ready_ns == 0){ m->ready_ns = 1;}
+    }
+    if (m->increment){ m->pointer = (m->pointer + 1) & 0x3F;}
+    return 1;
+}
+
+static inline uint8_t i2c_sim_hts221_read(i2c_sim_device_t *dev)
+{
+    i2c_sim_hts221_t *m = (i2c_sim_hts221_t *)dev;
+
+    i2c_sim_hts221_update(m);
+    uint8_t data = m->reg[m->pointer];
+    if (m->pointer == I2C_SIM_HTS221_H_OUT + 1){ m->reg[I2C_SIM_HTS221_STATUS] &= ~0x02;} ///< H_DA cleared by reading H_OUT_H
+    if (m->pointer == I2C_SIM_HTS221_T_OUT + 1){ m->reg[I2C_SIM_HTS221_STATUS] &= ~0x01;} ///< T_DA cleared by reading TEMP_OUT_H
+    if (m->increment){ m->pointer = (m->pointer + 1) & 0x3F;}
+    return data;
+}
+
+/**
+ * @brief Initialize an HTS221 model (power-down, 20 °C, 50 % rH).
+ * Calibration : H0 = 20 % rH at 3000, H1 = 70 % rH at -9000, T0 = 10 °C at 500, T1 = 35 °C at 4500.
+ * @param m The model.
+ * @param address I2C address (0x5F).
+ * @param conversion_ns Time of a one-shot conversion.
+ */
+static inline void i2c_sim_hts221_init(i2c_sim_hts221_t *m, uint16_t address, uint64_t conversion_ns)
+{
+    memset(m, 0, sizeof(*m));
+    m->dev = (i2c_sim_device_t){.address = address, .name = "HTS221", .on_start = i2c_sim_hts221_start,
+                                .on_write = i2c_sim_hts221_write, .on_read = i2c_sim_hts221_read, .on_stop = i2c_sim_hts221_stop};
+    m->reg[I2C_SIM_HTS221_WHO_AM_I] = 0xBC;
+    m->reg[I2C_SIM_HTS221_AV_CONF] = 0x1B;
+    m->reg[0x30] = 40;    ///< H0_rH_x2
+    m->reg[0x31] = 140;   ///< H1_rH_x2
+    m->reg[0x32] = 80;    ///< T0_degC_x8 (10 °C)
+    m->reg[0x33] = 0x18;  ///< T1_degC_x8 (35 °C = 280), low byte
+    m->reg[0x35] = 0x04;  ///< T1/T0 msb
+    i2c_sim_hts221_put16(m, 0x36, 3000);  ///< H0_T0_OUT
+    i2c_sim_hts221_put16(m, 0x3A, -9000); ///< H1_T0_OUT
+    i2c_sim_hts221_put16(m, 0x3C, 500);   ///< T0_OUT
+    i2c_sim_hts221_put16(m, 0x3E, 4500);  ///< T1_OUT
+    m->temperature_c = 20;
+    m->humidity_rh = 50;
+    m->conversion_ns = conversion_ns;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                   SSD1306                                                    */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+#define I2C_SIM_SSD1306_PAGES 8
+#define I2C_SIM_SSD1306_COLUMNS 128
+
+/**
+ * @brief SSD1306 model (128 x 64 OLED display controller).
+ */
+typedef struct
+{
+    i2c_sim_device_t dev;       ///< Device (first member).
+    uint8_t gddram[I2C_SIM_SSD1306_PAGES][I2C_SIM_SSD1306_COLUMNS]; ///< Display RAM : one byte = 8 vertical pixels of a page.
+    int expect_control;         ///< 1 when the next byte is a control byte.
+    int single;                 ///< Co bit of the last control byte : only one data / command byte follows.
+    int data;                   ///< D/C bit of the last control byte.
+    uint8_t command[8];         ///< Command being received, with its arguments.
+    int nb_command;             ///< Bytes of the command received.
+    uint8_t mode;               ///< Memory addressing mode : 0 horizontal, 1 vertical, 2 page.
+    uint8_t column, page;       ///< Address of the next data byte.
+    uint8_t column_start, column_end, page_start, page_end; ///< Window of the horizontal and vertical modes.
+    uint8_t display_on;         ///< Display ON (0xAF) / OFF (0xAE).
+    uint8_t inverse;            ///< Inverse display (0xA7).
+    uint8_t contrast;           ///< Contrast (0x81).
+    unsigned long nb_data;      ///< Data bytes written in the GDDRAM.
+    unsigned long nb_command_run; ///< Commands run.
+} i2c_sim_ssd1306_t;
+
+/** @brief Number of argument bytes following a command. */
+static inline int i2c_sim_ssd1306_nb_arg(uint8_t command)
+{
+    switch (command)
+    {
+        case 0x20 : case 0x81 : case 0x8D : case 0xA8 : case 0xD3 : case 0xD5 : case 0xD9 : case 0xDA : case 0xDB : return 1;
+        case 0x21 : case 0x22 : case 0xA3 : return 2;
+        case 0x29 : case 0x2A : return 5;
+        case 0x26 : case 0x27 : return 6;
+        default : return 0;
+    }
+}
+
+static inline void i2c_sim_ssd1306_command(i2c_sim_ssd1306_t *m)
+{
+    uint8_t *c = m->command;
+
+    m->nb_command_run++;
+    if (c[0] <= 0x0F){ m->column = (m->column & 0xF0) | c[0]; return;}               ///< lower column (page mode)
+    if (c[0] <= 0x1F){ m->column = ((c[0] & 0x07) << 4) | (m->column & 0x0F); return;} ///< higher column (page mode)
+    if ((c[0] >= 0xB0) && (c[0] <= 0xB7)){ m->page = c[0] & 0x07; return;}          ///< page (page mode)
+    switch (c[0])
+    {
+        case 0x20 : m->mode = c[1] & 0x03; break;
+        case 0x21 : m->column_start = m->column = c[1] & 0x7F; m->column_end = c[2] & 0x7F; break;
+        case 0x22 : m->page_start = m->page = c[1] & 0x07; m->page_end = c[2] & 0x07; break;
+        case 0x81 : m->contrast = c[1]; break;
+        case 0xA6 : case 0xA7 : m->inverse = c[0] & 0x01; break;
+        case 0xAE : case 0xAF : m->display_on = c[0] & 0x01; break;
+        default : break; ///< display settings without effect on the GDDRAM
+    }
+}
+
+static inline void i2c_sim_ssd1306_data(i2c_sim_ssd1306_t *m, uint8_t data)
+{
+    m->gddram[m->page][m->column] = data;
+    m->nb_data++;
+    switch (m->mode)
+    {
+        case 0 : ///< horizontal : column, then page
+            if (m->column++ >= m->column_end){ m->column = m->column_start; m->page = (m->page >= m->page_end) ? m->page_start : m->page + 1;}
+            break;
+        case 1 : ///< vertical : page, then column
+            if (m->page++ >= m->page_end){ m->page = m->page_start; m->column = (m->column >= m->column_end) ? m->column_start : m->column + 1;}
+            break;
+        default : ///< page : column only
+            m->column = (m->column + 1) & 0x7F;
+            break;
+    }
+}
+
+static inline void i2c_sim_ssd1306_start(i2c_sim_device_t *dev, int read)
+{
+    i2c_sim_ssd1306_t *m = (i2c_sim_ssd1306_t *)dev;
+    if (!read){ m->expect_control = 1; m->nb_command = 0;}
+}
+
+static inline void i2c_sim_ssd1306_stop(i2c_sim_device_t *dev){ (void)dev;}
+
+static inline int i2c_sim_ssd1306_write(i2c_sim_device_t *dev, uint8_t byte)
+{
+    i2c_sim_ssd1306_t *m = (i2c_sim_ssd1306_t *)dev;
+
+    if (m->expect_control)
+    {
+        m->single = (byte & 0x80) != 0; ///< Co
+        m->data = (byte & 0x40) != 0;   ///< D/C
+        m->expect_control = 0;
+        return 1;
+    }
+
+    if (m->data)
+    {
+        i2c_sim_ssd1306_data(m, byte);
+    }
+    else
+    {
+        if (m->nb_command < (int)sizeof(m->command)){ m->command[m->nb_command] = byte;}
+        m->nb_command++;
+        if (m->nb_command > i2c_sim_ssd1306_nb_arg(m->command[0]))
+        {
+            i2c_sim_ssd1306_command(m);
+            m->nb_command = 0;
+        }
+    }
+    if (m->single){ m->expect_control = 1;} ///< a control byte follows each data / command byte
+    return 1;
+}
+
+static inline uint8_t i2c_sim_ssd1306_read(i2c_sim_device_t *dev)
+{
+    i2c_sim_ssd1306_t *m = (i2c_sim_ssd1306_t *)dev;
+    return m->display_on ? 0x00 : 0x40; ///< status byte : bit 6 = display OFF
+}
+
+/**
+ * @brief Initialize an SSD1306 model (reset state : display OFF, page addressing mode, GDDRAM cleared).
+ * @param m The model.
+ * @param address I2C address (0x3C or 0x3D).
+ */
+static inline void i2c_sim_ssd1306_init(i2c_sim_ssd1306_t *m, uint16_t address)
+{
+    memset(m, 0, sizeof(*m));
+    m->dev = (i2c_sim_device_t){.address = address, .name = "SSD1306", .on_start = i2c_sim_ssd1306_start,
+                                .on_write = i2c_sim_ssd1306_write, .on_read = i2c_sim_ssd1306_read, .on_stop = i2c_sim_ssd1306_stop};
+    m->mode = 2;
+    m->column_end = I2C_SIM_SSD1306_COLUMNS - 1;
+    m->page_end = I2C_SIM_SSD1306_PAGES - 1;
+    m->contrast = 0x7F;
+}
+
+/**
+ * @brief Return a pixel of the GDDRAM of an SSD1306 model.
+ * @param m The model.
+ * @param x Column (0 to 127).
+ * @param y Row (0 to 63).
+ * @return 1 if the pixel is ON.
+ */
+static inline int i2c_sim_ssd1306_pixel(const i2c_sim_ssd1306_t *m, int x, int y)
+{
+    return (m->gddram[(y >> 3) & 0x07][x & 0x7F] >> (y & 0x07)) & 0x01;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                    Board                                                     */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+/**
+ * @brief One simulated bus with the four models at the default addresses of the drivers.
+ */
+typedef struct
+{
+    i2c_sim_bus_t bus;          ///< The bus.
+    i2c_sim_pcf8591_t pcf8591;  ///< 0x48.
+    i2c_sim_pcf8574_t pcf8574;  ///< 0x20.
+    i2c_sim_hts221_t hts221;    ///< 0x5F.
+    i2c_sim_ssd1306_t ssd1306;  ///< 0x3C.
+} i2c_sim_board_t;
+
+/**
+ * @brief Create a simulated bus with the four models and select the simulated transport.
+ * @param board The board.
+ * @param name Name of the bus ("/dev/i2c-1").
+ * @return 1 on success, -1 on error.
+ */
+static inline int i2c_sim_board_init(i2c_sim_board_t *board, const char *name)
+{
+    if (i2c_sim_bus_init(&board->bus, name) < 0){ return -1;}
+    i2c_sim_pcf8591_init(&board->pcf8591, 0x48, 3300);
+    i2c_sim_pcf8574_init(&board->pcf8574, 0x20);
+    i2c_sim_hts221_init(&board->hts221, 0x5F, 0);
+    i2c_sim_ssd1306_init(&board->ssd1306, 0x3C);
+    i2c_sim_attach(&board->bus, &board->pcf8591.dev);
+    i2c_sim_attach(&board->bus, &board->pcf8574.dev);
+    i2c_sim_attach(&board->bus, &board->hts221.dev);
+    i2c_sim_attach(&board->bus, &board->ssd1306.dev);
+    i2c_set_transport(&i2c_transport_sim);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,471 @@
+/**
+ * @brief I2C tracing : counts, bytes, errors and latency histograms per device and per operation
+ *
+ * @file i2c_trace.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ * compilation : add -DI2C_TRACE -pthread to the gcc command line to enable it, for every file of the program
+ *               (i2c_bus.c included : the counters are defined there, once per process).
+ *
+ * Every access of i2c_bus.h (the path of PCF8591.h, PCF8574.h, Sense_hat.h and the SSD1306 twi layer) is recorded
+ * under the address of its slave and its operation : read, write, transfer (ioctl I2C_RDWR), read_reg, write_reg. The
+ * latency is the time of the transport call, the wait for the bus is accounted separately by the priority classes of
+ * i2c_bus.h.
+ *
+ * A combined transaction whose messages go to several slaves (batches of i2c_batch.h) is split : each slave gets one
+ * "batch" access with the bytes of its own messages and no latency, the ioctl itself is recorded once as a "transfer"
+ * of the bus entry (I2C_TRACE_BUS) with all the bytes, its latency and its error : the adapter doesn't tell which
+ * message failed (i2c_batch.h replays the operations one by one, the replays are recorded per slave).
+ *
+ * The counters are per thread : a thread writes only its own block with relaxed atomic stores, without lock nor
+ * read-modify-write. The blocks are summed when read, so a dump never stops the threads using the bus. The block of a
+ * thread which ends is reused by the next new thread.
+ *
+ * The dump (i2c_trace_dump()) doesn't use stdio nor malloc : it can be called from a signal handler,
+ * i2c_trace_dump_on_signal(SIGUSR1) installs one ("kill -USR1 <pid>" writes the counters on stderr).
+ *
+ * Without -DI2C_TRACE the recording macros are empty : no clock read, no counter, nothing in the access functions.
+ * The API stays available and reports that tracing is disabled.
+ *
+ * @warning i2c_trace_reset() while other threads use the bus can lose the accesses made during the reset.
+ */
+
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define I2C_TRACE_READ 0      ///< read() of i2c_bus_read().
+#define I2C_TRACE_WRITE 1     ///< write() of i2c_bus_write().
+#define I2C_TRACE_TRANSFER 2  ///< ioctl(I2C_RDWR) of i2c_bus_transfer() (batches, PCF8591 reads, SSD1306 frames).
+#define I2C_TRACE_READ_REG 3  ///< Register read of i2c_bus_read_reg().
+#define I2C_TRACE_WRITE_REG 4 ///< Register write of i2c_bus_write_reg().
+#define I2C_TRACE_BATCH 5     ///< Messages of one slave in an ioctl(I2C_RDWR) shared with other slaves, no latency.
+#define I2C_TRACE_OP_NB 6     ///< Number of operations.
+
+#define I2C_TRACE_BUS 0x80    ///< Address of the bus entry : ioctl(I2C_RDWR) addressing several slaves.
+
+#ifndef I2C_TRACE_DEV_MAX
+#define I2C_TRACE_DEV_MAX 16  ///< Slave addresses traced, the next ones share the last entry.
+#endif
+#define I2C_TRACE_HIST_MAX 32 ///< log2 buckets of the latency histogram (1 ns to 2 s).
+
+/**
+ * @brief Sum of the counters of one device and one operation (i2c_trace_get()).
+ */
+typedef struct
+{
+    uint64_t nb;                        ///< Accesses.
+    uint64_t bytes;                     ///< Bytes written and read.
+    uint64_t errors;                    ///< Accesses failed (NACK, bus error).
+    uint64_t time_ns;                   ///< Total latency.
+    uint64_t max_ns;                    ///< Longest latency.
+    uint64_t hist[I2C_TRACE_HIST_MAX];  ///< Latencies, bucket i = [2^i, 2^(i+1)[ ns.
+} i2c_trace_stat_t;
+
+#ifdef I2C_TRACE
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <linux/i2c.h>
+
+/**
+ * @brief Counters of one device and one operation in the block of a thread.
+ */
+typedef struct
+{
+    _Atomic uint64_t nb;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t errors;
+    _Atomic uint64_t time_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t hist[I2C_TRACE_HIST_MAX];
+} i2c_trace_counter_t;
+
+/**
+ * @brief Counters of one thread.
+ */
+typedef struct i2c_trace_thread
+{
+    i2c_trace_counter_t counter[I2C_TRACE_DEV_MAX + 1][I2C_TRACE_OP_NB]; ///< Last entry : the bus.
+    struct i2c_trace_thread *next; ///< Next block, the list only grows.
+    atomic_int in_use;             ///< 0 once the thread has ended, the block can be taken by a new thread.
+} i2c_trace_thread_t;
+
+/* State of the process, defined in i2c_bus.c */
+
+/** @brief Blocks of every thread which accessed a bus. */
+extern _Atomic(i2c_trace_thread_t *) i2c_trace_threads;
+
+/** @brief Block of the calling thread. */
+extern __thread i2c_trace_thread_t *i2c_trace_self;
+
+/** @brief Entry of each 7 bit address + 1, 0 when the address has not been seen yet. */
+extern atomic_int i2c_trace_slot[128];
+
+/** @brief Address of each entry. */
+extern atomic_int i2c_trace_address[I2C_TRACE_DEV_MAX];
+
+extern atomic_int i2c_trace_nb_slot;
+extern pthread_mutex_t i2c_trace_slot_lock;
+extern pthread_key_t i2c_trace_key;
+extern pthread_once_t i2c_trace_once;
+
+/**
+ * @brief Give the block of an ending thread back.
+ */
+static inline void i2c_trace_release(void *block)
+{
+    atomic_store_explicit(&((i2c_trace_thread_t *)block)->in_use, 0, memory_order_release);
+}
+
+static inline void i2c_trace_key_create(void)
+{
+    pthread_key_create(&i2c_trace_key, i2c_trace_release);
+}
+
+/**
+ * @brief Return the block of the calling thread : a block left by an ended thread, or a new one.
+ * @return The block, NULL if out of memory.
+ */
+static inline i2c_trace_thread_t *i2c_trace_thread(void)
+{
+    if (i2c_trace_self){ return i2c_trace_self;}
+
+    pthread_once(&i2c_trace_once, i2c_trace_key_create);
+    i2c_trace_thread_t *block = atomic_load_explicit(&i2c_trace_threads, memory_order_acquire);
+    for (; block; block = block->next)
+    {
+        int free_block = 0;
+        if (atomic_compare_exchange_strong(&block->in_use, &free_block, 1)){ break;}
+    }
+    if (block == NULL)
+    {
+        if ((block = calloc(1, sizeof(*block))) == NULL){ return NULL;}
+        atomic_init(&block->in_use, 1);
+        block->next = atomic_load_explicit(&i2c_trace_threads, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&i2c_trace_threads, &block->next, block, memory_order_release, memory_order_relaxed)){}
+    }
+    pthread_setspecific(i2c_trace_key, block);
+    i2c_trace_self = block;
+    return block;
+}
+
+/**
+ * @brief Return the entry of a slave address, give it one the first time.
+ */
+static inline int i2c_trace_device(uint16_t address)
+{
+    if (address == I2C_TRACE_BUS){ return I2C_TRACE_DEV_MAX;}
+    address &= 0x7F;
+    int slot = atomic_load_explicit(&i2c_trace_slot[address], memory_order_acquire);
+    if (slot){ return slot - 1;}
+
+    pthread_mutex_lock(&i2c_trace_slot_lock);
+    slot = atomic_load_explicit(&i2c_trace_slot[address], memory_order_relaxed);
+    if (slot == 0)
+    {
+        int nb = atomic_load_explicit(&i2c_trace_nb_slot, memory_order_relaxed);
+        if (nb < I2C_TRACE_DEV_MAX)
+        {
+            atomic_store_explicit(&i2c_trace_address[nb], address, memory_order_relaxed);
+            atomic_store_explicit(&i2c_trace_nb_slot, nb + 1, memory_order_release);
+        }
+        slot = (nb < I2C_TRACE_DEV_MAX ? nb : I2C_TRACE_DEV_MAX - 1) + 1; ///< the last entry is shared when full
+        atomic_store_explicit(&i2c_trace_slot[address], slot, memory_order_release);
+    }
+    pthread_mutex_unlock(&i2c_trace_slot_lock);
+    return slot - 1;
+}
+
+/** @brief Add to a counter only written by the calling thread (no read-modify-write needed). */
+#define I2C_TRACE_ADD(counter, value) \
+    atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (value), memory_order_relaxed)
+
+/**
+ * @brief Return the CLOCK_MONOTONIC time in ns.
+ */
+static inline uint64_t i2c_trace_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * @brief Record one access.
+ * @param op I2C_TRACE_READ / I2C_TRACE_WRITE / I2C_TRACE_TRANSFER / I2C_TRACE_READ_REG / I2C_TRACE_WRITE_REG.
+ * @param address 7 bit address of the slave, I2C_TRACE_BUS for the bus entry.
+ * @param bytes Bytes written and read.
+ * @param error 1 if the access failed.
+ * @param start_ns Time before the access (i2c_trace_time_ns()).
+ */
+static inline void i2c_trace_record(int op, uint16_t address, uint64_t bytes, int error, uint64_t start_ns)
+{
+    uint64_t time_ns = i2c_trace_time_ns() - start_ns;
+    i2c_trace_thread_t *block = i2c_trace_thread();
+    if (block == NULL){ return;}
+
+    i2c_trace_counter_t *c = &block->counter[i2c_trace_device(address)][op];
+    int bucket = 0;
+    while ((bucket < I2C_TRACE_HIST_MAX - 1) && ((time_ns >> (bucket + 1)) != 0)){ bucket++;}
+    I2C_TRACE_ADD(c->nb, 1);
+    I2C_TRACE_ADD(c->bytes, bytes);
+    I2C_TRACE_ADD(c->errors, error != 0);
+    I2C_TRACE_ADD(c->time_ns, time_ns);
+    I2C_TRACE_ADD(c->hist[bucket], 1);
+    if (time_ns > atomic_load_explicit(&c->max_ns, memory_order_relaxed)){ atomic_store_explicit(&c->max_ns, time_ns, memory_order_relaxed);}
+}
+
+/**
+ * @brief Record an ioctl(I2C_RDWR) : one transfer of its slave, or one batch access per slave and one transfer of the
+ *        bus entry when the messages go to several slaves.
+ * @param messages Messages of the ioctl.
+ * @param nb_msg Number of messages.
+ * @param error 1 if the ioctl failed.
+ * @param start_ns Time before the ioctl (i2c_trace_time_ns()).
+ */
+static inline void i2c_trace_record_transfer(const struct i2c_msg *messages, unsigned int nb_msg, int error, uint64_t start_ns)
+{
+    uint64_t total = 0;
+    int shared = 0;
+    for (unsigned int i = 0; i < nb_msg; i++)
+    {
+        total += messages[i].len;
+        shared |= (messages[i].addr != messages[0].addr);
+    }
+    if (!shared){ i2c_trace_record(I2C_TRACE_TRANSFER, nb_msg ? messages[0].addr : 0, total, error, start_ns); return;}
+
+    i2c_trace_record(I2C_TRACE_TRANSFER, I2C_TRACE_BUS, total, error, start_ns);
+    i2c_trace_thread_t *block = i2c_trace_thread();
+    if (block == NULL){ return;}
+    for (unsigned int i = 0; i < nb_msg; i++)
+    {
+        unsigned int first = 0;
+        while (messages[first].addr != messages[i].addr){ first++;}
+        if (first < i){ continue;} ///< slave already counted
+        uint64_t bytes = 0;
+        for (unsigned int j = i; j < nb_msg; j++){ bytes += (messages[j].addr == messages[i].addr) ? messages[j].len : 0;}
+        i2c_trace_counter_t *c = &block->counter[i2c_trace_device(messages[i].addr)][I2C_TRACE_BATCH];
+        I2C_TRACE_ADD(c->nb, 1);
+        I2C_TRACE_ADD(c->bytes, bytes);
+    }
+}
+
+/** @brief Start of a traced access : declares its start time. */
+#define I2C_TRACE_BEGIN(start) uint64_t start = i2c_trace_time_ns()
+/** @brief End of a traced access. */
+#define I2C_TRACE_END(start, op, address, bytes, error) i2c_trace_record((op), (address), (bytes), (error), (start))
+/** @brief End of a traced ioctl(I2C_RDWR). */
+#define I2C_TRACE_TRANSFER_END(start, messages, nb_msg, error) i2c_trace_record_transfer((messages), (nb_msg), (error), (start))
+
+/**
+ * @brief Sum the counters of every thread for one device and one operation.
+ * @param address 7 bit address of the slave, I2C_TRACE_BUS for the bus entry.
+ * @param op Operation (I2C_TRACE_READ, ...).
+ * @param stat Sum of the counters.
+ * @return 1 if the address was traced, 0 otherwise.
+ */
+static inline int i2c_trace_get(uint16_t address, int op, i2c_trace_stat_t *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    int slot = (address == I2C_TRACE_BUS) ? I2C_TRACE_DEV_MAX + 1 : atomic_load_explicit(&i2c_trace_slot[address & 0x7F], memory_order_acquire);
+    if ((slot == 0) || (op < 0) || (op >= I2C_TRACE_OP_NB)){ return 0;}
+
+    for (i2c_trace_thread_t *block = atomic_load_explicit(&i2c_trace_threads, memory_order_acquire); block; block = block->next)
+    {
+        i2c_trace_counter_t *c = &block->counter[slot - 1][op];
+        stat->nb += atomic_load_explicit(&c->nb, memory_order_relaxed);
+        stat->bytes += atomic_load_explicit(&c->bytes, memory_order_relaxed);
+        stat->errors += atomic_load_explicit(&c->errors, memory_order_relaxed);
+        stat->time_ns += atomic_load_explicit(&c->time_ns, memory_order_relaxed);
+        uint64_t max_ns = atomic_load_explicit(&c->max_ns, memory_order_relaxed);
+        if (max_ns > stat->max_ns){ stat->max_ns = max_ns;}
+        for (int i = 0; i < I2C_TRACE_HIST_MAX; i++){ stat->hist[i] += atomic_load_explicit(&c->hist[i], memory_order_relaxed);}
+    }
+    return 1;
+}
+
+/**
+ * @brief Clear the counters of every thread.
+ */
+static inline void i2c_trace_reset(void)
+{
+    for (i2c_trace_thread_t *block = atomic_load_explicit(&i2c_trace_threads, memory_order_acquire); block; block = block->next)
+    {
+        for (int d = 0; d <= I2C_TRACE_DEV_MAX; d++)
+        {
+            for (int op = 0; op < I2C_TRACE_OP_NB; op++)
+            {
+                i2c_trace_counter_t *c = &block->counter[d][op];
+                atomic_store_explicit(&c->nb, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->bytes, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->errors, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->time_ns, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->max_ns, 0, memory_order_relaxed);
+                for (int i = 0; i < I2C_TRACE_HIST_MAX; i++){ atomic_store_explicit(&c->hist[i], 0, memory_order_relaxed);}
+            }
+        }
+    }
+}
+
+#else
+
+#define I2C_TRACE_BEGIN(start) do {} while (0)
+#define I2C_TRACE_END(start, op, address, bytes, error) do {} while (0)
+#define I2C_TRACE_TRANSFER_END(start, messages, nb_msg, error) do {} while (0)
+
+static inline int i2c_trace_get(uint16_t address, int op, i2c_trace_stat_t *stat)
+{
+    (void)address; (void)op;
+    memset(stat, 0, sizeof(*stat));
+    return 0;
+}
+
+static inline void i2c_trace_reset(void){}
+
+#endif
+
+/**
+ * @brief Append a string to a dump line (no stdio : usable in a signal handler).
+ */
+static inline void i2c_trace_put(char *line, size_t *len, size_t size, const char *text)
+{
+    while (*text && (*len < size - 1)){ line[(*len)++] = *text++;}
+    line[*len] = '\0';
+}
+
+/**
+ * @brief Append a number to a dump line, in decimal or in hexadecimal.
+ */
+static inline void i2c_trace_put_u64(char *line, size_t *len, size_t size, uint64_t value, int hex)
+{
+    char digits[24];
+    int nb = 0;
+    do
+    {
+        digits[nb++] = "0123456789abcdef"[value % (hex ? 16 : 10)];
+        value /= (hex ? 16 : 10);
+    } while (value && (nb < (int)sizeof(digits)));
+    while (nb && (*len < size - 1)){ line[(*len)++] = digits[--nb];}
+    line[*len] = '\0';
+}
+
+/**
+ * @brief Write the counters of every traced device and operation, one line each :
+ *        address, operation, accesses, bytes, errors, mean / max latency, upper bound of the p50 / p99 bucket, histogram
+ *        (no latency for the batch accesses). The bus entry comes last, as "bus".
+ *        Async-signal-safe : no stdio, no malloc, no lock.
+ * @param fd Output descriptor (STDERR_FILENO, a log file).
+ */
+static inline void i2c_trace_dump(int fd)
+{
+    char line[640];
+    size_t len = 0;
+
+#ifdef I2C_TRACE
+    static const char *name[I2C_TRACE_OP_NB] = {"read", "write", "transfer", "read_reg", "write_reg", "batch"};
+    int nb_slot = atomic_load_explicit(&i2c_trace_nb_slot, memory_order_acquire);
+
+    for (int d = 0; d <= nb_slot; d++)
+    {
+        uint16_t address = (d == nb_slot) ? I2C_TRACE_BUS : atomic_load_explicit(&i2c_trace_address[d], memory_order_relaxed);
+        for (int op = 0; op < I2C_TRACE_OP_NB; op++)
+        {
+            i2c_trace_stat_t stat;
+            if (!i2c_trace_get(address, op, &stat) || (stat.nb == 0)){ continue;}
+
+            uint64_t p50 = 0, p99 = 0, sum = 0;
+            for (int i = 0; i < I2C_TRACE_HIST_MAX; i++)
+            {
+                sum += stat.hist[i];
+                if ((p50 == 0) && (sum * 2 >= stat.nb)){ p50 = 2ull << i;}
+                if ((p99 == 0) && (sum * 100 >= stat.nb * 99)){ p99 = 2ull << i;}
+            }
+
+            len = 0;
+            if (address == I2C_TRACE_BUS){ i2c_trace_put(line, &len, sizeof(line), "i2c_trace bus");}
+            else
+            {
+                i2c_trace_put(line, &len, sizeof(line), "i2c_trace 0x");
+                i2c_trace_put_u64(line, &len, sizeof(line), address, 1);
+            }
+            i2c_trace_put(line, &len, sizeof(line), " ");
+            i2c_trace_put(line, &len, sizeof(line), name[op]);
+            i2c_trace_put(line, &len, sizeof(line), " nb=");
+            i2c_trace_put_u64(line, &len, sizeof(line), stat.nb, 0);
+            i2c_trace_put(line, &len, sizeof(line), " bytes=");
+            i2c_trace_put_u64(line, &len, sizeof(line), stat.bytes, 0);
+            i2c_trace_put(line, &len, sizeof(line), " errors=");
+            i2c_trace_put_u64(line, &len, sizeof(line), stat.errors, 0);
+            if (op == I2C_TRACE_BATCH)
+            {
+                i2c_trace_put(line, &len, sizeof(line), "\n");
+                if (write(fd, line, len) < 0){ return;}
+                continue;
+            }
+            i2c_trace_put(line, &len, sizeof(line), " mean_ns=");
+            i2c_trace_put_u64(line, &len, sizeof(line), stat.time_ns / stat.nb, 0);
+            i2c_trace_put(line, &len, sizeof(line), " max_ns=");
+            i2c_trace_put_u64(line, &len, sizeof(line), stat.max_ns, 0);
+            i2c_trace_put(line, &len, sizeof(line), " p50_ns<");
+            i2c_trace_put_u64(line, &len, sizeof(line), p50, 0);
+            i2c_trace_put(line, &len, sizeof(line), " p99_ns<");
+            i2c_trace_put_u64(line, &len, sizeof(line), p99, 0);
+            i2c_trace_put(line, &len, sizeof(line), " hist_log2_ns=[");
+            int last = I2C_TRACE_HIST_MAX - 1;
+            while ((last > 0) && (stat.hist[last] == 0)){ last--;}
+            for (int i = 0; i <= last; i++)
+            {
+                if (i){ i2c_trace_put(line, &len, sizeof(line), ",");}
+                i2c_trace_put_u64(line, &len, sizeof(line), stat.hist[i], 0);
+            }
+            i2c_trace_put(line, &len, sizeof(line), "]\n");
+            if (write(fd, line, len) < 0){ return;}
+        }
+    }
+#else
+    i2c_trace_put(line, &len, sizeof(line), "i2c_trace disabled (build with -DI2C_TRACE)\n");
+    if (write(fd, line, len) < 0){ return;}
+#endif
+}
+
+/**
+ * @brief Signal handler of i2c_trace_dump_on_signal() : dump on stderr.
+ */
+static inline void i2c_trace_signal(int signum)
+{
+    int saved_errno = errno;
+    (void)signum;
+    i2c_trace_dump(STDERR_FILENO);
+    errno = saved_errno;
+}
+
+/**
+ * @brief Dump the counters on stderr each time the process gets a signal ("kill -USR1 <pid>").
+ * @param signum Signal (SIGUSR1, SIGUSR2, ...).
+ * @return 1 on success, -1 on error.
+ */
+static inline int i2c_trace_dump_on_signal(int signum)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = i2c_trace_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(signum, &action, NULL) < 0){ printf("/!\\ Error : cannot install the I2C trace signal handler.\n"); return -1;}
+    return 1;
+}
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * @brief This program checks the counters of i2c_trace.h on the simulated board of i2c_sim.h : per thread blocks summed
+ *        when read, errors, accounting of a batch addressing several slaves, reset and dump.
+
+ * @file i2c_trace_test.c
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : none (simulated bus)
+ * compilation : gcc -Wall -DI2C_TRACE -I. -I../PCF8591/header -I../PCF8574 -o i2c_trace_test i2c_trace_test.c ../PCF8591/header/PCF8591.c ../PCF8574/PCF8574.c i2c_bus.c -lm -pthread
+ *
+ * The program returns 0 when every check passes, 1 otherwise.
+ */
+
+/* Library */
+#include "PCF8591.h"
+#include "PCF8574.h"
+#include "i2c_sim.h"
+
+#define NB_ACCESS 5000 ///< Accesses of each thread.
+
+static i2c_sim_board_t board;
+static i2c_bus_t *bus;
+static int nb_error = 0;
+
+/**
+ * @brief Display the result of a check and count the failures.
+ */
+void check(const char *name, int ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok){ nb_error++;}
+}
+
+/**
+ * @brief Check the accesses and bytes of one device and one operation.
+ */
+int stat_is(uint16_t address, int op, uint64_t nb, uint64_t bytes, uint64_t errors)
+{
+    i2c_trace_stat_t stat;
+    i2c_trace_get(address, op, &stat);
+    return (stat.nb == nb) && (stat.bytes == bytes) && (stat.errors == errors);
+}
+
+/**
+ * @brief Thread reading the port of the PCF8574.
+ */
+void *read_port(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < NB_ACCESS; i++){ PCF8574_read_data();}
+    return NULL;
+}
+
+/**
+ * @brief Thread reading the WHO_AM_I register of the HTS221.
+ */
+void *read_who_am_i(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < NB_ACCESS; i++){ i2c_bus_read_reg(bus, 0x5F, 0x0F);}
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t thread[2];
+    i2c_batch_t batch;
+    i2c_op_t op[3];
+    uint8_t data[PCF8591_NB_CHANNEL + 1], port, who, ghost;
+    i2c_trace_stat_t stat;
+    int pipe_fd[2];
+    char dump[4096];
+
+    i2c_sim_board_init(&board, "/dev/i2c-1");
+    PCF8591_i2c_connect();
+    PCF8574_init();
+    bus = i2c_bus_get("/dev/i2c-1");
+    i2c_trace_reset();
+
+    /* two threads : their blocks are summed */
+    pthread_create(&thread[0], NULL, read_port, NULL);
+    pthread_create(&thread[1], NULL, read_who_am_i, NULL);
+    pthread_join(thread[0], NULL);
+    pthread_join(thread[1], NULL);
+    check("threads : PCF8574 reads", stat_is(0x20, I2C_TRACE_READ, NB_ACCESS, NB_ACCESS, 0));
+    check("threads : HTS221 register reads", stat_is(0x5F, I2C_TRACE_READ_REG, NB_ACCESS, 2 * NB_ACCESS, 0));
+    i2c_trace_get(0x20, I2C_TRACE_READ, &stat);
+    uint64_t nb_hist = 0;
+    for (int i = 0; i < I2C_TRACE_HIST_MAX; i++){ nb_hist += stat.hist[i];}
+    check("threads : one histogram entry per access", (nb_hist == NB_ACCESS) && (stat.max_ns * NB_ACCESS >= stat.time_ns));
+
+    /* device that doesn't answer */
+    check("absent device : read fails", i2c_bus_read(bus, 0x50, &ghost, 1) < 0);
+    check("absent device : error counted", stat_is(0x50, I2C_TRACE_READ, 1, 1, 1));
+
+    /* transfer to one slave : recorded under its address */
+    PCF8591_read_data(1);
+    check("single slave transfer : under its address", stat_is(0x48, I2C_TRACE_TRANSFER, 1, 3, 0) && stat_is(I2C_TRACE_BUS, I2C_TRACE_TRANSFER, 0, 0, 0));
+
+    /* batch of three slaves : the bytes of each slave under its address, the ioctl once under the bus entry */
+    i2c_batch_init(&batch, bus);
+    pcf8591_batch_read_all(&batch, &pcf8591_default, &op[0], data); ///< 1 + 5 bytes
+    PCF8574_batch_read(&batch, &op[1], &port);                      ///< 1 byte
+    i2c_batch_add(&batch, i2c_op_read_reg(&op[2], 0x5F, 0x0F, &who)); ///< 1 + 1 bytes
+    check("batch : flush", (i2c_batch_flush(&batch) == 1) && (batch.nb_ioctl == 1));
+    check("batch : PCF8591 bytes", stat_is(0x48, I2C_TRACE_BATCH, 1, 6, 0));
+    check("batch : PCF8574 bytes", stat_is(0x20, I2C_TRACE_BATCH, 1, 1, 0));
+    check("batch : HTS221 bytes", stat_is(0x5F, I2C_TRACE_BATCH, 1, 2, 0));
+    check("batch : no transfer charged to the first slave", stat_is(0x48, I2C_TRACE_TRANSFER, 1, 3, 0));
+    i2c_trace_get(I2C_TRACE_BUS, I2C_TRACE_TRANSFER, &stat);
+    nb_hist = 0;
+    for (int i = 0; i < I2C_TRACE_HIST_MAX; i++){ nb_hist += stat.hist[i];}
+    check("batch : ioctl once under the bus entry", (stat.nb == 1) && (stat.bytes == 9) && (nb_hist == 1));
+
+    /* dump : one line per device and operation, the bus last */
+    if (pipe(pipe_fd) < 0){ perror("pipe"); return 1;}
+    i2c_trace_dump(pipe_fd[1]);
+    close(pipe_fd[1]);
+    ssize_t len = read(pipe_fd[0], dump, sizeof(dump) - 1);
+    close(pipe_fd[0]);
+    dump[len > 0 ? len : 0] = '\0';
+    check("dump : PCF8574 reads", strstr(dump, "i2c_trace 0x20 read nb=5000 bytes=5000 errors=0 mean_ns=") != NULL);
+    check("dump : batch line without latency", strstr(dump, "i2c_trace 0x48 batch nb=1 bytes=6 errors=0\n") != NULL);
+    check("dump : bus entry", strstr(dump, "i2c_trace bus transfer nb=1 bytes=9 errors=0 mean_ns=") != NULL);
+
+    /* reset */
+    i2c_trace_reset();
+    check("reset", stat_is(0x20, I2C_TRACE_READ, 0, 0, 0) && stat_is(0x48, I2C_TRACE_BATCH, 0, 0, 0) && stat_is(I2C_TRACE_BUS, I2C_TRACE_TRANSFER, 0, 0, 0));
+
+    i2c_bus_put(bus);
+    printf("%s : %d failed check(s)\n", nb_error ? "FAIL" : "PASS", nb_error);
+    return nb_error ? 1 : 0;
+}
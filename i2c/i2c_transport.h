@@ -0,0 +1,176 @@
+/**
+ * @brief Pluggable I2C transport used by the drivers of this repository
+
+ * @file i2c_transport.h
+ * @copyright (c) Dorian ETCHEBER
+ * @date 17.10.2026
+ *
+ * @details
+ * Hardware : Rpi4 (/dev/i2c-N) or none (simulated bus, see i2c_sim.h)
+ *
+ * The drivers (PCF8591.h, PCF8574.h, Sense_hat.h, the SSD1306 twi layer) don't call open() / read() / write() /
+ * ioctl() on the bus themselves, they go through the active transport :
+ *  - i2c_open() / i2c_close()        : bus device file.
+ *  - i2c_set_address()               : slave used by i2c_read() / i2c_write() (ioctl I2C_SLAVE).
+ *  - i2c_read() / i2c_write()        : one transaction, START, address, bytes, STOP.
+ *  - i2c_transfer()                  : combined transaction with repeated STARTs (ioctl I2C_RDWR).
+ *  - i2c_read_reg() / i2c_write_reg(): register access of the sensors (SMBus byte data protocol).
+ *
+ * The default transport is the Linux i2c-dev interface. i2c_set_transport() replaces it, for instance with the
+ * simulated bus of i2c_sim.h, so the whole stack can run and be benchmarked without the boards.
+ * The active transport is defined once per process in i2c_bus.c : i2c_set_transport() in the main program also
+ * reaches the drivers built in other translation units (the SSD1306 twi layer for instance).
+ */
+
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+/**
+ * @brief Operations of an I2C transport. Every operation returns a negative value on error, like the system calls.
+ */
+typedef struct
+{
+    const char *name;                                                                  ///< Name of the transport ("linux", "sim").
+    int (*bus_open)(void *ctx, const char *bus);                                       ///< Open a bus, return its descriptor.
+    int (*bus_close)(void *ctx, int fd);                                               ///< Close a bus.
+    int (*set_address)(void *ctx, int fd, uint16_t address);                           ///< Slave of the next read() / write().
+    ssize_t (*bus_read)(void *ctx, int fd, void *buffer, size_t size);                 ///< Read transaction.
+    ssize_t (*bus_write)(void *ctx, int fd, const void *buffer, size_t size);          ///< Write transaction.
+    int (*transfer)(void *ctx, int fd, struct i2c_msg *messages, unsigned int nb_msg); ///< Combined transaction.
+    void *ctx;                                                                         ///< Data of the transport.
+} i2c_transport_t;
+
+static inline int i2c_linux_open(void *ctx, const char *bus){ (void)ctx; return open(bus, O_RDWR);}
+static inline int i2c_linux_close(void *ctx, int fd){ (void)ctx; return close(fd);}
+static inline int i2c_linux_set_address(void *ctx, int fd, uint16_t address){ (void)ctx; return ioctl(fd, I2C_SLAVE, address);}
+static inline ssize_t i2c_linux_read(void *ctx, int fd, void *buffer, size_t size){ (void)ctx; return read(fd, buffer, size);}
+static inline ssize_t i2c_linux_write(void *ctx, int fd, const void *buffer, size_t size){ (void)ctx; return write(fd, buffer, size);}
+
+static inline int i2c_linux_transfer(void *ctx, int fd, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    (void)ctx;
+    struct i2c_rdwr_ioctl_data packets = {.msgs = messages, .nmsgs = nb_msg};
+    return ioctl(fd, I2C_RDWR, &packets);
+}
+
+/** @brief Linux i2c-dev transport (/dev/i2c-N). */
+static const i2c_transport_t i2c_transport_linux = {
+    .name = "linux", .bus_open = i2c_linux_open, .bus_close = i2c_linux_close, .set_address = i2c_linux_set_address,
+    .bus_read = i2c_linux_read, .bus_write = i2c_linux_write, .transfer = i2c_linux_transfer, .ctx = NULL};
+
+/** @brief Active transport of the process (i2c_bus.c). */
+extern const i2c_transport_t *i2c_transport;
+
+/**
+ * @brief Replace the active transport.
+ * @param transport The new transport, NULL for the Linux i2c-dev transport.
+ * @warning Change it before opening the buses : a descriptor only works with the transport that opened it.
+ */
+static inline void i2c_set_transport(const i2c_transport_t *transport)
+{
+    i2c_transport = transport ? transport : &i2c_transport_linux;
+}
+
+/**
+ * @brief Open an I2C bus.
+ * @param bus Bus device file ("/dev/i2c-1") or name of a simulated bus.
+ * @return Descriptor of the bus, -1 on error.
+ */
+static inline int i2c_open(const char *bus)
+{
+    return i2c_transport->bus_open(i2c_transport->ctx, bus);
+}
+
+/**
+ * @brief Close an I2C bus.
+ * @param fd Descriptor of the bus.
+ */
+static inline int i2c_close(int fd)
+{
+    return i2c_transport->bus_close(i2c_transport->ctx, fd);
+}
+
+/**
+ * @brief Select the slave of the next i2c_read() / i2c_write() on a bus.
+ * @param fd Descriptor of the bus.
+ * @param address 7 bit address of the slave.
+ * @return 0 on success, -1 on error.
+ */
+static inline int i2c_set_address(int fd, uint16_t address)
+{
+    return i2c_transport->set_address(i2c_transport->ctx, fd, address);
+}
+
+/**
+ * @brief Read bytes from the selected slave in one transaction.
+ * @return Number of bytes read, -1 on error.
+ */
+static inline ssize_t i2c_read(int fd, void *buffer, size_t size)
+{
+    return i2c_transport->bus_read(i2c_transport->ctx, fd, buffer, size);
+}
+
+/**
+ * @brief Write bytes to the selected slave in one transaction.
+ * @return Number of bytes written, -1 on error.
+ */
+static inline ssize_t i2c_write(int fd, const void *buffer, size_t size)
+{
+    return i2c_transport->bus_write(i2c_transport->ctx, fd, buffer, size);
+}
+
+/**
+ * @brief Run messages in one combined transaction, separated by repeated STARTs.
+ * @param fd Descriptor of the bus.
+ * @param messages Messages, each with its own slave address.
+ * @param nb_msg Number of messages.
+ * @return 0 or more on success, -1 on error.
+ */
+static inline int i2c_transfer(int fd, struct i2c_msg *messages, unsigned int nb_msg)
+{
+    return i2c_transport->transfer(i2c_transport->ctx, fd, messages, nb_msg);
+}
+
+/**
+ * @brief Read a register of a slave : register address written, then one byte read after a repeated START.
+ * @param fd Descriptor of the bus.
+ * @param address 7 bit address of the slave.
+ * @param reg Register address.
+ * @return Register value, -1 on error.
+ */
+static inline int i2c_read_reg(int fd, uint16_t address, uint8_t reg)
+{
+    uint8_t value;
+    struct i2c_msg messages[2] = {
+        {.addr = address, .flags = 0, .len = 1, .buf = &reg},
+        {.addr = address, .flags = I2C_M_RD, .len = 1, .buf = &value},
+    };
+    if (i2c_transfer(fd, messages, 2) < 0){ return -1;}
+    return value;
+}
+
+/**
+ * @brief Write a register of a slave.
+ * @param fd Descriptor of the bus.
+ * @param address 7 bit address of the slave.
+ * @param reg Register address.
+ * @param value Value written.
+ * @return 0 on success, -1 on error.
+ */
+static inline int i2c_write_reg(int fd, uint16_t address, uint8_t reg, uint8_t value)
+{
+    uint8_t buffer[2] = {reg, value};
+    struct i2c_msg message = {.addr = address, .flags = 0, .len = 2, .buf = buffer};
+    return (i2c_transfer(fd, &message, 1) < 0) ? -1 : 0;
+}
+
+#endif
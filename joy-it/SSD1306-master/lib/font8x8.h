@@ -24,7 +24,16 @@
 #define __FONT8x8_H__
 
   // includes
-  #include <avr/pgmspace.h>
+  #ifdef __AVR__
+    #include <avr/pgmspace.h>
+  #else
+    // host build (Linux i2c-dev or simulated bus) : fonts stay in RAM
+    #include <stdint.h>
+    #ifndef PROGMEM
+      #define PROGMEM
+      #define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+    #endif
+  #endif
 
   // Characters definition
   // -----------------------------------
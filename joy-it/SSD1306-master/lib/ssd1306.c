@@ -24,6 +24,9 @@
 // @includes
 #include "ssd1306.h"
 
+// @var USDT probe ssd1306:update_screen (see i2c_probe.h)
+I2C_PROBE_DEFINE (ssd1306, update_screen);
+
 // +---------------------------+
 // |      Set MUX Ratio        |
 // +---------------------------+
@@ -132,6 +135,9 @@ const uint8_t INIT_SSD1306[] PROGMEM = {
 // @var array Chache memory Lcd 8 * 128 = 1024
 static char cacheMemLcd[CACHE_SIZE_MEM];
 
+// @var set area (declared in ssd1306.h)
+unsigned int _counter;
+
 /**
  * @desc    SSD1306 Init
  *
@@ -350,6 +356,8 @@ uint8_t SSD1306_InverseScreen (uint8_t address)
  */
 uint8_t SSD1306_UpdateScreen (uint8_t address)
 {
+  // start time of the frame, read only when a tracer is attached
+  I2C_PROBE_BEGIN (ssd1306, update_screen, start_ns);
   // init status
   uint8_t status = INIT_STATUS;
   // init i
@@ -390,6 +398,9 @@ uint8_t SSD1306_UpdateScreen (uint8_t address)
   // stop TWI
   TWI_Stop ();
 
+  // frame sent : address, control byte + cache memory, start, end
+  I2C_PROBE_END (ssd1306, update_screen, start_ns, address, CACHE_SIZE_MEM + 1, SSD1306_SUCCESS);
+
   // success
   return SSD1306_SUCCESS;
 }
@@ -93,7 +93,7 @@
   #define MAX_Y                     (END_PAGE_ADDR + 1) * 8
 
   // @var set area
-  unsigned int _counter;
+  extern unsigned int _counter;
 
   /**
    * @desc    SSD1306 Init
@@ -18,6 +18,9 @@
 // include libraries
 #include "twi.h"
 
+// AVR TWI peripheral, the host build uses twi_linux.c
+#ifdef __AVR__
+
 /**
  * @desc    TWI init - initialize frequency
  *
@@ -166,3 +169,5 @@ void TWI_Stop (void)
   // wait for TWINT flag is set
 //  TWI_WAIT_TILL_TWINT_IS_SET();
 }
+
+#endif
@@ -19,7 +19,21 @@
 #define __TWI_H__
 
   // @includes
-  #include <avr/io.h>
+  #ifdef __AVR__
+    #include <avr/io.h>
+    // no USDT probes on the AVR
+    #define I2C_PROBE_DEFINE(provider, name) struct i2c_probe_unused
+    #define I2C_PROBE_BEGIN(provider, name, start)
+    #define I2C_PROBE_END(provider, name, start, address, bytes, value)
+  #else
+    // host build : the TWI master functions run on i2c_transport.h (see twi_linux.c)
+    #include "i2c_transport.h"
+    // USDT probes of the drivers (perf, bpftrace)
+    #include "i2c_probe.h"
+    #ifndef TWI_I2C_DEVICE
+      #define TWI_I2C_DEVICE    "/dev/i2c-1"  // bus opened by TWI_Init
+    #endif
+  #endif
 
   // define register for TWI communication
   // -------------------------------------------------------------------------------------
@@ -177,5 +191,16 @@
    * @return  void
    */
   void TWI_Stop (void);
+
+  #ifndef __AVR__
+  /**
+   * @desc    TWI release bus (host build only)
+   *
+   * @param   void
+   *
+   * @return  void
+   */
+  void TWI_Close (void);
+  #endif
   
 #endif
@@ -0,0 +1,218 @@
+/**
+ * --------------------------------------------------------------------------------------+
+ * @desc        Two Wire Interface / I2C Communication - host build (Linux, simulated bus)
+ * --------------------------------------------------------------------------------------+
+ *
+ * @file        twi_linux.c
+ * @tested      Rpi4 (/dev/i2c-1), i2c_sim.h
+ *
+ * @depend      twi.h, i2c_transport.h, i2c_bus.h
+ * --------------------------------------------------------------------------------------+
+ * @usage       gcc -Wall -I../../i2c -o main main.c lib/ssd1306.c lib/twi.c lib/twi_linux.c ../../i2c/i2c_bus.c -pthread
+ *
+ *              Same master transmit API as twi.c, on top of i2c_transport.h. The bytes sent
+ *              between TWI_MT_Start and TWI_Stop are collected and written in one transaction
+ *              (one ioctl I2C_RDWR) :
+ *                - TWI_MT_Start flushes the pending transaction first (repeated START), so
+ *                  the functions which never call TWI_Stop (NormalScreen, InverseScreen)
+ *                  still reach the display, at the latest on the next request.
+ *                - the ACK of the slave is only known when the transaction is written, a
+ *                  NACK is returned by the TWI_MT_Start which follows it.
+ *              The bus is the shared bus of i2c_bus.h, the other drivers of the process use the
+ *              same descriptor. The display is accessed in the bulk class : a data stream
+ *              (frame of SSD1306_UpdateScreen) is sent in pieces of TWI_BULK_CHUNK bytes, each
+ *              with its own control byte, and the DAC / input accesses of the other threads
+ *              go between two pieces.
+ */
+
+// the AVR build uses twi.c
+#ifndef __AVR__
+
+// include libraries
+#include "twi.h"
+#include "i2c_bus.h"
+
+// @const size of one transaction, 1 control byte + 1024 bytes of cache memory Lcd
+#define TWI_BUFFER_SIZE   2048
+// @const data bytes of one piece of a bulk data stream (32 bytes : about 3 ms at 100 kHz)
+#ifndef TWI_BULK_CHUNK
+  #define TWI_BULK_CHUNK  32
+#endif
+// @const control byte of a data stream (SSD1306_DATA_STREAM), repeated in each piece
+#define TWI_DATA_STREAM   0x40
+
+// @var shared bus
+static i2c_bus_t *twi_bus = NULL;
+// @var slave address of the pending transaction
+static uint8_t twi_address;
+// @var pending transaction
+static uint8_t twi_buffer[TWI_BUFFER_SIZE];
+static uint16_t twi_length;
+// @var a transaction is pending (START + SLAW sent)
+static char twi_pending;
+// @var status of the last written transaction
+static char twi_status = SUCCESS;
+
+/**
+ * @desc    TWI write pending transaction
+ *
+ * @param   void
+ *
+ * @return  void
+ */
+static void TWI_Flush (void)
+{
+  // nothing to send
+  if (!twi_pending) {
+    return;
+  }
+  twi_pending = 0;
+
+  // display accesses are bulk, the higher classes go first
+  int priority = i2c_bus_set_class (I2C_CLASS_BULK);
+
+  if ((twi_length <= TWI_BULK_CHUNK + 1) || (twi_buffer[0] != TWI_DATA_STREAM)) {
+    // one message, START + SLAW + data + STOP
+    struct i2c_msg message = {.addr = twi_address, .flags = 0, .len = twi_length, .buf = twi_buffer};
+    if (i2c_bus_transfer (twi_bus, &message, 1) < 0) {
+      // slave absent or bus error
+      twi_status = TWI_MT_SLAW_NACK;
+    }
+  } else {
+    // data stream : pieces of TWI_BULK_CHUNK bytes, the display keeps its GDDRAM pointer
+    uint8_t piece[TWI_BULK_CHUNK + 1];
+    piece[0] = TWI_DATA_STREAM;
+    i2c_bus_lock (twi_bus);
+    for (uint16_t i = 1; i < twi_length; i += TWI_BULK_CHUNK) {
+      uint16_t length = (twi_length - i < TWI_BULK_CHUNK) ? twi_length - i : TWI_BULK_CHUNK;
+      memcpy (piece + 1, twi_buffer + i, length);
+      struct i2c_msg message = {.addr = twi_address, .flags = 0, .len = length + 1, .buf = piece};
+      if (i2c_bus_transfer_locked (twi_bus, &message, 1) < 0) {
+        // slave absent or bus error
+        twi_status = TWI_MT_SLAW_NACK;
+        break;
+      }
+      // preemption point between two pieces
+      i2c_bus_yield (twi_bus);
+    }
+    i2c_bus_unlock (twi_bus);
+  }
+  i2c_bus_set_class (priority);
+}
+
+/**
+ * @desc    TWI init - open bus
+ *
+ * @param   void
+ *
+ * @return  void
+ */
+void TWI_Init (void)
+{
+  // already open
+  if (twi_bus != NULL) {
+    return;
+  }
+  // open once, shared with the other drivers
+  twi_bus = i2c_bus_get (TWI_I2C_DEVICE);
+}
+
+/**
+ * @desc    TWI MT Start
+ *
+ * @param   void
+ *
+ * @return  char
+ */
+char TWI_MT_Start (void)
+{
+  // init status
+  char status;
+
+  // bus not open
+  if (twi_bus == NULL) {
+    return ERROR;
+  }
+  // repeated start - previous transaction written first
+  TWI_Flush ();
+  // return status of the previous transaction
+  status = twi_status;
+  twi_status = SUCCESS;
+  return status;
+}
+
+/**
+ * @desc    TWI Send address + write
+ *
+ * @param   char
+ *
+ * @return  char
+ */
+char TWI_MT_Send_SLAW (char address)
+{
+  twi_address = address;
+  twi_length = 0;
+  twi_pending = 1;
+  // success
+  return SUCCESS;
+}
+
+/**
+ * @desc    TWI Send data
+ *
+ * @param   char
+ *
+ * @return  char
+ */
+char TWI_MT_Send_Data (char data)
+{
+  // no START + SLAW, or transaction too long
+  if ((!twi_pending) || (twi_length >= TWI_BUFFER_SIZE)) {
+    return TWI_MT_DATA_NACK;
+  }
+  twi_buffer[twi_length++] = data;
+  // success
+  return SUCCESS;
+}
+
+/**
+ * @desc    TWI Send address + read
+ *
+ * @param   char
+ *
+ * @return  char
+ */
+char TWI_MR_Send_SLAR (char address)
+{
+  // master receiver not used by the display, not implemented
+  (void) address;
+  return TWI_MR_SLAR_NACK;
+}
+
+/**
+ * @desc    TWI stop
+ *
+ * @param   void
+ *
+ * @return  void
+ */
+void TWI_Stop (void)
+{
+  TWI_Flush ();
+}
+
+/**
+ * @desc    TWI release bus
+ *
+ * @param   void
+ *
+ * @return  void
+ */
+void TWI_Close (void)
+{
+  TWI_Flush ();
+  i2c_bus_put (twi_bus);
+  twi_bus = NULL;
+}
+
+#endif